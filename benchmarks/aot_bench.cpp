@@ -0,0 +1,129 @@
+// Run time of scripts in the interpreter, by the bytecode engine and with
+// --jit, and as executables built from their --emit-c source with the
+// system compiler; the speedup is the executable's over the bytecode
+// engine. The time to build the executable is shown apart.
+//
+//  aot_bench [scale]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef INTERPRETER_PATH
+#define INTERPRETER_PATH "interpreter"
+#endif
+
+#ifndef TRANSPILER_CXX
+#define TRANSPILER_CXX "c++"
+#endif
+
+#ifndef INTERPRETER_LIB_DIR
+#define INTERPRETER_LIB_DIR "lib"
+#endif
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#define EXECUTABLE "aot_bench.exe"
+#else
+#define NULL_DEVICE "/dev/null"
+#define EXECUTABLE "./aot_bench.bin"
+#endif
+
+struct Script {
+    std::string name;
+    std::string source;
+};
+
+std::string temp_file(const std::string &name, const std::string &text) {
+    std::string filename = "aot_bench." + name;
+    std::ofstream file(filename, std::ios::binary);
+    file << text;
+    return filename;
+}
+
+// milliseconds the command took, -1 if it failed
+double run(const std::string &command) {
+    auto start = std::chrono::steady_clock::now();
+    if (std::system(command.c_str()) != 0) {
+        return -1;
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+std::vector<Script> scripts(long scale) {
+    std::string n = std::to_string(scale);
+    return {
+            {"arithmetic",
+             "int sum = 0;\n"
+             "for (int i = 0; i < " + n + "; i = i + 1) {\n"
+             "    sum = sum + ((i * 7 + 3) % 11 - (i % 5) * 2) % 1000;\n"
+             "}\n"
+             "write_line(sum);\n"},
+            {"collatz",
+             "int longest = 0;\n"
+             "for (int i = 1; i < " + std::to_string(scale / 100) + "; i = i + 1) {\n"
+             "    int x = i;\n"
+             "    int steps = 0;\n"
+             "    while (x != 1) {\n"
+             "        if (x % 2 == 0) x = x / 2; else x = 3 * x + 1;\n"
+             "        steps = steps + 1;\n"
+             "    }\n"
+             "    if (steps > longest) longest = steps;\n"
+             "}\n"
+             "write_line(longest);\n"},
+            {"scopes",
+             "int sum = 0;\n"
+             "for (int i = 0; i < " + n + "; i = i + 1) {\n"
+             "    int a = i + 1;\n"
+             "    { int b = a * 2; { int c = b - i; sum = sum + c % 7; } }\n"
+             "}\n"
+             "write_line(sum);\n"},
+            {"strings",
+             "string s = \"\";\n"
+             "int total = 0;\n"
+             "for (int i = 0; i < " + std::to_string(scale / 10) + "; i = i + 1) {\n"
+             "    s = s + \"ab\";\n"
+             "    if (i % 1000 == 999) { total = total + 1; s = \"\"; }\n"
+             "}\n"
+             "write_line(total);\n"},
+            {"output",
+             "for (int i = 0; i < " + std::to_string(scale / 10) + "; i = i + 1) {\n"
+             "    write(i % 97);\n"
+             "    write_line(\" item\");\n"
+             "}\n"},
+    };
+}
+
+int main(int argc, char *argv[]) {
+    long scale = argc > 1 ? atol(argv[1]) : 20000000;
+    printf("%-11s %10s %10s %10s %10s %8s\n", "script", "vm, ms", "jit, ms",
+           "build, ms", "aot, ms", "speedup");
+    for (const auto &script : scripts(scale)) {
+        std::string program = temp_file(script.name + ".cpm", script.source);
+        std::string source = "aot_bench." + script.name + ".cpp";
+        double vm = run(std::string(INTERPRETER_PATH) + " --vm -O2 " + program +
+                        " > " NULL_DEVICE);
+        double jit = run(std::string(INTERPRETER_PATH) + " --jit -O2 " + program +
+                         " > " NULL_DEVICE);
+        double build = -1;
+        double aot = -1;
+        if (run(std::string(INTERPRETER_PATH) + " -O2 --emit-c=" + source + " " +
+                program) >= 0) {
+            build = run(TRANSPILER_CXX " -std=c++11 -O2 -fwrapv -I" INTERPRETER_LIB_DIR
+                        " " + source + " -o " EXECUTABLE);
+        }
+        if (build >= 0) {
+            aot = run(EXECUTABLE " > " NULL_DEVICE);
+        }
+        printf("%-11s %10.1f %10.1f %10.1f %10.1f %7.1fx\n", script.name.c_str(),
+               vm, jit, build, aot, aot > 0 ? vm / aot : 0.0);
+        fflush(stdout);
+        std::remove(program.c_str());
+        std::remove(source.c_str());
+        std::remove(EXECUTABLE);
+    }
+    return 0;
+}
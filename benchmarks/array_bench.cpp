@@ -0,0 +1,89 @@
+// Measures the array builtins: the kernels behind sum(), min() and count()
+// on every instruction set the CPU runs, then the same sum written as an
+// interpreted loop and as sum(a) in both engines.
+//
+//  array_bench [size]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <parser.h>
+#include <interpreter.h>
+#include <simd.h>
+
+double seconds(const std::function<void()> &run) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+void bench_kernels(const std::vector<int> &data, int repeats) {
+    double bytes = double(data.size()) * sizeof(int) * repeats;
+    for (auto isa : {IntKernels::Isa::SCALAR, IntKernels::Isa::SSE2, IntKernels::Isa::AVX2}) {
+        if (!IntKernels::supported(isa)) {
+            continue;
+        }
+        int64_t check = 0;
+        double sum = seconds([&] {
+            for (int i = 0; i < repeats; ++i) {
+                check += IntKernels::sum(data.data(), data.size(), isa);
+            }
+        });
+        double min = seconds([&] {
+            for (int i = 0; i < repeats; ++i) {
+                check += IntKernels::min(data.data(), data.size(), isa);
+            }
+        });
+        double count = seconds([&] {
+            for (int i = 0; i < repeats; ++i) {
+                check += IntKernels::count(data.data(), data.size(), 7, isa);
+            }
+        });
+        printf("%-6s sum %6.2f GB/s  min %6.2f GB/s  count %6.2f GB/s  (%lld)\n",
+               IntKernels::name(isa), bytes / sum / 1e9, bytes / min / 1e9,
+               bytes / count / 1e9, static_cast<long long>(check));
+    }
+}
+
+void bench_program(const std::string &name, const std::string &source, int size,
+                   Engine engine) {
+    std::stringstream in(std::to_string(size)), out;
+    Interpreter interpreter(in, out);
+    interpreter.set_engine(engine);
+    interpreter.set_optimization(Optimizer::MAX_LEVEL);
+    double time = seconds([&] {
+        run_source(interpreter, source);
+        interpreter.output().flush();
+    });
+    printf("%-5s %-6s %8.3f s %8.2f ns/element  %s",
+           engine == Engine::TREE ? "tree" : "vm", name.c_str(), time,
+           time * 1e9 / size, out.str().c_str());
+}
+
+int main(int argc, char *argv[]) {
+    int size = argc > 1 ? atoi(argv[1]) : 1 << 24;
+    std::vector<int> data(size);
+    for (int i = 0; i < size; ++i) {
+        data[i] = (i * 37) % 101 - 50;
+    }
+    bench_kernels(data, 20);
+
+    const std::string fill =
+            "int n = read_int();\n"
+            "int[] a = int[n];\n"
+            "for (int i = 0; i < n; i = i + 1) a[i] = i % 101 - 50;\n";
+    const std::string loop = fill +
+            "long s = 0;\n"
+            "for (int i = 0; i < size(a); i = i + 1) s = s + a[i];\n"
+            "write_line(s);\n";
+    const std::string builtin = fill + "write_line(sum(a));\n";
+    for (auto engine : {Engine::TREE, Engine::BYTECODE}) {
+        bench_program("loop", loop, size, engine);
+        bench_program("sum", builtin, size, engine);
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Measures the startup of the interpreter with the compiled script cache:
+// every script is run without the cache, with an outdated cache (parse,
+// compile and save) and with a valid one (load only).
+//
+//  cache_bench [runs]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cache.h>
+
+#ifndef INTERPRETER_PATH
+#define INTERPRETER_PATH "interpreter"
+#endif
+
+#ifndef SAMPLES_DIR
+#define SAMPLES_DIR "samples"
+#endif
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+static const char *CACHE_DIR = ".";
+
+struct Script {
+    std::string name;
+    std::string program;
+    std::string input;
+};
+
+// many short statements and functions of little work: the run is mostly
+// parsing and analysis
+std::string generate(int statements) {
+    std::string program = "int sum = 0;\n";
+    for (int i = 0; i < statements; ++i) {
+        std::string v = "v" + std::to_string(i);
+        program += "int " + v + " = " + std::to_string(i) + " * 3 + sum % 7;\n";
+        program += "if (" + v + " % 2 == 0) { sum = sum + " + v +
+                   "; } else { sum = sum - 1; }\n";
+    }
+    program += "write_line(sum);\n";
+    std::string filename = "cache_bench.generated.cpm";
+    std::ofstream file(filename, std::ios::binary);
+    file << program;
+    return filename;
+}
+
+double run(const Script &script, const std::string &options, int runs) {
+    std::string command = std::string(INTERPRETER_PATH) + " " + options + " " +
+                          script.program + " " + script.input + " > " NULL_DEVICE;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) {
+        if (std::system(command.c_str()) != 0) {
+            return -1;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / runs;
+}
+
+int main(int argc, char *argv[]) {
+    int runs = argc > 1 ? atoi(argv[1]) : 20;
+    std::vector<Script> scripts = {
+            {"sum", SAMPLES_DIR "/sum.cpm", ""},
+            {"gcd", SAMPLES_DIR "/gcd.cpm", ""},
+            {"multisum", SAMPLES_DIR "/multisum.cpm", SAMPLES_DIR "/multisum_input.txt"},
+            {"generated", generate(20000), ""},
+    };
+    std::string default_input = "cache_bench.input.tmp";
+    {
+        std::ofstream file(default_input);
+        file << "17 25\n";
+    }
+    std::string cached = std::string("--cache-dir=") + CACHE_DIR;
+    printf("%-10s %12s %12s %12s\n", "script", "no cache", "cold", "warm");
+    for (auto &script : scripts) {
+        if (script.input.empty()) {
+            script.input = default_input;
+        }
+        std::string cache = ScriptCache(script.program, CACHE_DIR, 1).path();
+        double plain = run(script, "--vm", runs);
+        double cold = 0;
+        for (int i = 0; i < runs; ++i) {
+            std::remove(cache.c_str());
+            cold += run(script, cached, 1);
+        }
+        cold /= runs;
+        double warm = run(script, cached, runs);
+        std::remove(cache.c_str());
+        printf("%-10s %9.2f ms %9.2f ms %9.2f ms\n", script.name.c_str(),
+               plain, cold, warm);
+        fflush(stdout);
+    }
+    std::remove(default_input.c_str());
+    std::remove("cache_bench.generated.cpm");
+    return 0;
+}
@@ -0,0 +1,152 @@
+// Measures MB/s of read_int()/read_word()/read_line() for the line by line
+// stringstream reader the machine used before and for InputBuffer reading a
+// stream and a mapped file, and of read_ints() parsing numbers in bulk.
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <input.h>
+
+// the old Machine input path
+class LineReader {
+public:
+    explicit LineReader(std::istream &in) : in_(in) {}
+
+    int read_int() {
+        int val = 0;
+        while (!(buffer_ >> val) && !eof_) {
+            check_();
+        }
+        return val;
+    }
+
+    std::string read_word() {
+        std::string s;
+        while (!(buffer_ >> s) && !eof_) {
+            check_();
+        }
+        return s;
+    }
+
+    std::string read_line() {
+        std::string s;
+        while (!getline(buffer_, s) && !eof_) {
+            check_();
+        }
+        return s;
+    }
+
+private:
+    std::istream &in_;
+    std::stringstream buffer_;
+    bool eof_ = false;
+
+    void check_() {
+        if (!buffer_.eof()) {
+            throw std::invalid_argument(CANT_READ);
+        }
+        buffer_.clear();
+        std::string s;
+        std::getline(in_, s);
+        buffer_ << s;
+        if (in_.eof()) {
+            eof_ = true;
+        }
+    }
+};
+
+std::string make_ints(size_t lines) {
+    std::string data;
+    unsigned seed = 12345;
+    for (size_t i = 0; i < lines; ++i) {
+        for (int j = 0; j < 8; ++j) {
+            seed = seed * 1103515245 + 12345;
+            int val = static_cast<int>(seed >> 1) - (1 << 30);
+            data += std::to_string(val);
+            data += j == 7 ? '\n' : ' ';
+        }
+    }
+    return data;
+}
+
+std::string make_words(size_t lines) {
+    std::string data;
+    for (size_t i = 0; i < lines; ++i) {
+        data += "lorem ipsum dolor sit amet consectetur adipiscing elit\n";
+    }
+    return data;
+}
+
+template <class Reader>
+size_t drain(Reader &reader, const std::string &kind, size_t count) {
+    size_t check = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (kind == "int") {
+            check += reader.read_int();
+        } else if (kind == "word") {
+            check += reader.read_word().size();
+        } else {
+            check += reader.read_line().size();
+        }
+    }
+    return check;
+}
+
+size_t drain_bulk(InputBuffer &reader, size_t count) {
+    std::vector<int> values(count);
+    reader.read_ints(values.data(), count);
+    size_t check = 0;
+    for (int val : values) {
+        check += val;
+    }
+    return check;
+}
+
+void report(const char *name, const std::string &kind, size_t bytes,
+            const std::function<size_t()> &run) {
+    auto start = std::chrono::steady_clock::now();
+    size_t check = run();
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    printf("%-12s %-20s %10.1f MB/s  (check %zu)\n", kind.c_str(), name,
+           bytes / seconds / (1 << 20), check);
+}
+
+void bench(const std::string &kind, const std::string &data, size_t count) {
+    const char *filename = "input_bench.tmp";
+    {
+        std::ofstream file(filename, std::ios::binary);
+        file << data;
+    }
+    if (kind != "ints") {
+        report("stringstream", kind, data.size(), [&]() {
+            std::istringstream in(data);
+            LineReader reader(in);
+            return drain(reader, kind, count);
+        });
+    }
+    report("InputBuffer stream", kind, data.size(), [&]() {
+        std::ifstream in(filename, std::ios::binary);
+        InputBuffer reader(in);
+        return kind == "ints" ? drain_bulk(reader, count) : drain(reader, kind, count);
+    });
+    report("InputBuffer file", kind, data.size(), [&]() {
+        InputBuffer reader;
+        reader.open(filename);
+        return kind == "ints" ? drain_bulk(reader, count) : drain(reader, kind, count);
+    });
+    std::remove(filename);
+}
+
+int main() {
+    const size_t LINES = 200000;
+    bench("int", make_ints(LINES), LINES * 8);
+    bench("ints", make_ints(LINES), LINES * 8);
+    bench("word", make_words(LINES), LINES * 8);
+    bench("line", make_words(LINES), LINES);
+    return 0;
+}
@@ -0,0 +1,140 @@
+// Measures counting words with FlatMap against std::unordered_map: string
+// keys as the programs translated with --emit-c keep them, Value keys as
+// the interpreter keeps them, read or interned, and int keys; then the same
+// count written as a script with add() in both engines.
+//
+//  map_bench [words] [distinct words]
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <parser.h>
+#include <interpreter.h>
+#include <hash_map.h>
+#include <machine.h>
+
+double seconds(const std::function<void()> &run) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+void report(const char *name, size_t count, double time, size_t check) {
+    printf("%-28s %8.3f s %8.2f ns/word  (%zu)\n", name, time, time * 1e9 / count, check);
+}
+
+template <class K, class Map>
+size_t count_unordered(const std::vector<K> &words) {
+    Map counts;
+    for (const auto &word : words) {
+        ++counts[word];
+    }
+    return counts.size();
+}
+
+template <class K>
+size_t count_flat(const std::vector<K> &words) {
+    FlatMap<K> counts;
+    for (const auto &word : words) {
+        map_add(counts, word, 1);
+    }
+    return counts.size();
+}
+
+struct ValueHash {
+    size_t operator()(const Value &key) const {
+        return std::hash<std::string>()(key.str());
+    }
+};
+
+struct ValueEqual {
+    bool operator()(const Value &lhs, const Value &rhs) const {
+        return lhs.str_equal(rhs);
+    }
+};
+
+void bench_program(const std::string &source, const std::string &text, size_t count,
+                   Engine engine) {
+    std::stringstream in(text), out;
+    Interpreter interpreter(in, out);
+    interpreter.set_engine(engine);
+    interpreter.set_optimization(Optimizer::MAX_LEVEL);
+    double time = seconds([&] {
+        run_source(interpreter, source);
+        interpreter.output().flush();
+    });
+    printf("%-5s %-22s %8.3f s %8.2f ns/word  %s", engine == Engine::TREE ? "tree" : "vm",
+           "add(m, w[i], 1)", time, time * 1e9 / count, out.str().c_str());
+}
+
+int main(int argc, char *argv[]) {
+    size_t count = argc > 1 ? atoi(argv[1]) : 1 << 22;
+    size_t distinct = argc > 2 ? atoi(argv[2]) : 50000;
+    // word frequencies fall off like in a text
+    std::mt19937 random(1);
+    std::vector<std::string> dictionary(distinct);
+    for (auto &word : dictionary) {
+        size_t length = 3 + random() % 8;
+        for (size_t i = 0; i < length; ++i) {
+            word += static_cast<char>('a' + random() % 26);
+        }
+    }
+    std::vector<std::string> words(count);
+    std::vector<int> ids(count);
+    std::string text;
+    for (size_t i = 0; i < count; ++i) {
+        size_t id = static_cast<size_t>(distinct * std::pow(random() / double(random.max()), 3));
+        ids[i] = static_cast<int>(id < distinct ? id : distinct - 1);
+        words[i] = dictionary[ids[i]];
+        text += words[i];
+        text += i % 16 == 15 ? '\n' : ' ';
+    }
+    std::vector<Value> read(count), interned(count);
+    for (size_t i = 0; i < count; ++i) {
+        read[i].load_str(words[i]);
+        interned[i] = Value::interned(words[i]);
+    }
+
+    size_t check = 0;
+    double time = seconds([&] {
+        check = count_unordered<std::string, std::unordered_map<std::string, int>>(words);
+    });
+    report("unordered_map<string>", count, time, check);
+    time = seconds([&] { check = count_flat(words); });
+    report("FlatMap<string>", count, time, check);
+    time = seconds([&] {
+        check = count_unordered<Value, std::unordered_map<Value, int, ValueHash, ValueEqual>>(
+                read);
+    });
+    report("unordered_map<Value> read", count, time, check);
+    time = seconds([&] { check = count_flat(read); });
+    report("FlatMap<Value> read", count, time, check);
+    time = seconds([&] {
+        check = count_unordered<Value, std::unordered_map<Value, int, ValueHash, ValueEqual>>(
+                interned);
+    });
+    report("unordered_map<Value> interned", count, time, check);
+    time = seconds([&] { check = count_flat(interned); });
+    report("FlatMap<Value> interned", count, time, check);
+    time = seconds([&] { check = count_unordered<int, std::unordered_map<int, int>>(ids); });
+    report("unordered_map<int>", count, time, check);
+    time = seconds([&] { check = count_flat(ids); });
+    report("FlatMap<int>", count, time, check);
+
+    const std::string source =
+            "map<string,int> m;\n"
+            "string[] w = read_all_words();\n"
+            "for (int i = 0; i < size(w); i = i + 1) add(m, w[i], 1);\n"
+            "write_line(size(m));\n";
+    for (auto engine : {Engine::TREE, Engine::BYTECODE}) {
+        bench_program(source, text, count, engine);
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+// Requests per second of short scripts run by a new interpreter process
+// each time and by a resident one started with --serve, over its socket
+// from several client threads at once.
+//
+//  serve_bench [requests] [clients]
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <protocol.h>
+
+#ifndef INTERPRETER_PATH
+#define INTERPRETER_PATH "interpreter"
+#endif
+
+#ifndef SAMPLES_DIR
+#define SAMPLES_DIR "samples"
+#endif
+
+struct Script {
+    std::string name;
+    std::string program;
+    std::string input;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::string read_file(const std::string &filename) {
+    std::ifstream file(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+std::string absolute(const std::string &path) {
+    char resolved[PATH_MAX];
+    return realpath(path.c_str(), resolved) ? resolved : path;
+}
+
+double cold(const Script &script, int requests) {
+    std::string command = std::string(INTERPRETER_PATH) + " --vm " + script.program +
+                          " " + script.input + " > /dev/null";
+    auto start = Clock::now();
+    for (int i = 0; i < requests; ++i) {
+        if (std::system(command.c_str()) != 0) {
+            return -1;
+        }
+    }
+    return requests / seconds_since(start);
+}
+
+// every client keeps one connection for all of its requests
+double served(const std::string &socket, const Script &script, int requests,
+              int clients) {
+    ServeRequest request;
+    request.script = absolute(script.program);
+    request.input = read_file(script.input);
+    std::string encoded = encode_request(request);
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> threads;
+    auto start = Clock::now();
+    for (int c = 0; c < clients; ++c) {
+        int count = requests / clients + (c < requests % clients ? 1 : 0);
+        threads.emplace_back([&socket, &encoded, &failed, count]() {
+            int fd = connect_socket(socket);
+            if (fd < 0) {
+                failed = true;
+                return;
+            }
+            FdReader reader(fd);
+            ServeResponse response;
+            for (int i = 0; i < count; ++i) {
+                if (!write_all(fd, encoded) || !read_response(reader, response) ||
+                    !response.ok) {
+                    failed = true;
+                    break;
+                }
+            }
+            close(fd);
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    return failed ? -1 : requests / seconds_since(start);
+}
+
+pid_t start_server(const std::string &socket, int workers) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::string serve = "--serve=" + socket;
+        std::string threads = "--workers=" + std::to_string(workers);
+        execl(INTERPRETER_PATH, INTERPRETER_PATH, "--vm", serve.c_str(),
+              threads.c_str(), static_cast<char *>(nullptr));
+        _exit(127);
+    }
+    for (int i = 0; i < 500 && pid > 0; ++i) {
+        int fd = connect_socket(socket);
+        if (fd >= 0) {
+            close(fd);
+            return pid;
+        }
+        usleep(10000);
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+    int requests = argc > 1 ? atoi(argv[1]) : 200;
+    int clients = argc > 2 ? atoi(argv[2]) : 4;
+    std::string default_input = "serve_bench.input.tmp";
+    {
+        std::ofstream file(default_input);
+        file << "17 25\n";
+    }
+    std::vector<Script> scripts = {
+            {"sum", SAMPLES_DIR "/sum.cpm", default_input},
+            {"gcd", SAMPLES_DIR "/gcd.cpm", default_input},
+            {"multisum", SAMPLES_DIR "/multisum.cpm", SAMPLES_DIR "/multisum_input.txt"},
+    };
+    std::string socket = "/tmp/serve_bench." + std::to_string(getpid()) + ".sock";
+    pid_t server = start_server(socket, clients);
+    if (server < 0) {
+        fprintf(stderr, "Can't start %s --serve\n", INTERPRETER_PATH);
+        return 1;
+    }
+    printf("%-10s %14s %14s\n", "script", "cold, req/s", "served, req/s");
+    for (const auto &script : scripts) {
+        double process = cold(script, requests);
+        double resident = served(socket, script, requests, clients);
+        printf("%-10s %14.1f %14.1f\n", script.name.c_str(), process, resident);
+        fflush(stdout);
+    }
+    kill(server, SIGTERM);
+    waitpid(server, nullptr, 0);
+    unlink(socket.c_str());
+    std::remove(default_input.c_str());
+    return 0;
+}
@@ -0,0 +1,54 @@
+// Measures building a string with s = s + chunk in a loop; with in place
+// appends the time per byte stays flat as the string grows.
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <interpreter.h>
+
+CmdNode *simple(Node *node) {
+    auto cmd = new CmdNode(node);
+    cmd->setSimple();
+    return cmd;
+}
+
+// string s; for (int i = 0; i < iterations; i = i + 1) { s = s + chunk; }
+CmdListNode *build_program(int iterations, const std::string &chunk) {
+    auto program = new CmdListNode();
+    program->addCmd(simple(new CreateOperator(TypeIdentifyer::STRING_T, "s")));
+    auto body = new CmdListNode(simple(new AssignOperator(
+            "s", new PlusOperator(new VariableNode("s"),
+                                  new StringValueNode(chunk)))));
+    program->addCmd(new CmdNode(new ForOperatorNode(
+            new CreateOperator(TypeIdentifyer::INT_T, "i", new IntValueNode(0)),
+            new LessOperator(new VariableNode("i"), new IntValueNode(iterations)),
+            new AssignOperator("i", new PlusOperator(new VariableNode("i"),
+                                                     new IntValueNode(1))),
+            new CmdNode(body))));
+    return program;
+}
+
+void bench(Engine engine, size_t megabytes) {
+    const std::string chunk = "0123456789abcdef";
+    int iterations = static_cast<int>((megabytes << 20) / chunk.size());
+    std::unique_ptr<CmdListNode> program(build_program(iterations, chunk));
+    std::stringstream in, out;
+    Interpreter interpreter(in, out);
+    interpreter.set_engine(engine);
+    auto start = std::chrono::steady_clock::now();
+    interpreter.interpret(program.get());
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    printf("%-5s %4zu MB %10.3f s %8.2f ns/byte\n",
+           engine == Engine::TREE ? "tree" : "vm", megabytes, ns / 1e9,
+           ns / (megabytes << 20));
+}
+
+int main() {
+    for (auto engine : {Engine::TREE, Engine::BYTECODE}) {
+        for (size_t megabytes : {1, 2, 5, 10}) {
+            bench(engine, megabytes);
+        }
+    }
+    return 0;
+}
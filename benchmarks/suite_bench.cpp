@@ -0,0 +1,346 @@
+// Runs the samples and generated scale-up workloads through the parser and
+// the interpreter and reports time, ops/s, heap allocations and peak RSS.
+//
+//  suite_bench [--tree|--vm] [--jit] [-O0|-O1|-O2] [--scale X] [name...]
+//
+// With --jit the loops run by the tree engine are compiled to machine code.
+// Each run happens in a child process, so peak RSS is its own. Inputs are
+// generated with a fixed seed, so runs are comparable between builds.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <parser.h>
+#include <interpreter.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define SUITE_FORK 1
+#else
+#define SUITE_FORK 0
+#endif
+
+#ifndef SAMPLES_DIR
+#define SAMPLES_DIR "samples"
+#endif
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+    ++allocations;
+    if (void *ptr = malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+struct Workload {
+    std::string name;
+    std::string program; // file names
+    std::string input;
+    double ops;          // what the workload counts, for ops/s
+};
+
+struct Result {
+    double seconds;
+    size_t allocations;
+    long peak_kb;
+    bool ok;
+};
+
+struct Options {
+    Engine engine = Engine::TREE;
+    bool both = true;
+    int optimization = 1;
+    bool jit = false;
+    double scale = 1;
+    std::vector<std::string> names;
+};
+
+class Generator {
+public:
+    unsigned next(unsigned bound) {
+        seed_ = seed_ * 1103515245 + 12345;
+        return (seed_ >> 8) % bound;
+    }
+
+private:
+    unsigned seed_ = 2024;
+};
+
+std::string temp_file(const std::string &name, const std::string &content) {
+    std::string filename = "suite_bench." + name + ".tmp";
+    std::ofstream file(filename, std::ios::binary);
+    file << content;
+    return filename;
+}
+
+Workload multisum(size_t count) {
+    Generator gen;
+    std::string input = std::to_string(count) + "\n";
+    for (size_t i = 0; i < count; ++i) {
+        input += std::to_string(gen.next(1000));
+        input += i % 16 == 15 ? '\n' : ' ';
+    }
+    return {"multisum", SAMPLES_DIR "/multisum.cpm",
+            temp_file("multisum.in", input), double(count)};
+}
+
+// every iteration evaluates an expression tree of 2^depth leaves; leaves
+// are multiplied or taken modulo a constant, the rest is added up, so the
+// sum never overflows
+Workload deep_arithmetic(size_t iterations, int depth) {
+    Generator gen;
+    std::vector<std::string> level;
+    for (int i = 0; i < (1 << depth); i += 2) {
+        std::string constant = std::to_string(gen.next(9) + 1);
+        level.push_back("(i" + std::string(gen.next(2) ? " * " : " % ") +
+                        constant + ")");
+    }
+    while (level.size() > 1) {
+        std::vector<std::string> next;
+        for (size_t i = 0; i < level.size(); i += 2) {
+            const char *op = gen.next(2) ? " + " : " - ";
+            next.push_back("(" + level[i] + op + level[i + 1] + ")");
+        }
+        level.swap(next);
+    }
+    std::string program =
+            "int sum = 0;\n"
+            "for (int i = 0; i < " + std::to_string(iterations) + "; i = i + 1) {\n"
+            "    sum = sum + " + level[0] + " % 1000;\n"
+            "}\n"
+            "write_line(sum);\n";
+    return {"deep_arithmetic", temp_file("deep_arithmetic.cpm", program), "",
+            double(iterations)};
+}
+
+Workload string_concat(size_t iterations) {
+    std::string program =
+            "string s = \"\";\n"
+            "int total = 0;\n"
+            "for (int i = 0; i < " + std::to_string(iterations) + "; i = i + 1) {\n"
+            "    s = s + \"ab\";\n"
+            "    if (i % 1000 == 999) {\n"
+            "        total = total + 1;\n"
+            "        s = \"\";\n"
+            "    }\n"
+            "}\n"
+            "write_line(total);\n";
+    return {"string_concat", temp_file("string_concat.cpm", program), "",
+            double(iterations)};
+}
+
+Workload nested_scopes(size_t iterations, int depth) {
+    std::string body = "sum = sum + v" + std::to_string(depth - 1) + " % 7;\n";
+    for (int i = depth - 1; i >= 0; --i) {
+        std::string prev = i ? "v" + std::to_string(i - 1) : "i";
+        body = "{\nint v" + std::to_string(i) + " = " + prev + " + " +
+               std::to_string(i) + ";\n" + body + "}\n";
+    }
+    std::string program =
+            "int sum = 0;\n"
+            "for (int i = 0; i < " + std::to_string(iterations) + "; i = i + 1) " +
+            body + "write_line(sum);\n";
+    return {"nested_scopes", temp_file("nested_scopes.cpm", program), "",
+            double(iterations)};
+}
+
+bool selected(const Options &options, const std::string &name) {
+    if (options.names.empty()) {
+        return true;
+    }
+    for (const auto &prefix : options.names) {
+        if (name.compare(0, prefix.size(), prefix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// inputs are only generated for the selected workloads
+std::vector<Workload> workloads(const Options &options) {
+    auto scaled = [&options](double count) {
+        return static_cast<size_t>(count * options.scale) + 1;
+    };
+    std::vector<std::pair<std::string, std::function<Workload()>>> all = {
+            {"sample_sum", []() {
+                return Workload{"sample_sum", SAMPLES_DIR "/sum.cpm",
+                                temp_file("sum.in", "17 25\n"), 1};
+            }},
+            {"sample_gcd", []() {
+                return Workload{"sample_gcd", SAMPLES_DIR "/gcd.cpm",
+                                temp_file("gcd.in", "1134903170 1836311903\n"), 1};
+            }},
+            {"sample_binpow", []() {
+                return Workload{"sample_binpow", SAMPLES_DIR "/binpow.cpm",
+                                temp_file("binpow.in", "2 30\n"), 1};
+            }},
+            {"sample_multisum", []() {
+                return Workload{"sample_multisum", SAMPLES_DIR "/multisum.cpm",
+                                SAMPLES_DIR "/multisum_input.txt", 10};
+            }},
+            {"multisum", [&]() { return multisum(scaled(1e7)); }},
+            {"deep_arithmetic", [&]() { return deep_arithmetic(scaled(1e6), 6); }},
+            {"string_concat", [&]() { return string_concat(scaled(2e6)); }},
+            {"nested_scopes", [&]() { return nested_scopes(scaled(1e6), 8); }},
+    };
+    std::vector<Workload> list;
+    for (const auto &entry : all) {
+        if (selected(options, entry.first)) {
+            list.push_back(entry.second());
+        }
+    }
+    return list;
+}
+
+bool interpret(const Workload &workload, Engine engine, int optimization, bool jit) {
+    std::ostream null(nullptr);
+    Interpreter interpreter(std::cin, null);
+    ParserContext context(interpreter);
+    if (!context.open_file(workload.program.c_str())) {
+        return false;
+    }
+    interpreter.set_engine(engine);
+    interpreter.set_optimization(optimization);
+    interpreter.set_jit(jit);
+    interpreter.set_whole_program(true);
+    if (!workload.input.empty() && !interpreter.set_input(workload.input.c_str())) {
+        return false;
+    }
+    ArenaScope nodes(interpreter.arena());
+    context.parse();
+    interpreter.run_program();
+    return true;
+}
+
+// program output is dropped, so whatever the interpreter prints to
+// std::cout is an error
+bool run(const Workload &workload, Engine engine, int optimization, bool jit) {
+    std::stringstream errors;
+    auto out = std::cout.rdbuf(errors.rdbuf());
+    bool ok = interpret(workload, engine, optimization, jit);
+    std::cout.rdbuf(out);
+    return ok && errors.str().empty();
+}
+
+Result measure(const Workload &workload, Engine engine, int optimization, bool jit) {
+    Result result = {0, 0, 0, false};
+#if SUITE_FORK
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return result;
+    }
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        allocations = 0;
+        auto begin = std::chrono::steady_clock::now();
+        bool ok = run(workload, engine, optimization, jit);
+        auto end = std::chrono::steady_clock::now();
+        Result child = {std::chrono::duration<double>(end - begin).count(),
+                        allocations, 0, ok};
+        ssize_t written = write(fds[1], &child, sizeof(child));
+        _exit(written == sizeof(child) ? 0 : 1);
+    }
+    close(fds[1]);
+    ssize_t got = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+    int status = 0;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    if (got != sizeof(result) || !WIFEXITED(status) || WEXITSTATUS(status)) {
+        result.ok = false;
+    }
+#ifdef __APPLE__
+    result.peak_kb = usage.ru_maxrss / 1024;
+#else
+    result.peak_kb = usage.ru_maxrss;
+#endif
+#else
+    // a single run per process, the parser doesn't start over
+    allocations = 0;
+    auto start = std::chrono::steady_clock::now();
+    result.ok = run(workload, engine, optimization, jit);
+    result.allocations = allocations;
+    result.seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+#endif
+    return result;
+}
+
+bool parse_options(int argc, char *argv[], Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--tree" || arg == "--vm") {
+            options.both = false;
+            options.engine = arg == "--vm" ? Engine::BYTECODE : Engine::TREE;
+        } else if (arg == "--jit") {
+            options.jit = true;
+        } else if (arg.size() == 3 && arg[0] == '-' && arg[1] == 'O' &&
+                   arg[2] >= '0' && arg[2] - '0' <= Optimizer::MAX_LEVEL) {
+            options.optimization = arg[2] - '0';
+        } else if (arg == "--scale" && i + 1 < argc) {
+            options.scale = atof(argv[++i]);
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "Unknown option " << arg << "\n";
+            return false;
+        } else {
+            options.names.push_back(arg);
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        return 1;
+    }
+    std::vector<Engine> engines = {options.engine};
+    if (options.both) {
+        engines = {Engine::TREE, Engine::BYTECODE};
+    }
+    printf("%-18s %-5s %10s %14s %14s %12s\n", "workload", "engine",
+           "time, s", "ops/s", "allocations", "peak RSS, KB");
+    bool ok = true;
+    auto list = workloads(options);
+    for (const auto &workload : list) {
+        for (auto engine : engines) {
+            Result result = measure(workload, engine, options.optimization, options.jit);
+            const char *name = engine == Engine::BYTECODE ? "vm" : options.jit ? "jit" : "tree";
+            ok = ok && result.ok;
+            printf("%-18s %-5s %10.3f %14.0f %14zu %12ld%s\n", workload.name.c_str(),
+                   name, result.seconds,
+                   workload.ops / result.seconds, result.allocations,
+                   result.peak_kb, result.ok ? "" : "  FAILED");
+            fflush(stdout);
+        }
+    }
+    for (const auto &workload : list) {
+        if (workload.program.find(".tmp") != std::string::npos) {
+            std::remove(workload.program.c_str());
+        }
+        if (workload.input.find(".tmp") != std::string::npos) {
+            std::remove(workload.input.c_str());
+        }
+    }
+    return ok ? 0 : 1;
+}
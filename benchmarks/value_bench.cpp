@@ -0,0 +1,88 @@
+// Measures heap allocations and time per executed operator.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <syntax_tree.h>
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+    ++allocations;
+    if (void *ptr = malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void bench(const char *name, TypeIdentifyer type, const std::string &first,
+           const std::string &second, ExpressionNode *(*make)(ExpressionNode *, ExpressionNode *)) {
+    const int ITERATIONS = 10000000;
+    Machine machine;
+    Resolver resolver;
+    ExpressionNode *init_a = type == TypeIdentifyer::INT_T ?
+                             static_cast<ExpressionNode *>(new IntValueNode(first)) :
+                             new StringValueNode(first);
+    ExpressionNode *init_b = type == TypeIdentifyer::INT_T ?
+                             static_cast<ExpressionNode *>(new IntValueNode(second)) :
+                             new StringValueNode(second);
+    CreateOperator a(type, "a", init_a);
+    CreateOperator b(type, "b", init_b);
+    a.resolve(resolver);
+    b.resolve(resolver);
+    machine.resize_globals(resolver.globals());
+    a.evaluate(machine);
+    b.evaluate(machine);
+    std::unique_ptr<ExpressionNode> plus(make(new VariableNode("a"),
+                                              new VariableNode("b")));
+    plus->resolve(resolver);
+
+    // warm up the operand stack so its capacity is not counted
+    plus->evaluate(machine);
+    machine.pop();
+
+    size_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        plus->evaluate(machine);
+        machine.pop();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    printf("%-24s %10.3f allocs/op %10.2f ns/op\n", name,
+           double(allocations - before) / ITERATIONS, ns / ITERATIONS);
+}
+
+ExpressionNode *make_plus(ExpressionNode *left, ExpressionNode *right) {
+    return new PlusOperator(left, right);
+}
+
+ExpressionNode *make_eq(ExpressionNode *left, ExpressionNode *right) {
+    return new EqOperator(left, right);
+}
+
+// compares a variable with a string literal, like keyword matching does
+ExpressionNode *make_eq_literal(ExpressionNode *left, ExpressionNode *right) {
+    delete right;
+    return new EqOperator(left, new StringValueNode("keyword"));
+}
+
+int main() {
+    bench("PlusOperator int", TypeIdentifyer::INT_T, "17", "25", make_plus);
+    bench("PlusOperator string", TypeIdentifyer::STRING_T,
+          "a fairly long string operand", "another one", make_plus);
+    bench("EqOperator string", TypeIdentifyer::STRING_T,
+          "a fairly long string operand", "a fairly long string operand", make_eq);
+    bench("EqOperator literal", TypeIdentifyer::STRING_T,
+          "keyword", "unused", make_eq_literal);
+    return 0;
+}
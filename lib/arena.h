@@ -0,0 +1,165 @@
+#ifndef INTERPRETER_ARENA_H
+#define INTERPRETER_ARENA_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Bump allocator for syntax tree nodes. Objects allocated while an arena is
+// current (see ArenaScope) are placed next to each other and destroyed all
+// at once by release(), newest first. Objects allocated with no current
+// arena go to the heap; both kinds carry a header telling them apart.
+class Arena {
+public:
+    typedef void (*Destructor)(void *object);
+
+    explicit Arena(size_t block_size = 4096) : block_size_(block_size) {}
+
+    Arena(const Arena &) = delete;
+
+    Arena &operator=(const Arena &) = delete;
+
+    ~Arena() {
+        release();
+        for (auto block : blocks_) {
+            std::free(block.data);
+        }
+    }
+
+    // memory for an object that is destroyed with destructor on release()
+    static void *allocate(Arena *arena, size_t size, Destructor destructor) {
+        Header *header;
+        if (arena) {
+            header = static_cast<Header *>(arena->bump_(HEADER + size));
+            header->prev = arena->last_;
+            arena->last_ = header;
+            ++arena->objects_;
+        } else {
+            header = static_cast<Header *>(::operator new(HEADER + size));
+            header->prev = nullptr;
+        }
+        header->arena = arena;
+        header->destructor = destructor;
+        return reinterpret_cast<char *>(header) + HEADER;
+    }
+
+    // called after the object was destroyed by delete; arena memory is
+    // only reclaimed by release()
+    static void deallocate(void *object) {
+        Header *header = header_(object);
+        if (header->arena) {
+            header->destructor = nullptr;
+        } else {
+            ::operator delete(header);
+        }
+    }
+
+    // arena holding the object, nullptr for heap objects
+    static Arena *owner(const void *object) {
+        return header_(object)->arena;
+    }
+
+    // per thread, so that interpreters on different threads don't mix
+    // their nodes
+    static Arena *&current() {
+        static thread_local Arena *current = nullptr;
+        return current;
+    }
+
+    void release() {
+        for (Header *header = last_; header; header = header->prev) {
+            if (header->destructor) {
+                header->destructor(reinterpret_cast<char *>(header) + HEADER);
+            }
+        }
+        last_ = nullptr;
+        objects_ = 0;
+        // the first block is kept for the next statement
+        for (size_t i = 1; i < blocks_.size(); ++i) {
+            std::free(blocks_[i].data);
+        }
+        if (!blocks_.empty()) {
+            blocks_.resize(1);
+            blocks_[0].used = 0;
+        }
+    }
+
+    size_t objects() const {
+        return objects_;
+    }
+
+    size_t used() const {
+        size_t used = 0;
+        for (const auto &block : blocks_) {
+            used += block.used;
+        }
+        return used;
+    }
+
+private:
+    struct Header {
+        Arena *arena;
+        Destructor destructor;
+        Header *prev;
+    };
+
+    struct Block {
+        char *data;
+        size_t size;
+        size_t used;
+    };
+
+    static const size_t ALIGN = alignof(std::max_align_t);
+    static const size_t HEADER = (sizeof(Header) + ALIGN - 1) / ALIGN * ALIGN;
+
+    size_t block_size_;
+    std::vector<Block> blocks_;
+    Header *last_ = nullptr;
+    size_t objects_ = 0;
+
+    static Header *header_(const void *object) {
+        return reinterpret_cast<Header *>(
+                const_cast<char *>(static_cast<const char *>(object)) - HEADER);
+    }
+
+    void *bump_(size_t size) {
+        size = (size + ALIGN - 1) / ALIGN * ALIGN;
+        if (blocks_.empty() || blocks_.back().size - blocks_.back().used < size) {
+            size_t block_size = blocks_.empty() ? block_size_ : blocks_.back().size * 2;
+            while (block_size < size) {
+                block_size *= 2;
+            }
+            auto data = static_cast<char *>(std::malloc(block_size));
+            if (!data) {
+                throw std::bad_alloc();
+            }
+            blocks_.push_back({data, block_size, 0});
+        }
+        auto &block = blocks_.back();
+        void *ptr = block.data + block.used;
+        block.used += size;
+        return ptr;
+    }
+};
+
+// makes the arena current for the lifetime of the scope
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena &arena) : prev_(Arena::current()) {
+        Arena::current() = &arena;
+    }
+
+    ArenaScope(const ArenaScope &) = delete;
+
+    ArenaScope &operator=(const ArenaScope &) = delete;
+
+    ~ArenaScope() {
+        Arena::current() = prev_;
+    }
+
+private:
+    Arena *prev_;
+};
+
+#endif //INTERPRETER_ARENA_H
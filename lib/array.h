@@ -0,0 +1,121 @@
+#ifndef INTERPRETER_ARRAY_H
+#define INTERPRETER_ARRAY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <simd.h>
+
+// Arrays are contiguous vectors of their elements. The interpreter keeps
+// them in ArrayRep, shared between values until one of them writes; the
+// programs translated with --emit-c keep plain vectors. Both check indexes
+// and sizes with the functions below, so the errors are the same.
+
+// at most this many elements, so a counter one step past the last index
+// still fits in an int
+const int MAX_ARRAY_SIZE = 1 << 30;
+
+const std::string INDEX_OUT_OF_RANGE = "Array index out of range";
+
+inline size_t array_size(int size) {
+    if (size < 0 || size > MAX_ARRAY_SIZE) {
+        throw std::invalid_argument("Bad array size " + std::to_string(size));
+    }
+    return static_cast<size_t>(size);
+}
+
+inline void check_index(int index, size_t size) {
+    if (static_cast<unsigned>(index) >= size) {
+        throw std::out_of_range(INDEX_OUT_OF_RANGE);
+    }
+}
+
+// an array built element by element can't grow past MAX_ARRAY_SIZE either
+inline void check_array_size(size_t size) {
+    if (size > static_cast<size_t>(MAX_ARRAY_SIZE)) {
+        throw std::invalid_argument("Bad array size " + std::to_string(size));
+    }
+}
+
+template <class T>
+T &array_at(std::vector<T> &items, int index) {
+    check_index(index, items.size());
+    return items[index];
+}
+
+template <class T>
+std::vector<T> make_array(int size) {
+    return std::vector<T>(array_size(size));
+}
+
+inline int64_t array_sum(const std::vector<int> &items) {
+    return IntKernels::sum(items.data(), items.size());
+}
+
+inline int array_min(const std::vector<int> &items) {
+    if (items.empty()) {
+        throw std::invalid_argument("Empty array");
+    }
+    return IntKernels::min(items.data(), items.size());
+}
+
+inline int array_max(const std::vector<int> &items) {
+    if (items.empty()) {
+        throw std::invalid_argument("Empty array");
+    }
+    return IntKernels::max(items.data(), items.size());
+}
+
+inline int array_count(const std::vector<int> &items, int val) {
+    return static_cast<int>(IntKernels::count(items.data(), items.size(), val));
+}
+
+template <class T>
+int array_count(const std::vector<T> &items, const T &val) {
+    return static_cast<int>(std::count(items.begin(), items.end(), val));
+}
+
+inline void array_fill(std::vector<int> &items, int val) {
+    IntKernels::fill(items.data(), items.size(), val);
+}
+
+template <class T>
+void array_fill(std::vector<T> &items, const T &val) {
+    std::fill(items.begin(), items.end(), val);
+}
+
+// elements of an array value; the counter is not atomic, like the one of
+// StringRep
+template <class T>
+class ArrayRep {
+public:
+    typedef std::vector<T> Items;
+
+    explicit ArrayRep(std::vector<T> items) : items_(std::move(items)) {}
+
+    std::vector<T> &items() {
+        return items_;
+    }
+
+    bool shared() const {
+        return refs_ > 1;
+    }
+
+    void retain() {
+        ++refs_;
+    }
+
+    void release() {
+        if (--refs_ == 0) {
+            delete this;
+        }
+    }
+
+private:
+    int refs_ = 1;
+    std::vector<T> items_;
+};
+
+#endif //INTERPRETER_ARRAY_H
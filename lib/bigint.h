@@ -0,0 +1,613 @@
+#ifndef INTERPRETER_BIGINT_H
+#define INTERPRETER_BIGINT_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Integer of any size: the sign and the magnitude in base 10^9 digits, the
+// least significant first, with no leading zero digits. The decimal base
+// makes reading and writing linear; long products are split by Karatsuba.
+class BigInt {
+public:
+    static const uint32_t BASE = 1000000000;
+    static const int BASE_DIGITS = 9;
+
+    BigInt() = default;
+
+    explicit BigInt(int64_t val) : negative_(val < 0) {
+        uint64_t magnitude = negative_ ? 0 - static_cast<uint64_t>(val) :
+                             static_cast<uint64_t>(val);
+        for (; magnitude; magnitude /= BASE) {
+            digits_.push_back(static_cast<uint32_t>(magnitude % BASE));
+        }
+    }
+
+    // decimal digits without a sign, at least one
+    static BigInt parse(const char *begin, const char *end, bool negative) {
+        BigInt result;
+        result.digits_.reserve((end - begin) / BASE_DIGITS + 1);
+        for (const char *stop = end; stop != begin;) {
+            const char *start = stop - begin > BASE_DIGITS ? stop - BASE_DIGITS : begin;
+            uint32_t digit = 0;
+            for (const char *pos = start; pos != stop; ++pos) {
+                digit = digit * 10 + (*pos - '0');
+            }
+            result.digits_.push_back(digit);
+            stop = start;
+        }
+        trim_(result.digits_);
+        result.negative_ = negative && !result.digits_.empty();
+        return result;
+    }
+
+    std::string to_string() const {
+        if (digits_.empty()) {
+            return "0";
+        }
+        std::string result = negative_ ? "-" : "";
+        result.reserve(digits_.size() * BASE_DIGITS + 1);
+        result += std::to_string(digits_.back());
+        char group[BASE_DIGITS];
+        for (size_t i = digits_.size() - 1; i-- > 0;) {
+            uint32_t digit = digits_[i];
+            for (int j = BASE_DIGITS; j-- > 0; digit /= 10) {
+                group[j] = static_cast<char>('0' + digit % 10);
+            }
+            result.append(group, BASE_DIGITS);
+        }
+        return result;
+    }
+
+    bool negative() const {
+        return negative_;
+    }
+
+    bool zero() const {
+        return digits_.empty();
+    }
+
+    // false if the value doesn't fit in 64 bits
+    bool to_int64(int64_t &val) const {
+        uint64_t magnitude = 0;
+        for (size_t i = digits_.size(); i-- > 0;) {
+            if (magnitude > (UINT64_MAX - digits_[i]) / BASE) {
+                return false;
+            }
+            magnitude = magnitude * BASE + digits_[i];
+        }
+        uint64_t limit = static_cast<uint64_t>(INT64_MAX) + (negative_ ? 1 : 0);
+        if (magnitude > limit) {
+            return false;
+        }
+        val = negative_ ? (magnitude == limit ? INT64_MIN : -static_cast<int64_t>(magnitude)) :
+              static_cast<int64_t>(magnitude);
+        return true;
+    }
+
+    BigInt operator-() const {
+        BigInt result = *this;
+        result.negative_ = !negative_ && !digits_.empty();
+        return result;
+    }
+
+    friend BigInt operator+(const BigInt &fval, const BigInt &sval) {
+        if (fval.negative_ != sval.negative_) {
+            return difference_(fval.digits_, sval.digits_, fval.negative_);
+        }
+        return BigInt(add_(fval.digits_, sval.digits_), fval.negative_);
+    }
+
+    friend BigInt operator-(const BigInt &fval, const BigInt &sval) {
+        if (fval.negative_ == sval.negative_) {
+            return difference_(fval.digits_, sval.digits_, fval.negative_);
+        }
+        return BigInt(add_(fval.digits_, sval.digits_), fval.negative_);
+    }
+
+    friend BigInt operator*(const BigInt &fval, const BigInt &sval) {
+        return BigInt(multiply_(fval.digits_, sval.digits_),
+                      fval.negative_ != sval.negative_);
+    }
+
+    // the quotient is rounded toward zero and the remainder has the sign of
+    // the dividend, like for ints
+    static void divide(const BigInt &fval, const BigInt &sval,
+                       BigInt &quotient, BigInt &remainder) {
+        if (sval.zero()) {
+            throw std::runtime_error("Division by zero.");
+        }
+        Digits q, r;
+        divide_(fval.digits_, sval.digits_, q, r);
+        quotient = BigInt(std::move(q), fval.negative_ != sval.negative_);
+        remainder = BigInt(std::move(r), fval.negative_);
+    }
+
+    static int compare(const BigInt &fval, const BigInt &sval) {
+        if (fval.negative_ != sval.negative_) {
+            return fval.negative_ ? -1 : 1;
+        }
+        int result = compare_(fval.digits_, sval.digits_);
+        return fval.negative_ ? -result : result;
+    }
+
+private:
+    typedef std::vector<uint32_t> Digits;
+
+    // shorter factors are multiplied digit by digit
+    static const size_t KARATSUBA_THRESHOLD = 32;
+
+    bool negative_ = false;
+    Digits digits_;
+
+    BigInt(Digits digits, bool negative) : digits_(std::move(digits)) {
+        trim_(digits_);
+        negative_ = negative && !digits_.empty();
+    }
+
+    static void trim_(Digits &digits) {
+        while (!digits.empty() && digits.back() == 0) {
+            digits.pop_back();
+        }
+    }
+
+    static int compare_(const Digits &fval, const Digits &sval) {
+        if (fval.size() != sval.size()) {
+            return fval.size() < sval.size() ? -1 : 1;
+        }
+        for (size_t i = fval.size(); i-- > 0;) {
+            if (fval[i] != sval[i]) {
+                return fval[i] < sval[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    static Digits add_(const Digits &fval, const Digits &sval) {
+        const Digits &longer = fval.size() < sval.size() ? sval : fval;
+        const Digits &shorter = fval.size() < sval.size() ? fval : sval;
+        Digits result(longer.size() + 1);
+        uint32_t carry = 0;
+        for (size_t i = 0; i < longer.size(); ++i) {
+            uint32_t sum = longer[i] + (i < shorter.size() ? shorter[i] : 0) + carry;
+            carry = sum >= BASE;
+            result[i] = carry ? sum - BASE : sum;
+        }
+        result.back() = carry;
+        trim_(result);
+        return result;
+    }
+
+    // fval - sval, fval is not less than sval
+    static Digits subtract_(const Digits &fval, const Digits &sval) {
+        Digits result(fval.size());
+        uint32_t borrow = 0;
+        for (size_t i = 0; i < fval.size(); ++i) {
+            uint32_t part = (i < sval.size() ? sval[i] : 0) + borrow;
+            borrow = fval[i] < part;
+            result[i] = borrow ? fval[i] + BASE - part : fval[i] - part;
+        }
+        trim_(result);
+        return result;
+    }
+
+    // |fval| - |sval| where fval has the given sign
+    static BigInt difference_(const Digits &fval, const Digits &sval, bool negative) {
+        if (compare_(fval, sval) < 0) {
+            return BigInt(subtract_(sval, fval), !negative);
+        }
+        return BigInt(subtract_(fval, sval), negative);
+    }
+
+    // adds addend * BASE^shift to the target
+    static void add_shifted_(Digits &target, const Digits &addend, size_t shift) {
+        if (target.size() < shift + addend.size() + 1) {
+            target.resize(shift + addend.size() + 1);
+        }
+        uint32_t carry = 0;
+        for (size_t i = 0; i < addend.size() || carry; ++i) {
+            if (shift + i == target.size()) {
+                target.push_back(0);
+            }
+            uint32_t sum = target[shift + i] + (i < addend.size() ? addend[i] : 0) + carry;
+            carry = sum >= BASE;
+            target[shift + i] = carry ? sum - BASE : sum;
+        }
+    }
+
+    static Digits schoolbook_(const Digits &longer, const Digits &shorter) {
+        Digits result(longer.size() + shorter.size());
+        for (size_t i = 0; i < shorter.size(); ++i) {
+            uint64_t factor = shorter[i];
+            uint64_t carry = 0;
+            for (size_t j = 0; j < longer.size(); ++j) {
+                uint64_t cur = result[i + j] + factor * longer[j] + carry;
+                result[i + j] = static_cast<uint32_t>(cur % BASE);
+                carry = cur / BASE;
+            }
+            result[i + longer.size()] = static_cast<uint32_t>(carry);
+        }
+        trim_(result);
+        return result;
+    }
+
+    // (a1 B^k + a0)(b1 B^k + b0) = a1 b1 B^2k + ((a0 + a1)(b0 + b1) - a0 b0 - a1 b1) B^k + a0 b0
+    static Digits multiply_(const Digits &fval, const Digits &sval) {
+        const Digits &longer = fval.size() < sval.size() ? sval : fval;
+        const Digits &shorter = fval.size() < sval.size() ? fval : sval;
+        if (shorter.size() < KARATSUBA_THRESHOLD) {
+            return schoolbook_(longer, shorter);
+        }
+        size_t half = (longer.size() + 1) / 2;
+        Digits low0(longer.begin(), longer.begin() + half);
+        Digits high0(longer.begin() + half, longer.end());
+        trim_(low0);
+        Digits result;
+        if (shorter.size() <= half) {
+            // the shorter factor has no high half, the longer one is split
+            result = multiply_(low0, shorter);
+            add_shifted_(result, multiply_(high0, shorter), half);
+            trim_(result);
+            return result;
+        }
+        Digits low1(shorter.begin(), shorter.begin() + half);
+        Digits high1(shorter.begin() + half, shorter.end());
+        trim_(low1);
+        Digits low = multiply_(low0, low1);
+        Digits high = multiply_(high0, high1);
+        Digits middle = multiply_(add_(low0, high0), add_(low1, high1));
+        middle = subtract_(subtract_(middle, low), high);
+        result = low;
+        add_shifted_(result, middle, half);
+        add_shifted_(result, high, 2 * half);
+        trim_(result);
+        return result;
+    }
+
+    static Digits multiply_small_(const Digits &digits, uint32_t factor) {
+        Digits result(digits.size() + 1);
+        uint64_t carry = 0;
+        for (size_t i = 0; i < digits.size(); ++i) {
+            uint64_t cur = static_cast<uint64_t>(digits[i]) * factor + carry;
+            result[i] = static_cast<uint32_t>(cur % BASE);
+            carry = cur / BASE;
+        }
+        result.back() = static_cast<uint32_t>(carry);
+        return result;
+    }
+
+    // returns the remainder
+    static uint32_t divide_small_(const Digits &digits, uint32_t divisor, Digits &quotient) {
+        quotient.assign(digits.size(), 0);
+        uint64_t remainder = 0;
+        for (size_t i = digits.size(); i-- > 0;) {
+            uint64_t cur = remainder * BASE + digits[i];
+            quotient[i] = static_cast<uint32_t>(cur / divisor);
+            remainder = cur % divisor;
+        }
+        trim_(quotient);
+        return static_cast<uint32_t>(remainder);
+    }
+
+    // Knuth's algorithm D: both are scaled so the divisor's top digit is at
+    // least BASE / 2, then a digit of the quotient guessed from the top
+    // digits is never more than 2 off
+    static void divide_(const Digits &dividend, const Digits &divisor,
+                        Digits &quotient, Digits &remainder) {
+        if (compare_(dividend, divisor) < 0) {
+            quotient.clear();
+            remainder = dividend;
+            return;
+        }
+        if (divisor.size() == 1) {
+            uint32_t rest = divide_small_(dividend, divisor[0], quotient);
+            remainder.assign(rest ? 1 : 0, rest);
+            return;
+        }
+        uint32_t scale = BASE / (divisor.back() + 1);
+        Digits u = multiply_small_(dividend, scale);
+        Digits v = multiply_small_(divisor, scale);
+        v.pop_back();
+        size_t n = v.size();
+        size_t m = dividend.size() - n;
+        quotient.assign(m + 1, 0);
+        for (size_t j = m + 1; j-- > 0;) {
+            uint64_t top = static_cast<uint64_t>(u[j + n]) * BASE + u[j + n - 1];
+            uint64_t guess = top / v[n - 1];
+            uint64_t rest = top % v[n - 1];
+            while (guess >= BASE || guess * v[n - 2] > rest * BASE + u[j + n - 2]) {
+                --guess;
+                rest += v[n - 1];
+                if (rest >= BASE) {
+                    break;
+                }
+            }
+            uint64_t carry = 0;
+            uint32_t borrow = 0;
+            for (size_t i = 0; i < n; ++i) {
+                uint64_t product = guess * v[i] + carry;
+                carry = product / BASE;
+                uint32_t part = static_cast<uint32_t>(product % BASE) + borrow;
+                borrow = u[i + j] < part;
+                u[i + j] = borrow ? u[i + j] + BASE - part : u[i + j] - part;
+            }
+            uint64_t part = carry + borrow;
+            if (u[j + n] < part) {
+                // the guess was one too big, the divisor is added back
+                u[j + n] = static_cast<uint32_t>(u[j + n] + BASE - part);
+                --guess;
+                uint32_t sum_carry = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    uint32_t sum = u[i + j] + v[i] + sum_carry;
+                    sum_carry = sum >= BASE;
+                    u[i + j] = sum_carry ? sum - BASE : sum;
+                }
+                u[j + n] = (u[j + n] + sum_carry) % BASE;
+            } else {
+                u[j + n] -= static_cast<uint32_t>(part);
+            }
+            quotient[j] = static_cast<uint32_t>(guess);
+        }
+        trim_(quotient);
+        u.resize(n);
+        trim_(u);
+        divide_small_(u, scale, remainder);
+    }
+};
+
+// storage of a BigInt shared between longs; the counter is not atomic,
+// longs are never shared between threads
+class BigRep {
+public:
+    explicit BigRep(BigInt value) : value_(std::move(value)) {}
+
+    const BigInt &value() const {
+        return value_;
+    }
+
+    void retain() {
+        ++refs_;
+    }
+
+    void release() {
+        if (--refs_ == 0) {
+            delete this;
+        }
+    }
+
+private:
+    int refs_ = 1;
+    BigInt value_;
+};
+
+// Value of the long type: a 64-bit integer while it fits, a BigInt after an
+// operation overflows. Every operation on two 64-bit values is done in
+// machine arithmetic with an overflow check and only redone on BigInts if
+// it overflows; a result that fits in 64 bits is 64-bit again.
+class Long {
+public:
+    Long(int64_t val = 0) : small_(val) {}
+
+    explicit Long(BigInt val) {
+        if (!val.to_int64(small_)) {
+            big_ = new BigRep(std::move(val));
+        }
+    }
+
+    // decimal digits without a sign, at least one
+    static Long parse(const char *begin, const char *end, bool negative) {
+        if (end - begin < 19) {
+            int64_t val = 0;
+            for (const char *pos = begin; pos != end; ++pos) {
+                val = val * 10 + (*pos - '0');
+            }
+            return Long(negative ? -val : val);
+        }
+        return Long(BigInt::parse(begin, end, negative));
+    }
+
+    static Long parse(const std::string &str) {
+        bool negative = !str.empty() && str[0] == '-';
+        return parse(str.data() + negative, str.data() + str.size(), negative);
+    }
+
+    // takes over a reference to the storage
+    static Long adopt(BigRep *rep) {
+        Long val;
+        val.big_ = rep;
+        return val;
+    }
+
+    Long(const Long &other) : small_(other.small_), big_(other.big_) {
+        if (big_) {
+            big_->retain();
+        }
+    }
+
+    Long(Long &&other) noexcept : small_(other.small_), big_(other.big_) {
+        other.big_ = nullptr;
+    }
+
+    Long &operator=(Long other) noexcept {
+        std::swap(small_, other.small_);
+        std::swap(big_, other.big_);
+        return *this;
+    }
+
+    ~Long() {
+        if (big_) {
+            big_->release();
+        }
+    }
+
+    bool is_small() const {
+        return !big_;
+    }
+
+    int64_t small() const {
+        return small_;
+    }
+
+    // the storage of a value that doesn't fit in 64 bits, the reference
+    // goes to the caller
+    BigRep *release() {
+        auto rep = big_;
+        big_ = nullptr;
+        return rep;
+    }
+
+    std::string to_string() const {
+        return big_ ? big_->value().to_string() : std::to_string(small_);
+    }
+
+    friend Long operator+(const Long &fval, const Long &sval) {
+        int64_t result;
+        if (!fval.big_ && !sval.big_ && !add_overflow_(fval.small_, sval.small_, result)) {
+            return Long(result);
+        }
+        BigInt ftemp, stemp;
+        return Long(fval.wide_(ftemp) + sval.wide_(stemp));
+    }
+
+    friend Long operator-(const Long &fval, const Long &sval) {
+        int64_t result;
+        if (!fval.big_ && !sval.big_ && !sub_overflow_(fval.small_, sval.small_, result)) {
+            return Long(result);
+        }
+        BigInt ftemp, stemp;
+        return Long(fval.wide_(ftemp) - sval.wide_(stemp));
+    }
+
+    friend Long operator*(const Long &fval, const Long &sval) {
+        int64_t result;
+        if (!fval.big_ && !sval.big_ && !mul_overflow_(fval.small_, sval.small_, result)) {
+            return Long(result);
+        }
+        BigInt ftemp, stemp;
+        return Long(fval.wide_(ftemp) * sval.wide_(stemp));
+    }
+
+    friend Long operator/(const Long &fval, const Long &sval) {
+        if (!fval.big_ && !sval.big_) {
+            if (sval.small_ == 0) {
+                throw std::runtime_error("Division by zero.");
+            }
+            // INT64_MIN / -1 is the one quotient that overflows
+            return sval.small_ == -1 ? -fval : Long(fval.small_ / sval.small_);
+        }
+        return fval.wide_divide_(sval, false);
+    }
+
+    friend Long operator%(const Long &fval, const Long &sval) {
+        if (!fval.big_ && !sval.big_) {
+            if (sval.small_ == 0) {
+                throw std::runtime_error("Division by zero.");
+            }
+            return Long(sval.small_ == -1 ? 0 : fval.small_ % sval.small_);
+        }
+        return fval.wide_divide_(sval, true);
+    }
+
+    Long operator-() const {
+        if (!big_ && small_ != INT64_MIN) {
+            return Long(-small_);
+        }
+        BigInt temp;
+        return Long(-wide_(temp));
+    }
+
+    // big values never fit in 64 bits, so they are beyond all small ones
+    static int compare(const Long &fval, const Long &sval) {
+        if (!fval.big_ && !sval.big_) {
+            return (fval.small_ > sval.small_) - (fval.small_ < sval.small_);
+        }
+        BigInt ftemp, stemp;
+        return BigInt::compare(fval.wide_(ftemp), sval.wide_(stemp));
+    }
+
+    friend bool operator==(const Long &fval, const Long &sval) {
+        return compare(fval, sval) == 0;
+    }
+
+    friend bool operator!=(const Long &fval, const Long &sval) {
+        return compare(fval, sval) != 0;
+    }
+
+    friend bool operator<(const Long &fval, const Long &sval) {
+        return compare(fval, sval) < 0;
+    }
+
+    friend bool operator>(const Long &fval, const Long &sval) {
+        return compare(fval, sval) > 0;
+    }
+
+    friend bool operator<=(const Long &fval, const Long &sval) {
+        return compare(fval, sval) <= 0;
+    }
+
+    friend bool operator>=(const Long &fval, const Long &sval) {
+        return compare(fval, sval) >= 0;
+    }
+
+private:
+    int64_t small_ = 0;
+    BigRep *big_ = nullptr;
+
+    // the value as a BigInt, a small one is converted into temp
+    const BigInt &wide_(BigInt &temp) const {
+        if (big_) {
+            return big_->value();
+        }
+        temp = BigInt(small_);
+        return temp;
+    }
+
+    Long wide_divide_(const Long &divisor, bool remainder) const {
+        BigInt ftemp, stemp, quotient, rest;
+        BigInt::divide(wide_(ftemp), divisor.wide_(stemp), quotient, rest);
+        return Long(std::move(remainder ? rest : quotient));
+    }
+
+#if defined(__GNUC__) || defined(__clang__)
+    static bool add_overflow_(int64_t fval, int64_t sval, int64_t &result) {
+        return __builtin_add_overflow(fval, sval, &result);
+    }
+
+    static bool sub_overflow_(int64_t fval, int64_t sval, int64_t &result) {
+        return __builtin_sub_overflow(fval, sval, &result);
+    }
+
+    static bool mul_overflow_(int64_t fval, int64_t sval, int64_t &result) {
+        return __builtin_mul_overflow(fval, sval, &result);
+    }
+#else
+    static bool add_overflow_(int64_t fval, int64_t sval, int64_t &result) {
+        if ((sval > 0 && fval > INT64_MAX - sval) || (sval < 0 && fval < INT64_MIN - sval)) {
+            return true;
+        }
+        result = fval + sval;
+        return false;
+    }
+
+    static bool sub_overflow_(int64_t fval, int64_t sval, int64_t &result) {
+        if ((sval < 0 && fval > INT64_MAX + sval) || (sval > 0 && fval < INT64_MIN + sval)) {
+            return true;
+        }
+        result = fval - sval;
+        return false;
+    }
+
+    static bool mul_overflow_(int64_t fval, int64_t sval, int64_t &result) {
+        if (fval > 0 ? (sval > 0 ? fval > INT64_MAX / sval : sval < INT64_MIN / fval) :
+            (sval > 0 ? fval < INT64_MIN / sval : fval != 0 && sval < INT64_MAX / fval)) {
+            return true;
+        }
+        result = fval * sval;
+        return false;
+    }
+#endif
+};
+
+#endif //INTERPRETER_BIGINT_H
@@ -0,0 +1,292 @@
+#ifndef INTERPRETER_BYTECODE_H
+#define INTERPRETER_BYTECODE_H
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <machine.h>
+#include <enums.h>
+
+// X(name, register operands mask): bit 0 - a, bit 1 - b, bit 2 - c
+#define INTERPRETER_OPCODES(X) \
+    X(LOAD_INT, 1)   \
+    X(LOAD_STR, 1)   \
+    X(MOVE, 3)       \
+    X(DECL, 1)       \
+    X(ASSIGN, 3)     \
+    X(APPEND, 3)     \
+    X(ADD, 7)        \
+    X(SUB, 7)        \
+    X(MUL, 7)        \
+    X(DIV, 7)        \
+    X(MOD, 7)        \
+    X(AND, 7)        \
+    X(OR, 7)         \
+    X(EQ, 7)         \
+    X(NOT_EQ, 7)     \
+    X(LESS, 7)       \
+    X(GR, 7)         \
+    X(LESS_EQ, 7)    \
+    X(GR_EQ, 7)      \
+    X(NOT, 3)        \
+    X(NEG, 3)        \
+    X(INT_ADD, 7)    \
+    X(INT_SUB, 7)    \
+    X(INT_MUL, 7)    \
+    X(INT_DIV, 7)    \
+    X(INT_MOD, 7)    \
+    X(INT_AND, 7)    \
+    X(INT_OR, 7)     \
+    X(INT_EQ, 7)     \
+    X(INT_NOT_EQ, 7) \
+    X(INT_LESS, 7)   \
+    X(INT_GR, 7)     \
+    X(INT_LESS_EQ, 7) \
+    X(INT_GR_EQ, 7)  \
+    X(INT_NOT, 3)    \
+    X(INT_NEG, 3)    \
+    X(LOAD_LONG, 1)  \
+    X(WIDEN, 3)      \
+    X(LONG_ADD, 7)   \
+    X(LONG_SUB, 7)   \
+    X(LONG_MUL, 7)   \
+    X(LONG_DIV, 7)   \
+    X(LONG_MOD, 7)   \
+    X(LONG_EQ, 7)    \
+    X(LONG_NOT_EQ, 7) \
+    X(LONG_LESS, 7)  \
+    X(LONG_GR, 7)    \
+    X(LONG_LESS_EQ, 7) \
+    X(LONG_GR_EQ, 7) \
+    X(LONG_NEG, 3)   \
+    X(NEW_ARRAY, 3)  \
+    X(INDEX, 7)      \
+    X(INDEX_UNCHECKED, 7) \
+    X(STORE_INDEX, 7) \
+    X(STORE_INDEX_UNCHECKED, 7) \
+    X(IN_BOUNDS, 7)  \
+    X(ARRAY_SIZE, 3) \
+    X(ARRAY_SUM, 3)  \
+    X(ARRAY_MIN, 3)  \
+    X(ARRAY_MAX, 3)  \
+    X(ARRAY_COUNT, 7) \
+    X(ARRAY_FILL, 3) \
+    X(MAP_GET, 7)    \
+    X(MAP_CONTAINS, 7) \
+    X(MAP_KEYS, 3)   \
+    X(MAP_VALUES, 3) \
+    X(MAP_INSERT, 7) \
+    X(MAP_ADD, 7)    \
+    X(JUMP, 0)       \
+    X(JUMP_FALSE, 1) \
+    X(READ_INT, 1)   \
+    X(READ_LONG, 1)  \
+    X(READ_WORD, 1)  \
+    X(READ_LINE, 1)  \
+    X(READ_INTS, 3)  \
+    X(READ_ALL_WORDS, 1) \
+    X(WRITE, 1)      \
+    X(WRITE_LINE, 1) \
+    X(EXIT, 0)       \
+    X(HALT, 0)
+
+enum class OpCode : unsigned char {
+#define INTERPRETER_OPCODE_ENUM(name, regs) name,
+    INTERPRETER_OPCODES(INTERPRETER_OPCODE_ENUM)
+#undef INTERPRETER_OPCODE_ENUM
+};
+
+inline int register_operands(OpCode op) {
+    static const int masks[] = {
+#define INTERPRETER_OPCODE_MASK(name, regs) regs,
+            INTERPRETER_OPCODES(INTERPRETER_OPCODE_MASK)
+#undef INTERPRETER_OPCODE_MASK
+    };
+    return masks[static_cast<int>(op)];
+}
+
+inline const char *opcode_name(OpCode op) {
+    static const char *names[] = {
+#define INTERPRETER_OPCODE_NAME(name, regs) #name,
+            INTERPRETER_OPCODES(INTERPRETER_OPCODE_NAME)
+#undef INTERPRETER_OPCODE_NAME
+    };
+    return names[static_cast<int>(op)];
+}
+
+// a - destination register (or jump target for JUMP, the array written by
+// STORE_INDEX and ARRAY_FILL, the map written by MAP_INSERT and MAP_ADD),
+// b, c - source registers, immediate, constant index or jump target
+struct Instruction {
+    OpCode op;
+    int a;
+    int b;
+    int c;
+};
+
+class Chunk {
+public:
+    const std::vector<Instruction> &code() const {
+        return code_;
+    }
+
+    const std::vector<Value> &constants() const {
+        return constants_;
+    }
+
+    size_t registers() const {
+        return registers_;
+    }
+
+private:
+    friend class Compiler;
+    friend class ScriptCache;
+
+    std::vector<Instruction> code_;
+    std::vector<Value> constants_;
+    size_t registers_ = 0;
+};
+
+class Compiler {
+public:
+    static const int NO_REG = -1;
+
+    // variables of the global frame occupy registers [0, globals)
+    void begin(int globals) {
+        chunk_ = Chunk();
+        frames_.assign(1, {0, globals});
+        max_vars_ = std::max(max_vars_, globals);
+        temps_ = 0;
+        max_temps_ = 0;
+        bounds_.clear();
+    }
+
+    Chunk finish() {
+        emit(OpCode::HALT);
+        for (auto &instr : chunk_.code_) {
+            int mask = register_operands(instr.op);
+            relocate_(instr.a, mask & 1);
+            relocate_(instr.b, mask & 2);
+            relocate_(instr.c, mask & 4);
+        }
+        chunk_.registers_ = static_cast<size_t>(max_vars_ + max_temps_);
+        return std::move(chunk_);
+    }
+
+    int emit(OpCode op, int a = 0, int b = 0, int c = 0) {
+        int mask = register_operands(op);
+        if (((mask & 1) && a == NO_REG) || ((mask & 2) && b == NO_REG) ||
+            ((mask & 4) && c == NO_REG)) {
+            throw std::invalid_argument("Expression has no value");
+        }
+        chunk_.code_.push_back({op, a, b, c});
+        return static_cast<int>(chunk_.code_.size()) - 1;
+    }
+
+    int label() const {
+        return static_cast<int>(chunk_.code_.size());
+    }
+
+    // points jump at the given position to the current label
+    void patch(int at) {
+        auto &instr = chunk_.code_[at];
+        if (instr.op == OpCode::JUMP) {
+            instr.a = label();
+        } else {
+            instr.b = label();
+        }
+    }
+
+    int constant(const std::string &str) {
+        chunk_.constants_.push_back(Value::interned(str));
+        return static_cast<int>(chunk_.constants_.size()) - 1;
+    }
+
+    int constant(const Long &val) {
+        chunk_.constants_.emplace_back();
+        chunk_.constants_.back().load_long(val);
+        return static_cast<int>(chunk_.constants_.size()) - 1;
+    }
+
+    int temp() {
+        ++temps_;
+        max_temps_ = std::max(max_temps_, temps_);
+        return TEMP_BASE + temps_ - 1;
+    }
+
+    int temps() const {
+        return temps_;
+    }
+
+    void free_temps(int mark) {
+        temps_ = mark;
+    }
+
+    // frames are laid out exactly like Machine::enter_frame does it
+    void enter_scope(int size) {
+        int base = frames_.back().base + frames_.back().size;
+        frames_.push_back({base, size});
+        max_vars_ = std::max(max_vars_, base + size);
+    }
+
+    void leave_scope() {
+        frames_.pop_back();
+    }
+
+    int variable(VariableSlot slot) const {
+        return frames_[slot.depth].base + slot.index;
+    }
+
+    // until pop_bounds(), the counter is known to be a valid index of the
+    // arrays, so array[counter] needs no check
+    void push_bounds(VariableSlot counter, const std::vector<VariableSlot> &arrays) {
+        bounds_.push_back({counter, arrays});
+    }
+
+    void pop_bounds() {
+        bounds_.pop_back();
+    }
+
+    bool in_bounds(VariableSlot array, VariableSlot index) const {
+        for (const auto &bounds : bounds_) {
+            if (bounds.counter == index &&
+                std::find(bounds.arrays.begin(), bounds.arrays.end(), array) !=
+                bounds.arrays.end()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    // temporaries get their real numbers above all variables in finish()
+    static const int TEMP_BASE = 1 << 24;
+
+    struct Frame {
+        int base;
+        int size;
+    };
+
+    Chunk chunk_;
+
+    std::vector<Frame> frames_;
+    int max_vars_ = 0;
+
+    int temps_ = 0;
+    int max_temps_ = 0;
+
+    struct Bounds {
+        VariableSlot counter;
+        std::vector<VariableSlot> arrays;
+    };
+    std::vector<Bounds> bounds_;
+
+    void relocate_(int &operand, bool is_register) {
+        if (is_register && operand >= TEMP_BASE) {
+            operand = operand - TEMP_BASE + max_vars_;
+        }
+    }
+};
+
+#endif //INTERPRETER_BYTECODE_H
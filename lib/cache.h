@@ -0,0 +1,360 @@
+#ifndef INTERPRETER_CACHE_H
+#define INTERPRETER_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <bytecode.h>
+#include <mapped_file.h>
+
+// a statement of a whole program, compiled or failed to resolve or check
+struct CompiledStatement {
+    bool failed;
+    std::string error;
+    Chunk chunk;
+};
+
+struct CompiledProgram {
+    int globals = 0;
+    std::vector<CompiledStatement> statements;
+};
+
+// Compiled script (.cpmc): the bytecode of every statement of a script, or
+// the error it failed with. The file is mapped and read in place; it is
+// only used if it has the same format, optimization level and source hash,
+// and if the file still has the checksum its header recorded.
+// Counts are checked against the bytes left before anything is allocated,
+// so a damaged file is a cache miss rather than a crash.
+//  - next to the source: script.cpm -> script.cpmc
+//  - in a cache directory: <source hash>-O<level>.cpmc
+class ScriptCache {
+public:
+    static const uint32_t VERSION = 6;
+
+    // most registers of a statement and globals of a program a file may ask
+    // for; a real script is far below
+    static const uint32_t MAX_SLOTS = 1 << 20;
+
+    ScriptCache(const std::string &source, const std::string &directory,
+                int level) : level_(level) {
+        MappedFile file;
+        if (file.open(source.c_str())) {
+            hash_ = hash(file.data(), file.size());
+            source_size_ = file.size();
+            readable_ = true;
+        }
+        if (directory.empty()) {
+            auto dot = source.rfind('.');
+            auto slash = source.find_last_of("/\\");
+            bool has_ext = dot != std::string::npos &&
+                           (slash == std::string::npos || dot > slash);
+            path_ = (has_ext ? source.substr(0, dot) : source) + ".cpmc";
+        } else {
+            char name[32];
+            snprintf(name, sizeof(name), "%016llx-O%d.cpmc",
+                     static_cast<unsigned long long>(hash_), level);
+            path_ = directory + "/" + name;
+        }
+    }
+
+    const std::string &path() const {
+        return path_;
+    }
+
+    // FNV-1a; a hash passed in is continued
+    static uint64_t hash(const char *data, size_t size,
+                         uint64_t hash = 14695981039346656037ull) {
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool load(CompiledProgram &program) const {
+        MappedFile file;
+        if (!readable_ || !file.open(path_.c_str())) {
+            return false;
+        }
+        Reader reader(file.data(), file.size());
+        Header header;
+        if (!reader.read(header) || header != header_(0, 0) ||
+            header.checksum != checksum_(header, file.data() + sizeof(header),
+                                         file.size() - sizeof(header)) ||
+            header.globals > MAX_SLOTS ||
+            header.statements > reader.left() / sizeof(uint32_t)) {
+            return false;
+        }
+        CompiledProgram loaded;
+        loaded.globals = header.globals;
+        loaded.statements.resize(header.statements);
+        for (auto &statement : loaded.statements) {
+            uint32_t failed = 0;
+            if (!reader.read(failed)) {
+                return false;
+            }
+            statement.failed = failed != 0;
+            if (statement.failed) {
+                if (!reader.read(statement.error)) {
+                    return false;
+                }
+                continue;
+            }
+            uint32_t registers = 0;
+            uint32_t instructions = 0;
+            uint32_t constants = 0;
+            if (!reader.read(registers) || !reader.read(instructions) ||
+                !reader.read(constants) || registers > MAX_SLOTS ||
+                instructions > reader.left() / sizeof(Instruction)) {
+                return false;
+            }
+            auto &chunk = statement.chunk;
+            chunk.registers_ = registers;
+            chunk.code_.resize(instructions);
+            if (!reader.read(chunk.code_.data(), instructions * sizeof(Instruction))) {
+                return false;
+            }
+            if (constants > reader.left() / sizeof(uint32_t)) {
+                return false;
+            }
+            for (uint32_t i = 0; i < constants; ++i) {
+                std::string str;
+                if (!reader.read(str)) {
+                    return false;
+                }
+                chunk.constants_.push_back(Value::interned(str));
+            }
+            // the constants of LOAD_LONG are longs written in decimal
+            for (const auto &instr : chunk.code_) {
+                if (instr.op == OpCode::LOAD_LONG && instr.b >= 0 &&
+                    instr.b < static_cast<int>(constants) &&
+                    chunk.constants_[instr.b].type() == TypeIdentifyer::STRING_T) {
+                    auto &constant = chunk.constants_[instr.b];
+                    if (!decimal_(constant.str())) {
+                        return false;
+                    }
+                    constant.load_long(Long::parse(constant.str()));
+                }
+            }
+            if (!valid_(chunk)) {
+                return false;
+            }
+            // bounds the compiler proved aren't taken from a file
+            for (auto &instr : chunk.code_) {
+                if (instr.op == OpCode::INDEX_UNCHECKED) {
+                    instr.op = OpCode::INDEX;
+                } else if (instr.op == OpCode::STORE_INDEX_UNCHECKED) {
+                    instr.op = OpCode::STORE_INDEX;
+                }
+            }
+        }
+        program = std::move(loaded);
+        return true;
+    }
+
+    // writes a temporary file first, so concurrent runs never see a
+    // partly written cache
+    bool save(const CompiledProgram &program) const {
+        if (!readable_) {
+            return false;
+        }
+        std::string data;
+        for (const auto &statement : program.statements) {
+            append_(data, static_cast<uint32_t>(statement.failed));
+            if (statement.failed) {
+                append_(data, statement.error);
+                continue;
+            }
+            const auto &chunk = statement.chunk;
+            append_(data, static_cast<uint32_t>(chunk.registers()));
+            append_(data, static_cast<uint32_t>(chunk.code().size()));
+            append_(data, static_cast<uint32_t>(chunk.constants().size()));
+            data.append(reinterpret_cast<const char *>(chunk.code().data()),
+                        chunk.code().size() * sizeof(Instruction));
+            for (const auto &constant : chunk.constants()) {
+                append_(data, constant.type() == TypeIdentifyer::LONG_T ?
+                              constant.get_long().to_string() : constant.str());
+            }
+        }
+        auto header = header_(program.globals,
+                              static_cast<uint32_t>(program.statements.size()));
+        header.checksum = checksum_(header, data.data(), data.size());
+        std::string temp = path_ + ".tmp" + std::to_string(process_id_());
+        {
+            std::ofstream file(temp, std::ios::binary);
+            if (!file.write(reinterpret_cast<const char *>(&header), sizeof(header)) ||
+                !file.write(data.data(), data.size())) {
+                std::remove(temp.c_str());
+                return false;
+            }
+        }
+        if (std::rename(temp.c_str(), path_.c_str()) != 0) {
+            std::remove(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t opcodes;
+        uint32_t instruction_size;
+        uint32_t level;
+        uint32_t globals;
+        uint64_t hash;
+        uint64_t source_size;
+        uint32_t statements;
+        uint32_t reserved;
+        uint64_t checksum;      // of the file with this field zeroed
+
+        // compares everything that makes the file usable
+        bool operator!=(const Header &other) const {
+            return memcmp(magic, other.magic, sizeof(magic)) != 0 ||
+                   version != other.version || opcodes != other.opcodes ||
+                   instruction_size != other.instruction_size ||
+                   level != other.level || hash != other.hash ||
+                   source_size != other.source_size;
+        }
+    };
+
+    class Reader {
+    public:
+        Reader(const char *data, size_t size) : pos_(data), end_(data + size) {}
+
+        bool read(void *dst, size_t size) {
+            if (static_cast<size_t>(end_ - pos_) < size) {
+                return false;
+            }
+            if (size) {
+                memcpy(dst, pos_, size);
+            }
+            pos_ += size;
+            return true;
+        }
+
+        template <class T>
+        bool read(T &val) {
+            return read(&val, sizeof(T));
+        }
+
+        size_t left() const {
+            return static_cast<size_t>(end_ - pos_);
+        }
+
+        bool read(std::string &str) {
+            uint32_t size = 0;
+            if (!read(size) || static_cast<size_t>(end_ - pos_) < size) {
+                return false;
+            }
+            str.assign(pos_, size);
+            pos_ += size;
+            return true;
+        }
+
+    private:
+        const char *pos_;
+        const char *end_;
+    };
+
+    int level_;
+    uint64_t hash_ = 0;
+    uint64_t source_size_ = 0;
+    bool readable_ = false;
+    std::string path_;
+
+    Header header_(int globals, uint32_t statements) const {
+        Header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "CPMC", sizeof(header.magic));
+        header.version = VERSION;
+        header.opcodes = static_cast<uint32_t>(OpCode::HALT) + 1;
+        header.instruction_size = sizeof(Instruction);
+        header.level = static_cast<uint32_t>(level_);
+        header.globals = static_cast<uint32_t>(globals);
+        header.hash = hash_;
+        header.source_size = source_size_;
+        header.statements = statements;
+        return header;
+    }
+
+    static uint64_t checksum_(Header header, const char *body, size_t size) {
+        header.checksum = 0;
+        return hash(body, size, hash(reinterpret_cast<const char *>(&header), sizeof(header)));
+    }
+
+    template <class T>
+    static void append_(std::string &data, const T &val) {
+        data.append(reinterpret_cast<const char *>(&val), sizeof(T));
+    }
+
+    static void append_(std::string &data, const std::string &str) {
+        append_(data, static_cast<uint32_t>(str.size()));
+        data.append(str);
+    }
+
+    // a damaged file must not make the VM jump or index out of bounds
+    static bool valid_(const Chunk &chunk) {
+        int registers = static_cast<int>(chunk.registers());
+        int size = static_cast<int>(chunk.code().size());
+        if (size == 0 || chunk.code().back().op != OpCode::HALT) {
+            return false;
+        }
+        for (const auto &instr : chunk.code()) {
+            if (static_cast<int>(instr.op) > static_cast<int>(OpCode::HALT)) {
+                return false;
+            }
+            int mask = register_operands(instr.op);
+            if (((mask & 1) && (instr.a < 0 || instr.a >= registers)) ||
+                ((mask & 2) && (instr.b < 0 || instr.b >= registers)) ||
+                ((mask & 4) && (instr.c < 0 || instr.c >= registers))) {
+                return false;
+            }
+            if ((instr.op == OpCode::JUMP && (instr.a < 0 || instr.a >= size)) ||
+                (instr.op == OpCode::JUMP_FALSE && (instr.b < 0 || instr.b >= size)) ||
+                (instr.op == OpCode::LOAD_STR && !constant_(chunk, instr.b, TypeIdentifyer::STRING_T)) ||
+                (instr.op == OpCode::LOAD_LONG && !constant_(chunk, instr.b, TypeIdentifyer::LONG_T)) ||
+                (instr.op == OpCode::DECL && !type_(instr.b)) ||
+                (instr.op == OpCode::NEW_ARRAY && !is_array(static_cast<TypeIdentifyer>(instr.c)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool constant_(const Chunk &chunk, int index, TypeIdentifyer type) {
+        return index >= 0 && index < static_cast<int>(chunk.constants().size()) &&
+               chunk.constants()[index].type() == type;
+    }
+
+    static bool type_(int type) {
+        return type >= 0 && type <= static_cast<int>(TypeIdentifyer::STRING_MAP_T);
+    }
+
+    static bool decimal_(const std::string &str) {
+        size_t start = !str.empty() && str[0] == '-';
+        if (start == str.size()) {
+            return false;
+        }
+        for (size_t i = start; i < str.size(); ++i) {
+            if (str[i] < '0' || str[i] > '9') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static long process_id_() {
+#if INTERPRETER_MMAP
+        return static_cast<long>(getpid());
+#else
+        return 0;
+#endif
+    }
+};
+
+#endif //INTERPRETER_CACHE_H
@@ -16,11 +16,47 @@ enum class NodeType {
 enum class TypeIdentifyer {
     INT_T,
     STRING_T,
+    LONG_T,
+    INT_ARRAY_T,
+    STRING_ARRAY_T,
+    INT_MAP_T,
+    STRING_MAP_T,
+};
+
+inline bool is_array(TypeIdentifyer type) {
+    return type == TypeIdentifyer::INT_ARRAY_T || type == TypeIdentifyer::STRING_ARRAY_T;
+}
+
+inline TypeIdentifyer element_type(TypeIdentifyer array) {
+    return array == TypeIdentifyer::INT_ARRAY_T ? TypeIdentifyer::INT_T
+                                                : TypeIdentifyer::STRING_T;
+}
+
+inline TypeIdentifyer array_type(TypeIdentifyer element) {
+    return element == TypeIdentifyer::INT_T ? TypeIdentifyer::INT_ARRAY_T
+                                            : TypeIdentifyer::STRING_ARRAY_T;
+}
+
+// map<int,int> and map<string,int>; the values are always ints
+inline bool is_map(TypeIdentifyer type) {
+    return type == TypeIdentifyer::INT_MAP_T || type == TypeIdentifyer::STRING_MAP_T;
+}
+
+inline TypeIdentifyer key_type(TypeIdentifyer map) {
+    return map == TypeIdentifyer::INT_MAP_T ? TypeIdentifyer::INT_T
+                                            : TypeIdentifyer::STRING_T;
+}
+
+enum class Engine {
+    TREE,
+    BYTECODE,
 };
 
 const std::string NOT_INT = "Not int in int expression";
 const std::string NOT_BOOL_INT = "Not int and not boolean in bool expression";
 const std::string VAR_NEQ_EXPR = "Variable and expression types are different";
 const std::string CANT_READ =  "Can't read required type!";
+const std::string NOT_ARRAY = "Not an array";
+const std::string NOT_MAP = "Not a map";
 
 #endif //INTERPRETER_ENUMS_H
@@ -0,0 +1,254 @@
+#ifndef INTERPRETER_HASH_MAP_H
+#define INTERPRETER_HASH_MAP_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <array.h>
+
+// Maps of map<string,int> and map<int,int> are FlatMap: the entries lie in
+// one vector in the order they were inserted, which is also the order of
+// keys() and values(), and an open-addressing table of 64-bit slots points
+// into it. A slot holds the 32-bit hash of the key and the entry's index,
+// so a probe compares keys only when the hashes match, and the table grows
+// without touching the entries or hashing the keys again. Probing is
+// linear, the table is at most half full. Entries are never removed.
+//
+// The interpreter keeps maps in MapRep, shared between values until one of
+// them writes; the programs translated with --emit-c keep plain FlatMaps.
+// Both go through the functions below, so the errors are the same.
+
+const std::string KEY_NOT_FOUND = "Key not in map";
+
+// at most this many keys, so keys() makes an array
+const int MAX_MAP_SIZE = MAX_ARRAY_SIZE;
+
+// every bit of the key moves the low bits the table is indexed by
+inline uint32_t hash_int(int key) {
+    uint32_t hash = static_cast<uint32_t>(key);
+    hash ^= hash >> 16;
+    hash *= 0x7FEB352Du;
+    hash ^= hash >> 15;
+    hash *= 0x846CA68Bu;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// eight bytes at a time, the tail byte by byte rather than by a memcpy of
+// a variable size, which is a call
+inline uint32_t hash_bytes(const char *data, size_t size) {
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ size;
+    for (; size >= 8; data += 8, size -= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, data, sizeof(chunk));
+        hash = (hash ^ chunk) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 29;
+    }
+    uint64_t tail = 0;
+    for (size_t i = 0; i < size; ++i) {
+        tail |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+    }
+    hash = (hash ^ tail) * 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 29;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    return static_cast<uint32_t>(hash >> 32);
+}
+
+// hash and equality of the keys of FlatMap<K>
+template <class K>
+struct MapKeys;
+
+template <>
+struct MapKeys<int> {
+    static uint32_t hash(int key) {
+        return hash_int(key);
+    }
+
+    static bool equal(int lhs, int rhs) {
+        return lhs == rhs;
+    }
+};
+
+template <>
+struct MapKeys<std::string> {
+    static uint32_t hash(const std::string &key) {
+        return hash_bytes(key.data(), key.size());
+    }
+
+    static bool equal(const std::string &lhs, const std::string &rhs) {
+        return lhs == rhs;
+    }
+};
+
+template <class K>
+struct MapEntry {
+    K key;
+    int value;
+};
+
+template <class K>
+class FlatMap {
+public:
+    size_t size() const {
+        return entries_.size();
+    }
+
+    // in the order of insertion
+    const std::vector<MapEntry<K>> &entries() const {
+        return entries_;
+    }
+
+    // value of the key, nullptr if there is none
+    const int *find(const K &key) const {
+        uint64_t slot = slots_.empty() ? 0 : slots_[probe_(key, MapKeys<K>::hash(key))];
+        return slot ? &entries_[index_(slot)].value : nullptr;
+    }
+
+    // value of the key, inserted as 0 if there is none
+    int &operator[](const K &key) {
+        uint32_t hash = MapKeys<K>::hash(key);
+        size_t pos = 0;
+        if (!slots_.empty()) {
+            pos = probe_(key, hash);
+            if (slots_[pos]) {
+                return entries_[index_(slots_[pos])].value;
+            }
+        }
+        if (entries_.size() >= static_cast<size_t>(MAX_MAP_SIZE)) {
+            throw std::invalid_argument("Map too big");
+        }
+        if ((entries_.size() + 1) * 2 > slots_.size()) {
+            grow_();
+            pos = probe_(key, hash);
+        }
+        entries_.push_back({key, 0});
+        slots_[pos] = (static_cast<uint64_t>(hash) << 32) | entries_.size();
+        return entries_.back().value;
+    }
+
+    void clear() {
+        entries_.clear();
+        slots_.clear();
+    }
+
+private:
+    static const size_t MIN_SLOTS = 16;
+
+    std::vector<MapEntry<K>> entries_;
+    std::vector<uint64_t> slots_;
+
+    // the index is stored one up, so an empty slot is zero
+    static size_t index_(uint64_t slot) {
+        return static_cast<size_t>(slot & 0xFFFFFFFFu) - 1;
+    }
+
+    // the slot of the key, or the empty slot ending its probe
+    size_t probe_(const K &key, uint32_t hash) const {
+        size_t mask = slots_.size() - 1;
+        for (size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+            uint64_t slot = slots_[pos];
+            if (!slot || (static_cast<uint32_t>(slot >> 32) == hash &&
+                          MapKeys<K>::equal(entries_[index_(slot)].key, key))) {
+                return pos;
+            }
+        }
+    }
+
+    void grow_() {
+        size_t size = slots_.empty() ? static_cast<size_t>(MIN_SLOTS) : slots_.size() * 2;
+        std::vector<uint64_t> slots(size);
+        size_t mask = slots.size() - 1;
+        for (uint64_t slot : slots_) {
+            if (slot) {
+                size_t pos = static_cast<uint32_t>(slot >> 32) & mask;
+                while (slots[pos]) {
+                    pos = (pos + 1) & mask;
+                }
+                slots[pos] = slot;
+            }
+        }
+        slots_.swap(slots);
+    }
+};
+
+template <class K>
+int map_get(const FlatMap<K> &map, const K &key) {
+    const int *value = map.find(key);
+    if (!value) {
+        throw std::out_of_range(KEY_NOT_FOUND);
+    }
+    return *value;
+}
+
+template <class K>
+int map_contains(const FlatMap<K> &map, const K &key) {
+    return map.find(key) != nullptr;
+}
+
+template <class K>
+void map_insert(FlatMap<K> &map, const K &key, int value) {
+    map[key] = value;
+}
+
+// map[key] += value, from 0 for a new key
+template <class K>
+void map_add(FlatMap<K> &map, const K &key, int value) {
+    map[key] += value;
+}
+
+template <class K>
+std::vector<K> map_keys(const FlatMap<K> &map) {
+    std::vector<K> keys;
+    keys.reserve(map.size());
+    for (const auto &entry : map.entries()) {
+        keys.push_back(entry.key);
+    }
+    return keys;
+}
+
+template <class K>
+std::vector<int> map_values(const FlatMap<K> &map) {
+    std::vector<int> values;
+    values.reserve(map.size());
+    for (const auto &entry : map.entries()) {
+        values.push_back(entry.value);
+    }
+    return values;
+}
+
+// entries of a map value; the counter is not atomic, like the one of
+// ArrayRep
+template <class K>
+class MapRep {
+public:
+    typedef FlatMap<K> Items;
+
+    explicit MapRep(FlatMap<K> map) : map_(std::move(map)) {}
+
+    FlatMap<K> &items() {
+        return map_;
+    }
+
+    bool shared() const {
+        return refs_ > 1;
+    }
+
+    void retain() {
+        ++refs_;
+    }
+
+    void release() {
+        if (--refs_ == 0) {
+            delete this;
+        }
+    }
+
+private:
+    int refs_ = 1;
+    FlatMap<K> map_;
+};
+
+#endif //INTERPRETER_HASH_MAP_H
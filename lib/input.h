@@ -0,0 +1,317 @@
+#ifndef INTERPRETER_INPUT_H
+#define INTERPRETER_INPUT_H
+
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <bigint.h>
+#include <enums.h>
+#include <mapped_file.h>
+#include <output.h>
+#include <simd.h>
+
+// Input of read_int()/read_ints()/read_long()/read_word()/read_line().
+// Tokens are parsed right out of the buffer: a regular file is mapped into
+// memory, a stream is read by blocks of whatever it has buffered, but never
+// past the line being read, so an interactive stdin shared with the parser
+// is not read ahead.
+//
+// Behaves like reading the input line by line into a stringstream: tokens
+// don't cross lines, read_line() returns the rest of the current line or,
+// if nothing is left of it, the next non-empty line, and a token that can't
+// be read is an error unless the input is over.
+class InputBuffer {
+public:
+    explicit InputBuffer(std::istream &in = std::cin) : in_(&in) {}
+
+    InputBuffer(const InputBuffer &) = delete;
+
+    InputBuffer &operator=(const InputBuffer &) = delete;
+
+    // the output is flushed before the stream is read, like std::ios::tie()
+    void tie(OutputBuffer *output) {
+        tie_ = output;
+    }
+
+    // reads the file instead of the stream
+    bool open(const char *filename) {
+        storage_.clear();
+        eof_ = false;
+        in_ = nullptr;
+        exhausted_ = true;
+        if (!file_.open(filename)) {
+            reset_(storage_.data(), storage_.data());
+            return false;
+        }
+        reset_(file_.data(), file_.data() + file_.size());
+        return true;
+    }
+
+    // bytes of the lines reached so far, 0 without metrics
+    uint64_t bytes() const {
+        return bytes_;
+    }
+
+    int read_int() {
+        while (true) {
+            skip_spaces_();
+            if (pos_ == line_end_) {
+                if (!next_line_()) {
+                    return 0;
+                }
+                continue;
+            }
+            bool negative = false;
+            if (*pos_ == '-' || *pos_ == '+') {
+                negative = *pos_ == '-';
+                ++pos_;
+                if (pos_ == line_end_) {
+                    if (!next_line_()) {
+                        return 0;
+                    }
+                    continue;
+                }
+            }
+            if (!is_digit_(*pos_)) {
+                return fail_(0);
+            }
+            long long val = 0;
+            bool overflow = false;
+            for (; pos_ != line_end_ && is_digit_(*pos_); ++pos_) {
+                val = val * 10 + (*pos_ - '0');
+                if (val > static_cast<long long>(INT_MAX) + 1) {
+                    overflow = true;
+                    val = static_cast<long long>(INT_MAX) + 1;
+                }
+            }
+            if (negative) {
+                val = -val;
+            }
+            if (overflow || val > INT_MAX || val < INT_MIN) {
+                int limit = val < 0 ? INT_MIN : INT_MAX;
+                if (pos_ != line_end_) {
+                    return fail_(limit);
+                }
+                if (!next_line_()) {
+                    return limit;
+                }
+                continue;
+            }
+            return static_cast<int>(val);
+        }
+    }
+
+    // count read_int()s at once; a number of up to nine digits with 16
+    // bytes of the buffer after it is parsed in bulk, anything else by
+    // read_int() itself, so errors and the position after one are the same
+    void read_ints(int *out, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            if (!parse_int_(out[i])) {
+                out[i] = read_int();
+            }
+        }
+    }
+
+    // read_int() of a long: any number of digits, nothing overflows
+    Long read_long() {
+        while (true) {
+            skip_spaces_();
+            if (pos_ == line_end_) {
+                if (!next_line_()) {
+                    return 0;
+                }
+                continue;
+            }
+            bool negative = false;
+            if (*pos_ == '-' || *pos_ == '+') {
+                negative = *pos_ == '-';
+                ++pos_;
+                if (pos_ == line_end_) {
+                    if (!next_line_()) {
+                        return 0;
+                    }
+                    continue;
+                }
+            }
+            if (!is_digit_(*pos_)) {
+                return fail_(0);
+            }
+            const char *start = pos_;
+            while (pos_ != line_end_ && is_digit_(*pos_)) {
+                ++pos_;
+            }
+            return Long::parse(start, pos_, negative);
+        }
+    }
+
+    std::string read_word() {
+        while (true) {
+            skip_spaces_();
+            if (pos_ != line_end_) {
+                const char *start = pos_;
+                while (pos_ != line_end_ && !is_space_(*pos_)) {
+                    ++pos_;
+                }
+                return std::string(start, pos_);
+            }
+            if (!next_line_()) {
+                return std::string();
+            }
+        }
+    }
+
+    std::string read_line() {
+        while (pos_ == line_end_) {
+            if (!next_line_()) {
+                return std::string();
+            }
+        }
+        std::string line(pos_, line_end_);
+        pos_ = line_end_;
+        return line;
+    }
+
+private:
+    static const size_t BLOCK = 1 << 16;
+
+    std::istream *in_;
+    OutputBuffer *tie_ = nullptr;
+    std::string storage_;
+    MappedFile file_;
+
+    // [pos_, line_end_) is what is left of the current line
+    const char *begin_ = nullptr;
+    const char *pos_ = nullptr;
+    const char *line_end_ = nullptr;
+    const char *end_ = nullptr;
+
+    bool line_loaded_ = false;
+    bool exhausted_ = false;
+    bool eof_ = false;
+    uint64_t bytes_ = 0;
+
+    static bool is_space_(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\v' ||
+               c == '\f' || c == '\r';
+    }
+
+    static bool is_digit_(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    void reset_(const char *begin, const char *end) {
+        begin_ = begin;
+        pos_ = begin;
+        line_end_ = begin;
+        end_ = end;
+        line_loaded_ = false;
+    }
+
+    void skip_spaces_() {
+        while (pos_ != line_end_ && is_space_(*pos_)) {
+            ++pos_;
+        }
+    }
+
+    // the digits can't run past the line: it ends with a newline or with
+    // the buffer
+    bool parse_int_(int &val) {
+        skip_spaces_();
+        while (pos_ == line_end_) {
+            if (!next_line_()) {
+                return false;
+            }
+            skip_spaces_();
+        }
+        const char *digits = pos_ + (*pos_ == '-' || *pos_ == '+');
+        if (end_ - digits < 16) {
+            return false;
+        }
+        int count = DigitKernels::leading_digits(digits);
+        if (count == 0 || count > 9) {
+            return false;
+        }
+        uint32_t result = count > 8
+                          ? DigitKernels::parse_digits(digits, 8) * 10 + (digits[8] - '0')
+                          : DigitKernels::parse_digits(digits, count);
+        val = *pos_ == '-' ? -static_cast<int>(result) : static_cast<int>(result);
+        pos_ = digits + count;
+        return true;
+    }
+
+    int fail_(int val) {
+        if (eof_) {
+            return val;
+        }
+        throw std::invalid_argument(CANT_READ);
+    }
+
+    // moves to the next line, false if the input is over
+    bool next_line_() {
+        if (eof_) {
+            return false;
+        }
+        if (line_loaded_ && line_end_ != end_) {
+            ++line_end_;
+        }
+        pos_ = line_end_;
+        line_loaded_ = true;
+        const char *newline = nullptr;
+        while (true) {
+            if (pos_ != end_) {
+                newline = static_cast<const char *>(
+                        memchr(pos_, '\n', end_ - pos_));
+            }
+            if (newline || exhausted_) {
+                break;
+            }
+            fill_();
+        }
+        if (newline) {
+            line_end_ = newline;
+        } else {
+            line_end_ = end_;
+            eof_ = true;
+        }
+        bytes_ += line_end_ - pos_ + (newline ? 1 : 0);
+        return true;
+    }
+
+    // appends what the stream has at hand, at least up to the next newline
+    void fill_() {
+        if (tie_) {
+            tie_->flush();
+        }
+        storage_.erase(0, pos_ - begin_);
+        auto buf = in_->rdbuf();
+        while (true) {
+            std::streamsize avail = buf ? buf->in_avail() : -1;
+            if (avail > 0) {
+                size_t size = storage_.size();
+                size_t chunk = static_cast<size_t>(avail) < BLOCK ? avail : BLOCK;
+                storage_.resize(size + chunk);
+                storage_.resize(size + buf->sgetn(&storage_[size], chunk));
+                if (memchr(storage_.data() + size, '\n', storage_.size() - size)) {
+                    break;
+                }
+                continue;
+            }
+            int c = buf ? buf->sbumpc() : EOF;
+            if (c == EOF) {
+                exhausted_ = true;
+                break;
+            }
+            storage_.push_back(static_cast<char>(c));
+            if (c == '\n') {
+                break;
+            }
+        }
+        begin_ = storage_.data();
+        pos_ = begin_;
+        end_ = begin_ + storage_.size();
+    }
+};
+
+#endif //INTERPRETER_INPUT_H
@@ -3,44 +3,310 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 #include <syntax_tree.h>
 #include <machine.h>
+#include <bytecode.h>
+#include <vm.h>
+#include <jit.h>
+#include <transpiler.h>
+#include <resolver.h>
+#include <type_checker.h>
+#include <optimizer.h>
+#include <arena.h>
+#include <cache.h>
 
-struct FlexInterpreter {
-    const std::string ps1 = ">>>  "; // prompt to start statement
-    const std::string ps2 = "... "; // prompt to continue statement
-    bool eof = false; // set by the EOF action in the parser
-    bool completeLine = false; // managed by yyread
-    bool atStart = false; // true before scanner sees printable chars on line
-};
-
+// Interpreters share no state, each one may run on its own thread.
 class Interpreter {
 public:
+    // runtime errors are reported to errors
     explicit Interpreter(std::istream &in = std::cin,
-                         std::ostream &out = std::cout) :
-            machine(in, out), node_(nullptr) {}
+                         std::ostream &out = std::cout,
+                         std::ostream &errors = std::cout) :
+            machine(in, out), node_(nullptr), out_(out), errors_(errors) {}
 
     void set_node(Node *node) {
         node_ = node;
     }
 
+    void set_engine(Engine engine) {
+        engine_ = engine;
+    }
+
+    void set_optimization(int level) {
+        optimizer_.set_level(level);
+    }
+
+    // read_int()/read_word()/read_line() read the file
+    bool set_input(const char *filename) {
+        return machine.open_input(filename);
+    }
+
+    // loops of the tree engine that work on ints only are compiled to
+    // machine code, where the platform allows it
+    void set_jit(bool jit) {
+        jit_ = jit;
+    }
+
+    // print statements after optimization instead of running them
+    void set_dump(bool dump) {
+        dump_ = dump;
+    }
+
+    // statements built by the parser are kept until run_program() instead
+    // of being run one by one
+    void set_whole_program(bool whole_program) {
+        whole_program_ = whole_program;
+    }
+
     void interpret(Node *node) {
         try {
-            if (node) {
-                node->evaluate(machine);
+            if (node && !exited_) {
+                prepare_(node);
+                execute_(node);
             }
         } catch (std::exception &e) {
-            std::cout << "Error: " << e.what() << "\n";
+            report_(e.what());
+        } catch (ProgramExit &) {
+            exited_ = true;
         }
     }
 
+    // the program has called exit(), nothing is run after it
+    bool exited() const {
+        return exited_;
+    }
+
+    // runs the statement built by the parser and frees all nodes built so
+    // far, they live in arena() while it's current
     void interpret() {
+        if (whole_program_) {
+            if (node_) {
+                program_.push_back({node_, false, std::string()});
+            }
+            node_ = nullptr;
+            return;
+        }
         interpret(node_);
+        node_ = nullptr;
+        arena_.release();
+    }
+
+    // resolves, checks and optimizes all statements of the program, then
+    // runs them in order. Analysis doesn't depend on execution, so each
+    // error is reported when its statement's turn comes, as if the
+    // statements were run one by one.
+    void run_program() {
+        prepare_program_();
+        for (auto &statement : program_) {
+            if (exited_) {
+                break;
+            }
+            if (statement.failed) {
+                report_(statement.error.c_str());
+                continue;
+            }
+            try {
+                execute_(statement.node);
+            } catch (std::exception &e) {
+                report_(e.what());
+            } catch (ProgramExit &) {
+                exited_ = true;
+            }
+        }
+        program_.clear();
+        arena_.release();
+    }
+
+    // the bytecode of the whole program, for run_compiled() now or after
+    // it was saved to and loaded from a ScriptCache
+    CompiledProgram compile_program() {
+        prepare_program_();
+        CompiledProgram program;
+        program.globals = resolver_.globals();
+        for (auto &statement : program_) {
+            if (!statement.failed) {
+                try {
+                    program.statements.push_back({false, std::string(),
+                                                  compile_(statement.node)});
+                    continue;
+                } catch (std::exception &e) {
+                    statement.error = e.what();
+                }
+            }
+            program.statements.push_back({true, statement.error, Chunk()});
+        }
+        program_.clear();
+        arena_.release();
+        return program;
+    }
+
+    // the whole program as the C++ source of a standalone executable, see
+    // Transpiler
+    void transpile_program(std::ostream &out) {
+        prepare_program_();
+        Transpiler transpiler;
+        for (auto &statement : program_) {
+            if (statement.failed) {
+                transpiler.report(statement.error);
+                continue;
+            }
+            transpiler.begin_statement();
+            statement.node->transpile(transpiler);
+            transpiler.end_statement();
+        }
+        transpiler.finish(out);
+        program_.clear();
+        arena_.release();
+    }
+
+    void run_compiled(const CompiledProgram &program) {
+        machine.resize_globals(program.globals);
+        for (const auto &statement : program.statements) {
+            if (exited_) {
+                break;
+            }
+            if (statement.failed) {
+                report_(statement.error.c_str());
+                continue;
+            }
+            try {
+                vm_.run(statement.chunk, machine);
+            } catch (std::exception &e) {
+                report_(e.what());
+            } catch (ProgramExit &) {
+                exited_ = true;
+            }
+        }
+    }
+
+    // the machine's metrics as a JSON object; allocates nothing, so it's
+    // safe in a signal handler
+    void write_metrics(JsonBuffer &json) {
+        auto &metrics = machine.metrics();
+        json.begin();
+        json.boolean("node_counts", INTERPRETER_METRICS != 0);
+        json.begin("nodes");
+        for (int i = 0, kinds = NodeKinds::size(); i < kinds; ++i) {
+            if (metrics.nodes[i]) {
+                json.number(NodeKinds::name(i), metrics.nodes[i]);
+            }
+        }
+        json.end();
+        json.begin("instructions");
+        for (int i = 0; i <= static_cast<int>(OpCode::HALT); ++i) {
+            if (metrics.instructions[i]) {
+                json.number(opcode_name(static_cast<OpCode>(i)), metrics.instructions[i]);
+            }
+        }
+        json.end();
+        json.number("value_allocations", Metrics::value_allocations());
+        json.number("stack_high_water", metrics.stack_high);
+        json.number("variable_lookups", metrics.lookups);
+        json.number("scopes_entered", metrics.scopes_entered);
+        json.number("scopes_left", metrics.scopes_left);
+        json.number("bytes_read", machine.bytes_read());
+        json.number("bytes_written", machine.bytes_written());
+        json.end();
+    }
+
+    Arena &arena() {
+        return arena_;
+    }
+
+    // output of the program is buffered by the machine until flushed
+    OutputBuffer &output() {
+        return machine.output();
     }
 
 private:
     Machine machine;
+    Arena arena_;
     Node *node_;
+    Engine engine_ = Engine::TREE;
+    bool dump_ = false;
+    bool jit_ = false;
+    bool exited_ = false;
+    std::ostream &out_;
+    std::ostream &errors_;
+
+    struct Statement {
+        Node *node;
+        bool failed;
+        std::string error;
+    };
+    bool whole_program_ = false;
+    std::vector<Statement> program_;
+
+    Resolver resolver_;
+    TypeChecker checker_;
+    Optimizer optimizer_;
+    Compiler compiler_;
+    VirtualMachine vm_;
+    JitCompiler jit_compiler_;
+
+    void resolve_(Node *&node) {
+        resolver_.begin();
+        try {
+            node->resolve(resolver_);
+            checker_.check(node);
+        } catch (...) {
+            resolver_.rollback();
+            throw;
+        }
+        machine.resize_globals(resolver_.globals());
+    }
+
+    void prepare_program_() {
+        for (auto &statement : program_) {
+            try {
+                prepare_(statement.node);
+            } catch (std::exception &e) {
+                statement.failed = true;
+                statement.error = e.what();
+            }
+        }
+    }
+
+    void prepare_(Node *&node) {
+        resolve_(node);
+        if (optimizer_.level() > 0) {
+            optimizer_.optimize(node);
+        }
+        // the profiler times statements of the tree one by one
+        if (jit_ && engine_ == Engine::TREE && !Profiler::current()) {
+            jit_compiler_.native(node);
+        }
+    }
+
+    void execute_(Node *node) {
+        if (dump_) {
+            node->print(0, out_);
+            return;
+        }
+        switch (engine_) {
+            case Engine::TREE: {
+                node->evaluate(machine);
+                break;
+            }
+            case Engine::BYTECODE: {
+                vm_.run(compile_(node), machine);
+                break;
+            }
+        }
+    }
+
+    void report_(const char *error) {
+        machine.reset_frames();
+        machine.flush();
+        errors_ << "Error: " << error << "\n";
+    }
+
+    Chunk compile_(Node *node) {
+        compiler_.begin(resolver_.globals());
+        node->compile(compiler_);
+        return compiler_.finish();
+    }
 };
 
 #endif //INTERPRETER_INTERPRETER_H
@@ -0,0 +1,773 @@
+#ifndef INTERPRETER_JIT_H
+#define INTERPRETER_JIT_H
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <machine.h>
+#include <operations.h>
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__unix__) || defined(__APPLE__))
+#include <sys/mman.h>
+#include <unistd.h>
+#define INTERPRETER_JIT 1
+#else
+#define INTERPRETER_JIT 0
+#endif
+
+// Machine code in pages of its own, made executable once written. The code
+// is called with the array of variables it works on.
+class NativeCode {
+public:
+    typedef int (*Function)(int *variables);
+
+    NativeCode() = default;
+
+    NativeCode(const NativeCode &) = delete;
+
+    NativeCode &operator=(const NativeCode &) = delete;
+
+    ~NativeCode() {
+        release_();
+    }
+
+    // false if the platform can't run it
+    bool load(const std::vector<uint8_t> &code) {
+        release_();
+#if INTERPRETER_JIT
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t size = (code.size() + page - 1) / page * page;
+        void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED) {
+            return false;
+        }
+        memcpy(map, code.data(), code.size());
+        if (mprotect(map, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(map, size);
+            return false;
+        }
+        map_ = map;
+        size_ = size;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    int run(int *variables) const {
+        return reinterpret_cast<Function>(map_)(variables);
+    }
+
+private:
+    void *map_ = nullptr;
+    size_t size_ = 0;
+
+    void release_() {
+#if INTERPRETER_JIT
+        if (map_) {
+            munmap(map_, size_);
+        }
+#endif
+        map_ = nullptr;
+        size_ = 0;
+    }
+};
+
+// Encodes the few x86-64 instructions the JIT needs. Arithmetic is on the
+// 32-bit halves of the registers, memory operands are [base + disp32].
+class X64Assembler {
+public:
+    enum Reg {
+        RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+        R8, R9, R10, R11, R12, R13, R14, R15
+    };
+
+    enum Cond {
+        E = 0x4, NE = 0x5, L = 0xC, GE = 0xD, LE = 0xE, G = 0xF
+    };
+
+    static Cond negate(Cond cond) {
+        return static_cast<Cond>(cond ^ 1);
+    }
+
+    // a jump target; jumps to it before it's bound are patched by bind()
+    struct Label {
+        size_t pos = SIZE_MAX;
+        std::vector<size_t> uses;
+    };
+
+    const std::vector<uint8_t> &code() const {
+        return code_;
+    }
+
+    void clear() {
+        code_.clear();
+    }
+
+    void mov(Reg dst, Reg src) {
+        op_(0x89, src, dst);
+    }
+
+    void mov(Reg dst, int32_t value) {
+        rex_(false, RAX, dst);
+        byte_(0xB8 + (dst & 7));
+        int32_(value);
+    }
+
+    void load(Reg dst, Reg base, int32_t disp) {
+        memory_op_(false, 0x8B, dst, base, disp);
+    }
+
+    void store(Reg base, int32_t disp, Reg src) {
+        memory_op_(false, 0x89, src, base, disp);
+    }
+
+    void add(Reg dst, Reg src) {
+        op_(0x01, src, dst);
+    }
+
+    void sub(Reg dst, Reg src) {
+        op_(0x29, src, dst);
+    }
+
+    void imul(Reg dst, Reg src) {
+        rex_(false, dst, src);
+        byte_(0x0F);
+        byte_(0xAF);
+        modrm_(3, dst, src);
+    }
+
+    void cmp(Reg left, Reg right) {
+        op_(0x39, right, left);
+    }
+
+    void cmp(Reg left, int32_t value) {
+        rex_(false, RAX, left);
+        byte_(0x81);
+        modrm_(3, 7, left);
+        int32_(value);
+    }
+
+    void test(Reg left, Reg right) {
+        op_(0x85, right, left);
+    }
+
+    void xor_(Reg dst, Reg src) {
+        op_(0x31, src, dst);
+    }
+
+    void neg(Reg reg) {
+        rex_(false, RAX, reg);
+        byte_(0xF7);
+        modrm_(3, 3, reg);
+    }
+
+    // edx:eax = sign extended eax
+    void cdq() {
+        byte_(0x99);
+    }
+
+    // eax = edx:eax / divisor, edx = the remainder
+    void idiv(Reg divisor) {
+        rex_(false, RAX, divisor);
+        byte_(0xF7);
+        modrm_(3, 7, divisor);
+    }
+
+    // the low bytes of the registers
+    void setcc(Cond cond, Reg dst) {
+        rex_(false, RAX, dst, dst >= RSP);
+        byte_(0x0F);
+        byte_(0x90 + cond);
+        modrm_(3, 0, dst);
+    }
+
+    void and8(Reg dst, Reg src) {
+        rex_(false, src, dst, src >= RSP || dst >= RSP);
+        byte_(0x20);
+        modrm_(3, src, dst);
+    }
+
+    void or8(Reg dst, Reg src) {
+        rex_(false, src, dst, src >= RSP || dst >= RSP);
+        byte_(0x08);
+        modrm_(3, src, dst);
+    }
+
+    void movzx8(Reg dst, Reg src) {
+        rex_(false, dst, src, src >= RSP);
+        byte_(0x0F);
+        byte_(0xB6);
+        modrm_(3, dst, src);
+    }
+
+    void push(Reg reg) {
+        rex_(false, RAX, reg);
+        byte_(0x50 + (reg & 7));
+    }
+
+    void pop(Reg reg) {
+        rex_(false, RAX, reg);
+        byte_(0x58 + (reg & 7));
+    }
+
+    void mov64(Reg dst, Reg src) {
+        rex_(true, src, dst);
+        byte_(0x89);
+        modrm_(3, src, dst);
+    }
+
+    void lea64(Reg dst, Reg base, int32_t disp) {
+        memory_op_(true, 0x8D, dst, base, disp);
+    }
+
+    void ret() {
+        byte_(0xC3);
+    }
+
+    void jump(Label &label) {
+        byte_(0xE9);
+        target_(label);
+    }
+
+    void jump(Cond cond, Label &label) {
+        byte_(0x0F);
+        byte_(0x80 + cond);
+        target_(label);
+    }
+
+    void bind(Label &label) {
+        label.pos = code_.size();
+        for (auto use : label.uses) {
+            patch_(use, label.pos);
+        }
+        label.uses.clear();
+    }
+
+private:
+    std::vector<uint8_t> code_;
+
+    void byte_(int value) {
+        code_.push_back(static_cast<uint8_t>(value));
+    }
+
+    void int32_(int32_t value) {
+        uint8_t bytes[4];
+        memcpy(bytes, &value, 4);
+        code_.insert(code_.end(), bytes, bytes + 4);
+    }
+
+    // without force the prefix is left out when it changes nothing; the
+    // byte registers past bl need it to mean spl..dil instead of ah..bh
+    void rex_(bool wide, int reg, int rm, bool force = false) {
+        int rex = 0x40 | (wide ? 8 : 0) | (reg >= R8 ? 4 : 0) | (rm >= R8 ? 1 : 0);
+        if (rex != 0x40 || force) {
+            byte_(rex);
+        }
+    }
+
+    void modrm_(int mod, int reg, int rm) {
+        byte_((mod << 6) | ((reg & 7) << 3) | (rm & 7));
+    }
+
+    // opcode r/m32, r32 with both operands in registers
+    void op_(int opcode, Reg reg, Reg rm) {
+        rex_(false, reg, rm);
+        byte_(opcode);
+        modrm_(3, reg, rm);
+    }
+
+    void memory_op_(bool wide, int opcode, Reg reg, Reg base, int32_t disp) {
+        rex_(wide, reg, base);
+        byte_(opcode);
+        modrm_(2, reg, base);
+        if ((base & 7) == RSP) {
+            byte_(0x24);
+        }
+        int32_(disp);
+    }
+
+    void target_(Label &label) {
+        size_t at = code_.size();
+        int32_(0);
+        if (label.pos != SIZE_MAX) {
+            patch_(at, label.pos);
+        } else {
+            label.uses.push_back(at);
+        }
+    }
+
+    void patch_(size_t at, size_t target) {
+        int32_t offset = static_cast<int32_t>(target - (at + 4));
+        memcpy(&code_[at], &offset, 4);
+    }
+};
+
+// a compiled loop and where its variables come from: inputs are copied
+// from the frames before the code runs, outputs back after it finished
+struct NativeLoop {
+    NativeCode code;
+    int variables = 0;
+    std::vector<std::pair<int, VariableSlot>> inputs;
+    std::vector<std::pair<int, VariableSlot>> outputs;
+};
+
+// Compiles loops that work on nothing but int variables to x86-64 code
+// (see NativeLoopNode). Nodes emit their code in Node::jit() with the
+// operations below: an expression leaves its value in eax, a binary
+// operator gets its right operand in ecx. The code is emitted twice: the
+// first pass counts uses of the variables, weighted by loop nesting, and
+// the most used ones are kept in registers by the second pass. The code
+// gives up on division by zero and overflowing division, returning 1
+// before it writes anything back, so the loop can be run again by the
+// tree and fail with its usual error.
+class JitCompiler {
+public:
+    typedef X64Assembler::Label Label;
+    typedef X64Assembler::Reg Reg;
+
+    // replaces the loops in node and below that compile with native ones;
+    // like TypeChecker::check() but the replaced node is owned by the new
+    // one, which falls back on it
+    template <class T>
+    void native(T *&node) {
+        node = node->native(*this);
+    }
+
+    // nullptr if the loop uses anything but ints or the platform has no JIT
+    template <class Loop>
+    std::unique_ptr<NativeLoop> compile(Loop &loop) {
+#if INTERPRETER_JIT
+        variables_.clear();
+        slots_.clear();
+        temporaries_.clear();
+        begin_(false);
+        if (!loop.jit(*this)) {
+            return nullptr;
+        }
+        allocate_();
+        begin_(true);
+        loop.jit(*this);
+        end_();
+        std::unique_ptr<NativeLoop> native(new NativeLoop());
+        if (!native->code.load(as_.code())) {
+            return nullptr;
+        }
+        native->variables = static_cast<int>(variables_.size());
+        for (size_t i = 0; i < variables_.size(); ++i) {
+            const auto &var = variables_[i];
+            if (var.external) {
+                native->inputs.push_back({static_cast<int>(i), var.slot});
+                if (var.assigned) {
+                    native->outputs.push_back({static_cast<int>(i), var.slot});
+                }
+            }
+        }
+        return native;
+#else
+        (void) loop;
+        return nullptr;
+#endif
+    }
+
+    void enter_loop() {
+        ++loops_;
+    }
+
+    void leave_loop() {
+        --loops_;
+    }
+
+    // a variable the loop declares, it's not taken from the frames
+    void declare(VariableSlot slot) {
+        variables_[slot_(slot)].declared = true;
+    }
+
+    void load_int(int value) {
+        if (value == 0) {
+            as_.xor_(X64Assembler::RAX, X64Assembler::RAX);
+        } else {
+            as_.mov(X64Assembler::RAX, value);
+        }
+    }
+
+    void load(VariableSlot slot) {
+        load_(X64Assembler::RAX, use_(slot_(slot), false));
+    }
+
+    void store(VariableSlot slot) {
+        store_(use_(slot_(slot), true));
+    }
+
+    // values the loop computes for itself, like hoisted expressions
+    void load_temporary(const void *key) {
+        load_(X64Assembler::RAX, use_(temporary_(key), false));
+    }
+
+    void store_temporary(const void *key) {
+        store_(use_(temporary_(key), true));
+    }
+
+    void operand_int(int value) {
+        as_.mov(X64Assembler::RCX, value);
+    }
+
+    void operand(VariableSlot slot) {
+        load_(X64Assembler::RCX, use_(slot_(slot), false));
+    }
+
+    void operand_temporary(const void *key) {
+        load_(X64Assembler::RCX, use_(temporary_(key), false));
+    }
+
+    // the value is kept while the other operand is computed
+    void push() {
+        as_.push(X64Assembler::RAX);
+    }
+
+    void pop_operand() {
+        as_.pop(X64Assembler::RCX);
+    }
+
+    template <class Op>
+    void binary() {
+        binary_(Op());
+    }
+
+    template <class Op>
+    void unary() {
+        unary_(Op());
+    }
+
+    // the variable op= eax
+    template <class Op>
+    void update(VariableSlot slot) {
+        int index = slot_(slot);
+        Reg reg = variables_[index].reg;
+        if (reg != X64Assembler::RSP && in_place_(Op(), reg)) {
+            use_(index, true);
+            return;
+        }
+        as_.mov(X64Assembler::RCX, X64Assembler::RAX);
+        load(slot);
+        binary_(Op());
+        store(slot);
+    }
+
+    // true for the operators the result of which can be jumped on
+    // without computing it
+    template <class Op>
+    static bool compares() {
+        return condition_(Op()) >= 0;
+    }
+
+    // jumps to label unless eax op ecx, for comparisons
+    template <class Op>
+    void jump_unless(Label &label) {
+        as_.cmp(X64Assembler::RAX, X64Assembler::RCX);
+        as_.jump(X64Assembler::negate(static_cast<X64Assembler::Cond>(condition_(Op()))),
+                 label);
+    }
+
+    void jump_if_zero(Label &label) {
+        as_.test(X64Assembler::RAX, X64Assembler::RAX);
+        as_.jump(X64Assembler::E, label);
+    }
+
+    void jump(Label &label) {
+        as_.jump(label);
+    }
+
+    void bind(Label &label) {
+        as_.bind(label);
+    }
+
+private:
+    // rsp marks a variable kept in memory
+    struct Variable {
+        VariableSlot slot;
+        bool temporary;
+        bool declared;
+        bool external;
+        bool assigned;
+        uint64_t uses;
+        Reg reg;
+    };
+
+    // registers the code needs for itself: eax, ecx and edx for
+    // arithmetic, rbp for the stack on entry and r15 for the array
+    static const int REGISTERS = 10;
+
+    // saved by the prologue, in this order
+    static const int SAVED = 5;
+
+    X64Assembler as_;
+    std::vector<Variable> variables_;
+    std::map<std::pair<int, int>, int> slots_;
+    std::map<const void *, int> temporaries_;
+    int loops_ = 0;
+    bool counted_ = false;
+    Label exit_;
+    Label bail_;
+
+    static const Reg *registers_() {
+        static const Reg registers[REGISTERS] = {
+                X64Assembler::RBX, X64Assembler::R12, X64Assembler::R13,
+                X64Assembler::R14, X64Assembler::RSI, X64Assembler::RDI,
+                X64Assembler::R8, X64Assembler::R9, X64Assembler::R10,
+                X64Assembler::R11};
+        return registers;
+    }
+
+    static const Reg *saved_() {
+        static const Reg saved[SAVED] = {
+                X64Assembler::RBX, X64Assembler::R12, X64Assembler::R13,
+                X64Assembler::R14, X64Assembler::R15};
+        return saved;
+    }
+
+    int slot_(VariableSlot slot) {
+        auto key = std::make_pair(slot.depth, slot.index);
+        auto it = slots_.find(key);
+        if (it != slots_.end()) {
+            return it->second;
+        }
+        int index = add_(slot, false);
+        slots_[key] = index;
+        return index;
+    }
+
+    int temporary_(const void *key) {
+        auto it = temporaries_.find(key);
+        if (it != temporaries_.end()) {
+            return it->second;
+        }
+        int index = add_({0, 0}, true);
+        temporaries_[key] = index;
+        return index;
+    }
+
+    int add_(VariableSlot slot, bool temporary) {
+        variables_.push_back({slot, temporary, false, false, false, 0,
+                              X64Assembler::RSP});
+        return static_cast<int>(variables_.size()) - 1;
+    }
+
+    // uses in the first pass decide the registers; a variable used before
+    // the loop declares it comes from the frames
+    int use_(int index, bool assigned) {
+        auto &var = variables_[index];
+        if (!counted_) {
+            var.uses += uint64_t(1) << (4 * std::min(loops_, 15));
+            var.assigned = var.assigned || assigned;
+            var.external = var.external || (!var.temporary && !var.declared);
+        }
+        return index;
+    }
+
+    void allocate_() {
+        std::vector<int> order(variables_.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = static_cast<int>(i);
+        }
+        std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+            return variables_[a].uses > variables_[b].uses;
+        });
+        for (size_t i = 0; i < order.size() && i < REGISTERS; ++i) {
+            variables_[order[i]].reg = registers_()[i];
+        }
+    }
+
+    static int32_t offset_(int index) {
+        return static_cast<int32_t>(index * sizeof(int));
+    }
+
+    void begin_(bool counted) {
+        counted_ = counted;
+        loops_ = 0;
+        as_.clear();
+        exit_ = Label();
+        bail_ = Label();
+        for (auto &var : variables_) {
+            var.declared = false;
+        }
+        as_.push(X64Assembler::RBP);
+        as_.mov64(X64Assembler::RBP, X64Assembler::RSP);
+        for (int i = 0; i < SAVED; ++i) {
+            as_.push(saved_()[i]);
+        }
+        as_.mov64(X64Assembler::R15, X64Assembler::RDI);
+        for (size_t i = 0; i < variables_.size(); ++i) {
+            if (variables_[i].reg != X64Assembler::RSP) {
+                as_.load(variables_[i].reg, X64Assembler::R15, offset_(i));
+            }
+        }
+    }
+
+    void end_() {
+        for (size_t i = 0; i < variables_.size(); ++i) {
+            if (variables_[i].reg != X64Assembler::RSP) {
+                as_.store(X64Assembler::R15, offset_(i), variables_[i].reg);
+            }
+        }
+        as_.xor_(X64Assembler::RAX, X64Assembler::RAX);
+        as_.jump(exit_);
+        as_.bind(bail_);
+        as_.mov(X64Assembler::RAX, 1);
+        as_.bind(exit_);
+        as_.lea64(X64Assembler::RSP, X64Assembler::RBP, -8 * SAVED);
+        for (int i = SAVED - 1; i >= 0; --i) {
+            as_.pop(saved_()[i]);
+        }
+        as_.pop(X64Assembler::RBP);
+        as_.ret();
+    }
+
+    void load_(Reg dst, int index) {
+        Reg reg = variables_[index].reg;
+        if (reg != X64Assembler::RSP) {
+            as_.mov(dst, reg);
+        } else {
+            as_.load(dst, X64Assembler::R15, offset_(index));
+        }
+    }
+
+    void store_(int index) {
+        Reg reg = variables_[index].reg;
+        if (reg != X64Assembler::RSP) {
+            as_.mov(reg, X64Assembler::RAX);
+        } else {
+            as_.store(X64Assembler::R15, offset_(index), X64Assembler::RAX);
+        }
+    }
+
+    void binary_(Add) {
+        as_.add(X64Assembler::RAX, X64Assembler::RCX);
+    }
+
+    void binary_(Sub) {
+        as_.sub(X64Assembler::RAX, X64Assembler::RCX);
+    }
+
+    void binary_(Mul) {
+        as_.imul(X64Assembler::RAX, X64Assembler::RCX);
+    }
+
+    void binary_(Div) {
+        divide_();
+    }
+
+    void binary_(Mod) {
+        divide_();
+        as_.mov(X64Assembler::RAX, X64Assembler::RDX);
+    }
+
+    void binary_(And) {
+        logical_();
+        as_.and8(X64Assembler::RAX, X64Assembler::RCX);
+        as_.movzx8(X64Assembler::RAX, X64Assembler::RAX);
+    }
+
+    void binary_(Or) {
+        logical_();
+        as_.or8(X64Assembler::RAX, X64Assembler::RCX);
+        as_.movzx8(X64Assembler::RAX, X64Assembler::RAX);
+    }
+
+    template <class Op>
+    void binary_(Op) {
+        as_.cmp(X64Assembler::RAX, X64Assembler::RCX);
+        as_.setcc(static_cast<X64Assembler::Cond>(condition_(Op())), X64Assembler::RAX);
+        as_.movzx8(X64Assembler::RAX, X64Assembler::RAX);
+    }
+
+    void unary_(Not) {
+        as_.test(X64Assembler::RAX, X64Assembler::RAX);
+        as_.setcc(X64Assembler::E, X64Assembler::RAX);
+        as_.movzx8(X64Assembler::RAX, X64Assembler::RAX);
+    }
+
+    void unary_(Neg) {
+        as_.neg(X64Assembler::RAX);
+    }
+
+    bool in_place_(Add, Reg reg) {
+        as_.add(reg, X64Assembler::RAX);
+        return true;
+    }
+
+    bool in_place_(Sub, Reg reg) {
+        as_.sub(reg, X64Assembler::RAX);
+        return true;
+    }
+
+    bool in_place_(Mul, Reg reg) {
+        as_.imul(reg, X64Assembler::RAX);
+        return true;
+    }
+
+    template <class Op>
+    bool in_place_(Op, Reg) {
+        return false;
+    }
+
+    static int condition_(Eq) {
+        return X64Assembler::E;
+    }
+
+    static int condition_(NotEq) {
+        return X64Assembler::NE;
+    }
+
+    static int condition_(Less) {
+        return X64Assembler::L;
+    }
+
+    static int condition_(Gr) {
+        return X64Assembler::G;
+    }
+
+    static int condition_(LessEq) {
+        return X64Assembler::LE;
+    }
+
+    static int condition_(GrEq) {
+        return X64Assembler::GE;
+    }
+
+    template <class Op>
+    static int condition_(Op) {
+        return -1;
+    }
+
+    // idiv faults on both, the tree reports the first and the second is
+    // left to fail the same way there
+    void divide_() {
+        Label checked;
+        as_.test(X64Assembler::RCX, X64Assembler::RCX);
+        as_.jump(X64Assembler::E, bail_);
+        as_.cmp(X64Assembler::RCX, -1);
+        as_.jump(X64Assembler::NE, checked);
+        as_.cmp(X64Assembler::RAX, INT_MIN);
+        as_.jump(X64Assembler::E, bail_);
+        as_.bind(checked);
+        as_.cdq();
+        as_.idiv(X64Assembler::RCX);
+    }
+
+    void logical_() {
+        as_.test(X64Assembler::RAX, X64Assembler::RAX);
+        as_.setcc(X64Assembler::NE, X64Assembler::RAX);
+        as_.test(X64Assembler::RCX, X64Assembler::RCX);
+        as_.setcc(X64Assembler::NE, X64Assembler::RCX);
+    }
+};
+
+#endif //INTERPRETER_JIT_H
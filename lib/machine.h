@@ -5,64 +5,482 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <memory>
-#include <sstream>
+#include <array.h>
+#include <bigint.h>
 #include <enums.h>
-
-class Value {
+#include <hash_map.h>
+#include <input.h>
+#include <metrics.h>
+#include <output.h>
+
+// string storage shared between values; the counter is not atomic since
+// a machine is only ever used from one thread
+class StringRep {
 public:
-    std::shared_ptr<void> &pval() {
-        return val_;
+    explicit StringRep(std::string str) : str_(std::move(str)) {
+        ++Metrics::value_allocations();
+    }
+
+    std::string &str() {
+        return str_;
+    }
+
+    bool shared() const {
+        return refs_ > 1;
+    }
+
+    bool interned() const {
+        return interned_;
+    }
+
+    // an interned string is never written, so its hash is computed once
+    void set_interned() {
+        interned_ = true;
+        hash_ = hash_bytes(str_.data(), str_.size());
+    }
+
+    uint32_t hash() const {
+        return hash_;
     }
 
+    void retain() {
+        ++refs_;
+    }
+
+    void release() {
+        if (--refs_ == 0) {
+            delete this;
+        }
+    }
+
+private:
+    int refs_ = 1;
+    bool interned_ = false;
+    uint32_t hash_ = 0;
+    std::string str_;
+};
+
+class Value;
+
+// string keys of map<string,int>, see Value::str_hash()
+template <>
+struct MapKeys<Value> {
+    static uint32_t hash(const Value &key);
+
+    static bool equal(const Value &lhs, const Value &rhs);
+};
+
+// ints and longs that fit in 64 bits are stored inline, strings, bigger
+// longs, arrays and maps by reference to StringRep, BigRep, ArrayRep and
+// MapRep; an empty string, array or map needs no storage at all
+class Value {
+public:
     Value &operator=(int val) {
-        *std::static_pointer_cast<int>(val_) = val;
+        release_();
+        type_ = TypeIdentifyer::INT_T;
+        int_ = val;
         return *this;
     }
 
     int &operator*() {
-        return *std::static_pointer_cast<int>(val_);
+        return int_;
+    }
+
+    int get_int() const {
+        return int_;
+    }
+
+    Long get_long() const {
+        if (big_) {
+            big_rep_->retain();
+            return Long::adopt(big_rep_);
+        }
+        return Long(long_);
+    }
+
+    void load_long(Long val) {
+        release_();
+        type_ = TypeIdentifyer::LONG_T;
+        big_ = !val.is_small();
+        if (big_) {
+            big_rep_ = val.release();
+        } else {
+            long_ = val.small();
+        }
     }
 
     void load_str(const std::string &str) {
-        val_ = std::make_shared<std::string>(str);
+        load_str(std::string(str));
+    }
+
+    void load_str(std::string &&str) {
+        release_();
+        type_ = TypeIdentifyer::STRING_T;
+        str_ = str.empty() ? nullptr : new StringRep(std::move(str));
+    }
+
+    // read-only access, never copies
+    const std::string &str() const {
+        return str_ ? str_->str() : empty_();
+    }
+
+    // appends in place unless the storage is shared, then the result is
+    // built in new storage with a single allocation
+    void append(const std::string &tail) {
+        if (str_ && !str_->shared()) {
+            str_->str() += tail;
+            return;
+        }
+        std::string result;
+        result.reserve(str().size() + tail.size());
+        result += str();
+        result += tail;
+        load_str(std::move(result));
+    }
+
+    // string literals share one storage per distinct text for the life of
+    // the thread; the pool keeps a reference, so the storage is never
+    // written to. Reference counts aren't atomic, so threads don't share it.
+    static const Value &interned(const std::string &str) {
+        static thread_local std::unordered_map<std::string, Value> pool;
+        auto it = pool.find(str);
+        if (it == pool.end()) {
+            it = pool.emplace(str, Value(TypeIdentifyer::STRING_T)).first;
+            it->second.load_str(str);
+            if (it->second.str_) {
+                it->second.str_->set_interned();
+            }
+        }
+        return it->second;
+    }
+
+    // equality of strings; interned strings are equal only if they are
+    // the same storage, other strings are compared in place
+    bool str_equal(const Value &other) const {
+        if (str_ == other.str_) {
+            return true;
+        }
+        if (str_ && other.str_ && str_->interned() && other.str_->interned()) {
+            return false;
+        }
+        return str() == other.str();
+    }
+
+    // the hash of an interned string was computed when it was interned
+    uint32_t str_hash() const {
+        if (str_ && str_->interned()) {
+            return str_->hash();
+        }
+        return hash_bytes(str().data(), str().size());
     }
 
+    // mutable access, detaches storage shared with other values
     std::string &get_str() {
-        return *std::static_pointer_cast<std::string>(pval());
+        if (!str_) {
+            str_ = new StringRep(std::string());
+        } else if (str_->shared()) {
+            auto rep = new StringRep(str_->str());
+            str_->release();
+            str_ = rep;
+        }
+        return str_->str();
+    }
+
+    // elements of an int array, read-only, never copies
+    const std::vector<int> &ints() const {
+        return int_array_ ? int_array_->items() : empty_items_<int>();
+    }
+
+    // mutable elements, detaches storage shared with other values
+    std::vector<int> &get_ints() {
+        return detach_(int_array_);
+    }
+
+    const std::vector<Value> &strs() const {
+        return str_array_ ? str_array_->items() : empty_items_<Value>();
+    }
+
+    std::vector<Value> &get_strs() {
+        return detach_(str_array_);
+    }
+
+    // an array of size zeros or empty strings
+    void load_array(TypeIdentifyer type, int size) {
+        size_t items = array_size(size);
+        release_();
+        type_ = type;
+        if (type_ == TypeIdentifyer::INT_ARRAY_T) {
+            int_array_ = items ? new ArrayRep<int>(std::vector<int>(items)) : nullptr;
+        } else {
+            str_array_ = items ? new ArrayRep<Value>(std::vector<Value>(
+                    items, Value(TypeIdentifyer::STRING_T))) : nullptr;
+        }
+    }
+
+    void load_array(std::vector<Value> items) {
+        check_array_size(items.size());
+        release_();
+        type_ = TypeIdentifyer::STRING_ARRAY_T;
+        str_array_ = items.empty() ? nullptr : new ArrayRep<Value>(std::move(items));
+    }
+
+    void load_array(std::vector<int> items) {
+        check_array_size(items.size());
+        release_();
+        type_ = TypeIdentifyer::INT_ARRAY_T;
+        int_array_ = items.empty() ? nullptr : new ArrayRep<int>(std::move(items));
+    }
+
+    // entries of a map, read-only, never copies
+    const FlatMap<int> &int_map() const {
+        return int_map_ ? int_map_->items() : empty_map_<int>();
+    }
+
+    // mutable entries, detaches storage shared with other values
+    FlatMap<int> &get_int_map() {
+        return detach_(int_map_);
+    }
+
+    const FlatMap<Value> &str_map() const {
+        return str_map_ ? str_map_->items() : empty_map_<Value>();
+    }
+
+    FlatMap<Value> &get_str_map() {
+        return detach_(str_map_);
     }
 
     TypeIdentifyer type() const {
         return type_;
     }
 
-    Value() : type_(TypeIdentifyer::INT_T), val_(std::make_shared<int>(0)) {}
+    Value() : type_(TypeIdentifyer::INT_T), int_(0) {}
 
-    explicit Value(TypeIdentifyer type) :
-            type_(type) {
+    explicit Value(TypeIdentifyer type) : type_(type) {
         switch (type_) {
-            case TypeIdentifyer::INT_T: {
-                val_ = std::make_shared<int>(0);
+            case TypeIdentifyer::STRING_T: {
+                str_ = nullptr;
                 break;
             }
-            case TypeIdentifyer::STRING_T: {
-                val_ = std::make_shared<std::string>();
+            case TypeIdentifyer::LONG_T: {
+                long_ = 0;
+                break;
+            }
+            case TypeIdentifyer::INT_ARRAY_T: {
+                int_array_ = nullptr;
+                break;
+            }
+            case TypeIdentifyer::STRING_ARRAY_T: {
+                str_array_ = nullptr;
+                break;
+            }
+            case TypeIdentifyer::INT_MAP_T: {
+                int_map_ = nullptr;
+                break;
+            }
+            case TypeIdentifyer::STRING_MAP_T: {
+                str_map_ = nullptr;
+                break;
+            }
+            default: {
+                int_ = 0;
                 break;
             }
         }
     }
 
+    Value(const Value &other) : type_(other.type_), big_(other.big_) {
+        copy_(other);
+    }
+
+    Value(Value &&other) noexcept : type_(other.type_), big_(other.big_) {
+        steal_(other);
+    }
+
+    Value &operator=(const Value &other) {
+        if (this != &other) {
+            other.retain_();
+            release_();
+            type_ = other.type_;
+            big_ = other.big_;
+            steal_bits_(other);
+        }
+        return *this;
+    }
+
+    Value &operator=(Value &&other) noexcept {
+        if (this != &other) {
+            release_();
+            type_ = other.type_;
+            big_ = other.big_;
+            steal_(other);
+        }
+        return *this;
+    }
+
+    ~Value() {
+        release_();
+    }
+
 private:
     TypeIdentifyer type_;
-    std::shared_ptr<void> val_;
+    bool big_ = false; // a long in big_rep_
+    union {
+        int int_;
+        StringRep *str_;
+        int64_t long_;
+        BigRep *big_rep_;
+        ArrayRep<int> *int_array_;
+        ArrayRep<Value> *str_array_;
+        MapRep<int> *int_map_;
+        MapRep<Value> *str_map_;
+    };
+
+    static const std::string &empty_() {
+        static const std::string empty;
+        return empty;
+    }
+
+    template <class T>
+    static const std::vector<T> &empty_items_() {
+        static const std::vector<T> empty;
+        return empty;
+    }
+
+    template <class K>
+    static const FlatMap<K> &empty_map_() {
+        static const FlatMap<K> empty;
+        return empty;
+    }
+
+    // for ArrayRep and MapRep
+    template <class Rep>
+    static typename Rep::Items &detach_(Rep *&rep) {
+        if (!rep) {
+            rep = new Rep(typename Rep::Items());
+        } else if (rep->shared()) {
+            auto copy = new Rep(rep->items());
+            rep->release();
+            rep = copy;
+        }
+        return rep->items();
+    }
+
+    void retain_() const {
+        if (type_ == TypeIdentifyer::STRING_T && str_) {
+            str_->retain();
+        } else if (big_) {
+            big_rep_->retain();
+        } else if (type_ == TypeIdentifyer::INT_ARRAY_T && int_array_) {
+            int_array_->retain();
+        } else if (type_ == TypeIdentifyer::STRING_ARRAY_T && str_array_) {
+            str_array_->retain();
+        } else if (type_ == TypeIdentifyer::INT_MAP_T && int_map_) {
+            int_map_->retain();
+        } else if (type_ == TypeIdentifyer::STRING_MAP_T && str_map_) {
+            str_map_->retain();
+        }
+    }
+
+    void release_() {
+        if (type_ == TypeIdentifyer::STRING_T && str_) {
+            str_->release();
+        } else if (big_) {
+            big_rep_->release();
+        } else if (type_ == TypeIdentifyer::INT_ARRAY_T && int_array_) {
+            int_array_->release();
+        } else if (type_ == TypeIdentifyer::STRING_ARRAY_T && str_array_) {
+            str_array_->release();
+        } else if (type_ == TypeIdentifyer::INT_MAP_T && int_map_) {
+            int_map_->release();
+        } else if (type_ == TypeIdentifyer::STRING_MAP_T && str_map_) {
+            str_map_->release();
+        }
+        big_ = false;
+    }
+
+    void steal_bits_(const Value &other) {
+        if (type_ == TypeIdentifyer::STRING_T) {
+            str_ = other.str_;
+        } else if (big_) {
+            big_rep_ = other.big_rep_;
+        } else if (type_ == TypeIdentifyer::LONG_T) {
+            long_ = other.long_;
+        } else if (type_ == TypeIdentifyer::INT_ARRAY_T) {
+            int_array_ = other.int_array_;
+        } else if (type_ == TypeIdentifyer::STRING_ARRAY_T) {
+            str_array_ = other.str_array_;
+        } else if (type_ == TypeIdentifyer::INT_MAP_T) {
+            int_map_ = other.int_map_;
+        } else if (type_ == TypeIdentifyer::STRING_MAP_T) {
+            str_map_ = other.str_map_;
+        } else {
+            int_ = other.int_;
+        }
+    }
+
+    void copy_(const Value &other) {
+        steal_bits_(other);
+        retain_();
+    }
+
+    void steal_(Value &other) {
+        steal_bits_(other);
+        if (type_ == TypeIdentifyer::STRING_T) {
+            other.str_ = nullptr;
+        } else if (big_) {
+            other.big_ = false;
+            other.long_ = 0;
+        } else if (type_ == TypeIdentifyer::INT_ARRAY_T) {
+            other.int_array_ = nullptr;
+        } else if (type_ == TypeIdentifyer::STRING_ARRAY_T) {
+            other.str_array_ = nullptr;
+        } else if (type_ == TypeIdentifyer::INT_MAP_T) {
+            other.int_map_ = nullptr;
+        } else if (type_ == TypeIdentifyer::STRING_MAP_T) {
+            other.str_map_ = nullptr;
+        }
+    }
+};
+
+inline uint32_t MapKeys<Value>::hash(const Value &key) {
+    return key.str_hash();
+}
+
+inline bool MapKeys<Value>::equal(const Value &lhs, const Value &rhs) {
+    return lhs.str_equal(rhs);
+}
+
+// strings of a string array equal to val
+inline int array_count(const std::vector<Value> &items, const Value &val) {
+    int count = 0;
+    for (const auto &item : items) {
+        count += item.str_equal(val);
+    }
+    return count;
+}
+
+// position of a variable: nesting depth of its scope and index in the frame
+struct VariableSlot {
+    int depth;
+    int index;
 };
 
+inline bool operator==(VariableSlot lhs, VariableSlot rhs) {
+    return lhs.depth == rhs.depth && lhs.index == rhs.index;
+}
+
+// thrown by exit() up to the Interpreter, which stops running statements;
+// not an std::exception, so the handlers of runtime errors let it pass
+struct ProgramExit {};
+
 class Machine {
     typedef int IndexT;
 public:
     explicit Machine(std::istream &in = std::cin, std::ostream &out = std::cout) :
-            in_(in), out_(out) {
+            input_(in), output_(out) {
+        input_.tie(&output_);
         local_.emplace_back();
+        levels_.push_back({0, 0});
     }
 
     void add(TypeIdentifyer type, const std::string &name) {
@@ -74,6 +492,7 @@ public:
     }
 
     void enter_local_level() {
+        ++metrics_.scopes_entered;
         local_.emplace_back();
     }
 
@@ -81,6 +500,7 @@ public:
         if (local_.size() == 1) {
             throw std::underflow_error("No local level to leave");
         }
+        ++metrics_.scopes_left;
         for (const auto &name : local_.back()) {
             vars_.erase(name);
         }
@@ -88,18 +508,68 @@ public:
     }
 
     Value &get(const std::string &name) {
+        ++metrics_.lookups;
         if (vars_.find(name) == vars_.end()) {
             throw std::invalid_argument("No variable " + name);
         }
         return vars_[name];
     }
 
+    void resize_globals(int size) {
+        levels_.front().size = size;
+        reserve_frame_(size);
+    }
+
+    void enter_frame(int size) {
+        ++metrics_.scopes_entered;
+        int base = levels_.back().base + levels_.back().size;
+        levels_.push_back({base, size});
+        reserve_frame_(base + size);
+    }
+
+    void leave_frame() {
+        if (levels_.size() == 1) {
+            throw std::underflow_error("No local level to leave");
+        }
+        ++metrics_.scopes_left;
+        levels_.pop_back();
+    }
+
+    // drops frames left behind by a statement interrupted with an error
+    void reset_frames() {
+        levels_.resize(1);
+        tmp_.clear();
+    }
+
+    // the frames of other, for a thread of a parallel for; strings and longs
+    // are left empty since their storage can't be shared between threads
+    void copy_frames(const Machine &other) {
+        levels_ = other.levels_;
+        int size = levels_.back().base + levels_.back().size;
+        frame_.assign(size, Value());
+        for (int i = 0; i < size; ++i) {
+            const auto &val = other.frame_[i];
+            if (val.type() == TypeIdentifyer::INT_T) {
+                frame_[i] = val.get_int();
+            } else {
+                frame_[i] = Value(val.type());
+            }
+        }
+    }
+
+    Value &slot(VariableSlot slot) {
+        ++metrics_.lookups;
+        return frame_[levels_[slot.depth].base + slot.index];
+    }
+
     void push(const Value &val) {
         tmp_.push_back(val);
+        metrics_.stack_depth(tmp_.size());
     }
 
     void push(TypeIdentifyer type = TypeIdentifyer::INT_T) {
         tmp_.emplace_back(type);
+        metrics_.stack_depth(tmp_.size());
     }
 
     Value &top(IndexT k = 0) {
@@ -117,53 +587,111 @@ public:
         return regs_[num];
     }
 
+    // reads input from the file instead of the stream given on construction
+    bool open_input(const char *filename) {
+        return input_.open(filename);
+    }
+
     void read_line() {
-        std::string s;
-        while (!getline(buffer_, s) && !is_eof_()) {
-            buff_check_();
-        }
         push(TypeIdentifyer::STRING_T);
-        top().load_str(s);
+        top().load_str(input_.read_line());
     }
 
     void read_word() {
-        std::string s;
-        while (!(buffer_ >> s) && !is_eof_()) {
-            buff_check_();
-        }
         push(TypeIdentifyer::STRING_T);
-        top().load_str(s);
+        top().load_str(input_.read_word());
     }
 
     void read_int() {
-        int val = 0;
-        while (!(buffer_ >> val) && !is_eof_()) {
-            buff_check_();
-        }
+        int val = input_.read_int();
         push(TypeIdentifyer::INT_T);
         top() = val;
     }
 
-    void write() {
-        switch (top().type()) {
+    void read_long() {
+        push(TypeIdentifyer::LONG_T);
+        top().load_long(input_.read_long());
+    }
+
+    // an array of size read_int()s
+    void read_ints(int size) {
+        Value array(TypeIdentifyer::INT_ARRAY_T);
+        array.load_array(TypeIdentifyer::INT_ARRAY_T, size);
+        if (size > 0) {
+            input_.read_ints(array.get_ints().data(), size);
+        }
+        push(array);
+    }
+
+    // the words left in the input
+    void read_all_words() {
+        std::vector<Value> words;
+        for (auto word = input_.read_word(); !word.empty(); word = input_.read_word()) {
+            words.emplace_back(TypeIdentifyer::STRING_T);
+            words.back().load_str(word);
+        }
+        push(TypeIdentifyer::STRING_ARRAY_T);
+        top().load_array(std::move(words));
+    }
+
+    void write(const Value &val) {
+        switch (val.type()) {
             case TypeIdentifyer::INT_T: {
-                int val = *top();
-                out_ << val;
-                pop();
+                output_.write_int(val.get_int());
                 break;
             }
             case TypeIdentifyer::STRING_T: {
-                out_ << top().get_str();
-                pop();
+                output_.write(val.str());
+                break;
+            }
+            case TypeIdentifyer::LONG_T: {
+                output_.write_long(val.get_long());
                 break;
             }
+            default:
+                throw std::invalid_argument(is_map(val.type()) ? "Maps can't be written"
+                                                               : "Arrays can't be written");
         }
     }
 
+    void write_line(const Value &val) {
+        write(val);
+        output_.put('\n');
+    }
+
+    void write() {
+        write(top());
+        pop();
+    }
+
+    void write_line() {
+        write_line(top());
+        pop();
+    }
+
     void write(const std::string &s) {
-        push(TypeIdentifyer::STRING_T);
-        top().load_str(s);
-        write();
+        output_.write(s);
+    }
+
+    // passes the buffered output to the stream
+    void flush() {
+        output_.flush();
+    }
+
+    OutputBuffer &output() {
+        return output_;
+    }
+
+    Metrics &metrics() {
+        return metrics_;
+    }
+
+    uint64_t bytes_read() const {
+        return input_.bytes();
+    }
+
+    uint64_t bytes_written() const {
+        return output_.bytes();
     }
 
 private:
@@ -173,34 +701,23 @@ private:
     std::vector<Value> tmp_;
 
     std::vector<std::vector<std::string>> local_;
-    std::istream &in_;
 
-    std::ostream &out_;
+    struct Level {
+        int base;
+        int size;
+    };
+    std::vector<Value> frame_;
+    std::vector<Level> levels_;
 
-    std::stringstream buffer_;
+    InputBuffer input_;
 
-    bool eof_ = false;
+    OutputBuffer output_;
 
-    bool is_eof_() const {
-        return eof_;
-    }
+    Metrics metrics_;
 
-    void read_buffer_() {
-        std::string s;
-        std::getline(in_, s);
-        buffer_ << s;
-        if (in_.eof()) {
-            eof_ = true;
-        }
-    }
-
-    void buff_check_() {
-        if (buffer_.eof()) {
-            buffer_.clear();
-            read_buffer_();
-        } else {
-            buffer_.clear();
-            throw std::invalid_argument(CANT_READ);
+    void reserve_frame_(int size) {
+        if (frame_.size() < static_cast<size_t>(size)) {
+            frame_.resize(size);
         }
     }
 };
@@ -0,0 +1,91 @@
+#ifndef INTERPRETER_MAPPED_FILE_H
+#define INTERPRETER_MAPPED_FILE_H
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define INTERPRETER_MMAP 1
+#else
+#define INTERPRETER_MMAP 0
+#endif
+
+// Read-only contents of a whole file: mapped into memory where the platform
+// allows it, read into a buffer otherwise.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const char *filename) {
+        close();
+#if INTERPRETER_MMAP
+        int fd = ::open(filename, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                madvise(map, st.st_size, MADV_SEQUENTIAL);
+                map_ = static_cast<char *>(map);
+                size_ = st.st_size;
+                data_ = map_;
+                ::close(fd);
+                return true;
+            }
+        }
+        ::close(fd);
+#endif
+        std::ifstream file(filename, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        storage_.assign(std::istreambuf_iterator<char>(file),
+                        std::istreambuf_iterator<char>());
+        data_ = storage_.data();
+        size_ = storage_.size();
+        return true;
+    }
+
+    void close() {
+#if INTERPRETER_MMAP
+        if (map_) {
+            munmap(map_, size_);
+        }
+#endif
+        map_ = nullptr;
+        storage_.clear();
+        data_ = storage_.data();
+        size_ = 0;
+    }
+
+    const char *data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    char *map_ = nullptr;
+    std::string storage_;
+    const char *data_ = storage_.data();
+    size_t size_ = 0;
+};
+
+#endif //INTERPRETER_MAPPED_FILE_H
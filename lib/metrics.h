@@ -0,0 +1,208 @@
+#ifndef INTERPRETER_METRICS_H
+#define INTERPRETER_METRICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <typeinfo>
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+// The counts of evaluated nodes and executed instructions cost every node
+// and every instruction, so only a build with INTERPRETER_METRICS=1 keeps
+// them; the other counters are always kept
+#ifndef INTERPRETER_METRICS
+#define INTERPRETER_METRICS 0
+#endif
+
+#if INTERPRETER_METRICS
+#define INTERPRETER_METRIC(statement) statement
+#else
+#define INTERPRETER_METRIC(statement)
+#endif
+
+// The classes of the evaluated nodes, numbered in the order their first
+// node is counted. The names are kept for the life of the program, so
+// they can be read from a signal handler; the classes past MAX - 1 share
+// the last number.
+class NodeKinds {
+public:
+    static const int MAX = 256;
+
+    template <class T>
+    static int id() {
+        static const int id = add_(typeid(T));
+        return id;
+    }
+
+    // how many kinds have a number so far
+    static int size() {
+        return size_().load(std::memory_order_acquire);
+    }
+
+    static const char *name(int id) {
+        return names_()[id];
+    }
+
+private:
+    static std::atomic<int> &size_() {
+        static std::atomic<int> size(0);
+        return size;
+    }
+
+    static const char **names_() {
+        static const char *names[MAX] = {};
+        return names;
+    }
+
+    static int add_(const std::type_info &type) {
+        static std::mutex mutex;
+        std::lock_guard<std::mutex> lock(mutex);
+        int id = size_().load(std::memory_order_relaxed);
+        if (id == MAX - 1) {
+            names_()[id] = "other";
+        } else if (id < MAX - 1) {
+            names_()[id] = name_(type);
+        }
+        if (id < MAX) {
+            size_().store(id + 1, std::memory_order_release);
+        }
+        return id < MAX ? id : MAX - 1;
+    }
+
+    // the name of the class as it is written in the source
+    static const char *name_(const std::type_info &type) {
+#ifdef __GNUG__
+        int status = 0;
+        char *name = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+        if (status == 0 && name) {
+            return name;
+        }
+#endif
+        return type.name();
+    }
+};
+
+// What a machine has done so far. Counters are plain increments: a machine
+// is only used from one thread.
+struct Metrics {
+    static const int OPCODES = 256;
+
+    uint64_t nodes[NodeKinds::MAX] = {};    // evaluate() calls by NodeKinds id,
+    uint64_t instructions[OPCODES] = {};    // VM instructions by opcode,
+                                            // both with INTERPRETER_METRICS
+    uint64_t lookups = 0;                   // variable accesses
+    uint64_t scopes_entered = 0;
+    uint64_t scopes_left = 0;
+    uint64_t stack_high = 0;                // most values on the operand stack
+
+    void count(int kind) {
+        ++nodes[kind];
+    }
+
+    void stack_depth(size_t depth) {
+        if (depth > stack_high) {
+            stack_high = depth;
+        }
+    }
+
+    // adds what another machine has done
+    void add(const Metrics &other) {
+        for (int i = 0; i < NodeKinds::MAX; ++i) {
+            nodes[i] += other.nodes[i];
+        }
+        for (int i = 0; i < OPCODES; ++i) {
+            instructions[i] += other.instructions[i];
+        }
+        lookups += other.lookups;
+        scopes_entered += other.scopes_entered;
+        scopes_left += other.scopes_left;
+        stack_depth(other.stack_high);
+    }
+
+    // storage allocated for string values, by all machines of the thread
+    static uint64_t &value_allocations() {
+        static thread_local uint64_t count = 0;
+        return count;
+    }
+};
+
+// Formats JSON into a fixed buffer with no allocations and no locale, so
+// that metrics can be written from a signal handler. What doesn't fit is
+// cut off.
+class JsonBuffer {
+public:
+    static const size_t SIZE = 16384;
+
+    void begin(const char *key = nullptr) {
+        key_(key);
+        put_('{');
+        first_ = true;
+    }
+
+    void end() {
+        put_('}');
+        first_ = false;
+    }
+
+    void number(const char *key, uint64_t val) {
+        key_(key);
+        char digits[20];
+        size_t len = 0;
+        do {
+            digits[len++] = static_cast<char>('0' + val % 10);
+            val /= 10;
+        } while (val);
+        while (len) {
+            put_(digits[--len]);
+        }
+    }
+
+    void boolean(const char *key, bool val) {
+        key_(key);
+        raw_(val ? "true" : "false");
+    }
+
+    const char *data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    char data_[SIZE];
+    size_t size_ = 0;
+    bool first_ = true;
+
+    void put_(char c) {
+        if (size_ < SIZE) {
+            data_[size_++] = c;
+        }
+    }
+
+    void raw_(const char *s) {
+        for (; *s; ++s) {
+            put_(*s);
+        }
+    }
+
+    // names are identifiers and class names, nothing to escape
+    void key_(const char *key) {
+        if (!first_) {
+            put_(',');
+        }
+        first_ = false;
+        if (key) {
+            put_('"');
+            raw_(key);
+            raw_("\":");
+        }
+    }
+};
+
+#endif //INTERPRETER_METRICS_H
@@ -0,0 +1,333 @@
+#ifndef INTERPRETER_OPERATIONS_H
+#define INTERPRETER_OPERATIONS_H
+
+#include <stdexcept>
+#include <string>
+#include <bigint.h>
+#include <bytecode.h>
+
+// Operations instantiated by the type-specialized operator nodes. apply()
+// is the whole hot path: operand types are known before execution starts.
+// Longs overflow into big integers, see Long.
+
+struct Add {
+    template <class T>
+    static T apply(const T &fval, const T &sval) {
+        return fval + sval;
+    }
+
+    static const char *name() {
+        return "+";
+    }
+
+    static OpCode opcode() {
+        return OpCode::ADD;
+    }
+
+    static OpCode int_opcode() {
+        return OpCode::INT_ADD;
+    }
+
+    static OpCode long_opcode() {
+        return OpCode::LONG_ADD;
+    }
+};
+
+struct Sub {
+    static int apply(int fval, int sval) {
+        return fval - sval;
+    }
+
+    static Long apply(const Long &fval, const Long &sval) {
+        return fval - sval;
+    }
+
+    static const char *name() {
+        return "-";
+    }
+
+    static OpCode int_opcode() {
+        return OpCode::INT_SUB;
+    }
+
+    static OpCode long_opcode() {
+        return OpCode::LONG_SUB;
+    }
+};
+
+struct Mul {
+    static int apply(int fval, int sval) {
+        return fval * sval;
+    }
+
+    static Long apply(const Long &fval, const Long &sval) {
+        return fval * sval;
+    }
+
+    static const char *name() {
+        return "*";
+    }
+
+    static OpCode int_opcode() {
+        return OpCode::INT_MUL;
+    }
+
+    static OpCode long_opcode() {
+        return OpCode::LONG_MUL;
+    }
+};
+
+struct Div {
+    static int apply(int fval, int sval) {
+        if (sval == 0) {
+            throw std::runtime_error("Division by zero.");
+        }
+        return fval / sval;
+    }
+
+    // throws on division by zero too
+    static Long apply(const Long &fval, const Long &sval) {
+        return fval / sval;
+    }
+
+    static const char *name() {
+        return "/";
+    }
+
+    static OpCode int_opcode() {
+        return OpCode::INT_DIV;
+    }
+
+    static OpCode long_opcode() {
+        return OpCode::LONG_DIV;
+    }
+};
+
+struct Mod {
+    static int apply(int fval, int sval) {
+        if (sval == 0) {
+            throw std::runtime_error("Division by zero.");
+        }
+        return fval % sval;
+    }
+
+    static Long apply(const Long &fval, const Long &sval) {
+        return fval % sval;
+    }
+
+    static const char *name() {
+        return "%";
+    }
+
+    static OpCode int_opcode() {
+        return OpCode::INT_MOD;
+    }
+
+    static OpCode long_opcode() {
+        return OpCode::LONG_MOD;
+    }
+};
+
+struct And {
+    static int apply(int fval, int sval) {
+        return fval && sval;
+    }
+
+    static const char *name() {
+        return "&&";
+    }
+
+    static OpCode int_opcode() {
+        return OpCode::INT_AND;
+    }
+};
+
+struct Or {
+    static int apply(int fval, int sval) {
+        return fval || sval;
+    }
+
+    static const char *name() {
+        return "||";
+    }
+
+    static OpCode int_opcode() {
+        return OpCode::INT_OR;
+    }
+};
+
+struct Eq {
+    template <class T>
+    static int apply(const T &fval, const T &sval) {
+        return fval == sval;
+    }
+
+    static const char *name() {
+        return "==";
+    }
+
+    static OpCode opcode() {
+        return OpCode::EQ;
+    }
+
+    static OpCode int_opcode() {
+        return OpCode::INT_EQ;
+    }
+
+    static OpCode long_opcode() {
+        return OpCode::LONG_EQ;
+    }
+};
+
+struct NotEq {
+    template <class T>
+    static int apply(const T &fval, const T &sval) {
+        return fval != sval;
+    }
+
+    static const char *name() {
+        return "!=";
+    }
+
+    static OpCode opcode() {
+        return OpCode::NOT_EQ;
+    }
+
+    static OpCode int_opcode() {
+        return OpCode::INT_NOT_EQ;
+    }
+
+    static OpCode long_opcode() {
+        return OpCode::LONG_NOT_EQ;
+    }
+};
+
+struct Less {
+    template <class T>
+    static int apply(const T &fval, const T &sval) {
+        return fval < sval;
+    }
+
+    static const char *name() {
+        return "<";
+    }
+
+    static OpCode opcode() {
+        return OpCode::LESS;
+    }
+
+    static OpCode int_opcode() {
+        return OpCode::INT_LESS;
+    }
+
+    static OpCode long_opcode() {
+        return OpCode::LONG_LESS;
+    }
+};
+
+struct Gr {
+    template <class T>
+    static int apply(const T &fval, const T &sval) {
+        return fval > sval;
+    }
+
+    static const char *name() {
+        return ">";
+    }
+
+    static OpCode opcode() {
+        return OpCode::GR;
+    }
+
+    static OpCode int_opcode() {
+        return OpCode::INT_GR;
+    }
+
+    static OpCode long_opcode() {
+        return OpCode::LONG_GR;
+    }
+};
+
+struct LessEq {
+    template <class T>
+    static int apply(const T &fval, const T &sval) {
+        return fval <= sval;
+    }
+
+    static const char *name() {
+        return "<=";
+    }
+
+    static OpCode opcode() {
+        return OpCode::LESS_EQ;
+    }
+
+    static OpCode int_opcode() {
+        return OpCode::INT_LESS_EQ;
+    }
+
+    static OpCode long_opcode() {
+        return OpCode::LONG_LESS_EQ;
+    }
+};
+
+struct GrEq {
+    template <class T>
+    static int apply(const T &fval, const T &sval) {
+        return fval >= sval;
+    }
+
+    static const char *name() {
+        return ">=";
+    }
+
+    static OpCode opcode() {
+        return OpCode::GR_EQ;
+    }
+
+    static OpCode int_opcode() {
+        return OpCode::INT_GR_EQ;
+    }
+
+    static OpCode long_opcode() {
+        return OpCode::LONG_GR_EQ;
+    }
+};
+
+struct Not {
+    static int apply(int val) {
+        return !val;
+    }
+
+    static const char *name() {
+        return "!";
+    }
+
+    static OpCode int_opcode() {
+        return OpCode::INT_NOT;
+    }
+};
+
+struct Neg {
+    static int apply(int val) {
+        return -val;
+    }
+
+    static Long apply(const Long &val) {
+        return -val;
+    }
+
+    static const char *name() {
+        return "-";
+    }
+
+    static OpCode int_opcode() {
+        return OpCode::INT_NEG;
+    }
+
+    static OpCode long_opcode() {
+        return OpCode::LONG_NEG;
+    }
+};
+
+#endif //INTERPRETER_OPERATIONS_H
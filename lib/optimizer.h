@@ -0,0 +1,119 @@
+#ifndef INTERPRETER_OPTIMIZER_H
+#define INTERPRETER_OPTIMIZER_H
+
+#include <utility>
+#include <vector>
+#include <machine.h>
+
+class ExpressionNode;
+class HoistedNode;
+
+// Nodes simplify themselves in Node::optimize() once types are checked;
+// like the type checker, the optimizer swaps in the returned node.
+//  -O0  the tree is executed as parsed
+//  -O1  constant folding, dead branches and empty statements are removed
+//  -O2  also algebraic simplification (x + 0, x * 1, -(-x), ...) and
+//       loop optimizations: invariant int expressions are computed once
+//       per loop, counted for loops and reductions get their own nodes,
+//       the bytecode of a counted loop indexing arrays by its counter
+//       checks the bounds once on entry
+class Optimizer {
+public:
+    static const int MAX_LEVEL = 2;
+
+    // strings longer than this are built at run time instead of folded
+    static const size_t MAX_FOLDED_STRING = 1024;
+
+    explicit Optimizer(int level = 1) : level_(level) {}
+
+    int level() const {
+        return level_;
+    }
+
+    void set_level(int level) {
+        level_ = level;
+    }
+
+    bool folding() const {
+        return level_ >= 1;
+    }
+
+    bool algebra() const {
+        return level_ >= 2;
+    }
+
+    bool loops() const {
+        return level_ >= 2;
+    }
+
+    // expressions optimized until leave_loop() that don't depend on the
+    // assigned variables are moved to the hoisted list of the loop, arrays
+    // indexed by a variable go to its indexed list
+    void enter_loop(const std::vector<VariableSlot> &assigned,
+                    std::vector<HoistedNode *> &hoisted,
+                    std::vector<std::pair<VariableSlot, VariableSlot>> &indexed) {
+        loops_.push_back({&assigned, &hoisted, &indexed});
+    }
+
+    void indexed(VariableSlot array, VariableSlot index) {
+        if (!loops_.empty()) {
+            loops_.back().indexed->emplace_back(array, index);
+        }
+    }
+
+    void leave_loop() {
+        loops_.pop_back();
+    }
+
+    // hoisted values are kept in the nodes, so nothing is hoisted in the
+    // body of a parallel for, which its threads run at once
+    void enter_parallel() {
+        ++parallel_;
+    }
+
+    void leave_parallel() {
+        --parallel_;
+    }
+
+    template <class T>
+    void optimize(T *&node) {
+        auto optimized = node->optimize(*this);
+        if (optimized != node) {
+            delete node;
+            node = optimized;
+        }
+        hoist_(node);
+    }
+
+    // replaces a statement until it can't be simplified further
+    template <class T>
+    void prune(T *&node) {
+        while (node) {
+            auto pruned = node->prune(*this);
+            if (pruned == node) {
+                break;
+            }
+            delete node;
+            node = pruned;
+        }
+    }
+
+private:
+    struct Loop {
+        const std::vector<VariableSlot> *assigned;
+        std::vector<HoistedNode *> *hoisted;
+        std::vector<std::pair<VariableSlot, VariableSlot>> *indexed;
+    };
+
+    int level_;
+    std::vector<Loop> loops_;
+    int parallel_ = 0;
+
+    template <class T>
+    void hoist_(T *&node) {}
+
+    // defined in syntax_tree.h
+    void hoist_(ExpressionNode *&node);
+};
+
+#endif //INTERPRETER_OPTIMIZER_H
@@ -0,0 +1,111 @@
+#ifndef INTERPRETER_OUTPUT_H
+#define INTERPRETER_OUTPUT_H
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <bigint.h>
+
+// Output of write()/write_line(). Values are formatted into a block that is
+// passed to the stream when it fills up and on flush(): before exit, before
+// an interactive prompt or a read from a stream, on errors and at the end.
+class OutputBuffer {
+public:
+    static const size_t BLOCK = 1 << 16;
+
+    explicit OutputBuffer(std::ostream &out = std::cout) : out_(out) {}
+
+    OutputBuffer(const OutputBuffer &) = delete;
+
+    OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+    ~OutputBuffer() {
+        flush();
+    }
+
+    void put(char c) {
+        if (size_ == BLOCK) {
+            drain_();
+        }
+        data_[size_++] = c;
+    }
+
+    void write(const char *s, size_t len) {
+        if (len > BLOCK - size_) {
+            drain_();
+            if (len >= BLOCK) {
+                bytes_ += len;
+                out_.write(s, len);
+                return;
+            }
+        }
+        memcpy(data_ + size_, s, len);
+        size_ += len;
+    }
+
+    void write(const std::string &s) {
+        write(s.data(), s.size());
+    }
+
+    void write_int(int val) {
+        write_integer_<unsigned>(val);
+    }
+
+    void write_int64(int64_t val) {
+        write_integer_<uint64_t>(val);
+    }
+
+    void write_long(const Long &val) {
+        if (val.is_small()) {
+            write_int64(val.small());
+        } else {
+            write(val.to_string());
+        }
+    }
+
+    // bytes passed to the stream or waiting in the block, 0 without metrics
+    uint64_t bytes() const {
+        return bytes_ + size_;
+    }
+
+    void flush() {
+        drain_();
+        out_.flush();
+    }
+
+private:
+    std::ostream &out_;
+    char data_[BLOCK];
+    size_t size_ = 0;
+    uint64_t bytes_ = 0;
+
+    // digits are written from the end, the most negative value is handled
+    // as unsigned
+    template <class Unsigned, class Signed>
+    void write_integer_(Signed val) {
+        char digits[24];
+        char *end = digits + sizeof(digits);
+        char *begin = end;
+        Unsigned magnitude = val < 0 ? 0u - static_cast<Unsigned>(val) :
+                             static_cast<Unsigned>(val);
+        do {
+            *--begin = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+        if (val < 0) {
+            *--begin = '-';
+        }
+        write(begin, end - begin);
+    }
+
+    void drain_() {
+        if (size_) {
+            bytes_ += size_;
+            out_.write(data_, size_);
+            size_ = 0;
+        }
+    }
+};
+
+#endif //INTERPRETER_OUTPUT_H
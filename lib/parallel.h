@@ -0,0 +1,199 @@
+#ifndef INTERPRETER_PARALLEL_H
+#define INTERPRETER_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads running the chunks of a parallel for. Every worker starts with a
+// contiguous range of chunks and takes them from the front; a worker that
+// runs out steals single chunks from the back of the others' ranges, so
+// neighbouring chunks mostly run on the same worker. The thread calling
+// run() is worker 0 and there is one job at a time: a loop started while
+// the pool is busy (by another interpreter or from inside a chunk) is told
+// to run on its own.
+class WorkStealingPool {
+public:
+    typedef std::function<void(size_t worker, size_t chunk)> Job;
+
+    // threads in addition to the calling one
+    explicit WorkStealingPool(size_t threads) : ranges_(threads + 1) {
+        for (size_t i = 1; i <= threads; ++i) {
+            threads_.emplace_back([this, i]() { work_(i); });
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        wake_.notify_all();
+        for (auto &thread : threads_) {
+            thread.join();
+        }
+    }
+
+    // threads of the shared pool, one per core but the calling one by
+    // default; changes after the pool is started have no effect
+    static size_t &shared_threads() {
+        static size_t threads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        return threads;
+    }
+
+    // started on first use
+    static WorkStealingPool &shared() {
+        static WorkStealingPool pool(shared_threads());
+        return pool;
+    }
+
+    size_t workers() const {
+        return ranges_.size();
+    }
+
+    // runs job for every chunk in [0, chunks) and returns when all are
+    // done; false if the pool is busy, nothing is run then. After a chunk
+    // throws, chunks after it are skipped and the exception of the first
+    // failed chunk is rethrown.
+    bool run(size_t chunks, const Job &job) {
+        bool idle = false;
+        if (!running_.compare_exchange_strong(idle, true)) {
+            return false;
+        }
+        size_t workers = ranges_.size();
+        for (size_t i = 0; i < workers; ++i) {
+            ranges_[i].begin = chunks * i / workers;
+            ranges_[i].end = chunks * (i + 1) / workers;
+        }
+        failed_ = chunks;
+        error_ = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = &job;
+            ++generation_;
+        }
+        wake_.notify_all();
+        run_chunks_(0, job);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            job_ = nullptr;
+            done_.wait(lock, [this]() { return busy_ == 0; });
+        }
+        auto error = error_;
+        running_ = false;
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return true;
+    }
+
+private:
+    // chunks [begin, end) not taken yet
+    struct Range {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    std::vector<std::thread> threads_;
+    std::vector<Range> ranges_;
+    std::atomic<bool> running_{false};
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const Job *job_ = nullptr;
+    size_t generation_ = 0;
+    size_t busy_ = 0;
+    bool stopped_ = false;
+
+    std::mutex error_mutex_;
+    size_t failed_ = 0; // the first chunk that threw
+    std::exception_ptr error_;
+
+    void work_(size_t worker) {
+        size_t seen = 0;
+        while (true) {
+            const Job *job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&]() { return stopped_ || generation_ != seen; });
+                if (stopped_) {
+                    return;
+                }
+                seen = generation_;
+                if (!job_) {
+                    continue;
+                }
+                job = job_;
+                ++busy_;
+            }
+            run_chunks_(worker, *job);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --busy_;
+            }
+            done_.notify_one();
+        }
+    }
+
+    void run_chunks_(size_t worker, const Job &job) {
+        size_t chunk;
+        while (take_(worker, chunk) || steal_(worker, chunk)) {
+            if (!skipped_(chunk)) {
+                try {
+                    job(worker, chunk);
+                } catch (...) {
+                    fail_(chunk, std::current_exception());
+                }
+            }
+        }
+    }
+
+    bool take_(size_t worker, size_t &chunk) {
+        auto &range = ranges_[worker];
+        std::lock_guard<std::mutex> lock(range.mutex);
+        if (range.begin == range.end) {
+            return false;
+        }
+        chunk = range.begin++;
+        return true;
+    }
+
+    bool steal_(size_t worker, size_t &chunk) {
+        for (size_t i = 1; i < ranges_.size(); ++i) {
+            auto &range = ranges_[(worker + i) % ranges_.size()];
+            std::lock_guard<std::mutex> lock(range.mutex);
+            if (range.begin != range.end) {
+                chunk = --range.end;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool skipped_(size_t chunk) {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        return chunk > failed_;
+    }
+
+    void fail_(size_t chunk, std::exception_ptr error) {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        if (chunk < failed_) {
+            failed_ = chunk;
+            error_ = error;
+        }
+    }
+};
+
+#endif //INTERPRETER_PARALLEL_H
@@ -1,12 +1,96 @@
 #ifndef INTERPRETER_PARSER_H
 #define INTERPRETER_PARSER_H
 
+#include <cstddef>
+#include <iostream>
+#include <string>
 #include <interpreter.h>
 
-extern FlexInterpreter flex_interpreter;
-extern bool set_file(char *filename);
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+
+// One parse: the scanner, the position in the source and the state of the
+// interactive prompt. Statements are passed to the interpreter as soon as
+// they are parsed. Contexts share nothing, so interpreters can parse and
+// run on several threads at once, each with its own context.
+class ParserContext {
+public:
+    const std::string ps1 = ">>>  "; // prompt to start statement
+    const std::string ps2 = "... "; // prompt to continue statement
+
+    // syntax errors are reported to errors
+    explicit ParserContext(Interpreter &interpreter,
+                           std::ostream &errors = std::cerr);
+
+    ParserContext(const ParserContext &) = delete;
+
+    ParserContext &operator=(const ParserContext &) = delete;
+
+    ~ParserContext();
+
+    // parses the file, read into memory whole
+    bool open_file(const char *filename);
+
+    // parses a copy of the buffer
+    void open_buffer(const char *data, size_t size);
+
+    // parses statements typed on stdin, prompting for each line
+    void open_interactive();
+
+    // parses to the end of the source or until the program calls exit()
+    void parse();
+
+    Interpreter &interpreter() {
+        return interpreter_;
+    }
+
+    std::ostream &errors() {
+        return errors_;
+    }
+
+    // state of the scanner and the parser
+    bool eof = false; // set by the EOF action in the scanner
+    bool completeLine = false; // managed by yyread
+    bool atStart = false; // true before scanner sees printable chars on line
+    int next_line = 1; // position of the next character
+    int next_column = 1;
+    int string_line = 0; // where the string constant being read starts
+    int string_column = 0;
+
+private:
+    Interpreter &interpreter_;
+    std::ostream &errors_;
+    yyscan_t scanner_ = nullptr;
+
+    void reset_();
+};
+
 extern int yydebug;
-extern int yyparse(Interpreter *root);
+extern int yyparse(ParserContext *context, yyscan_t scanner);
+
+// parses the program in the buffer whole and runs it with the interpreter
+inline void run_source(Interpreter &interpreter, const std::string &source,
+                       std::ostream &errors = std::cerr) {
+    ParserContext context(interpreter, errors);
+    context.open_buffer(source.data(), source.size());
+    interpreter.set_whole_program(true);
+    ArenaScope nodes(interpreter.arena());
+    context.parse();
+    interpreter.run_program();
+}
+
+// writes the source as C++, see Interpreter::transpile_program()
+inline void transpile_source(Interpreter &interpreter, const std::string &source,
+                             std::ostream &out, std::ostream &errors = std::cerr) {
+    ParserContext context(interpreter, errors);
+    context.open_buffer(source.data(), source.size());
+    interpreter.set_whole_program(true);
+    ArenaScope nodes(interpreter.arena());
+    context.parse();
+    interpreter.transpile_program(out);
+}
 
 typedef struct {
     std::string str;
@@ -15,6 +99,7 @@ typedef struct {
     CmdListNode *cmd_list;
     OperatorNode  *oper;
     TypeNode *var_type;
+    ReductionListNode *reductions;
 } YYSTYPE_struct;
 
 #endif //INTERPRETER_PARSER_H
@@ -0,0 +1,234 @@
+#ifndef INTERPRETER_PROFILER_H
+#define INTERPRETER_PROFILER_H
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Statement level profile of the tree engine (--profile). While a profiler
+// is current, every statement counts its runs and the time spent in it
+// with (inclusive) and without (exclusive) the statements nested in it.
+// There are no functions, so a statement is always run from the same stack
+// of enclosing statements.
+class Profiler {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // name is the root of the stacks, source (if known) is listed
+    Profiler(const std::string &name, const std::string &source,
+             const std::string &output) :
+            name_(name), output_(output) {
+        size_t begin = 0;
+        while (begin < source.size()) {
+            size_t end = source.find('\n', begin);
+            if (end == std::string::npos) {
+                end = source.size();
+            }
+            lines_.push_back(source.substr(begin, end - begin));
+            begin = end + 1;
+        }
+    }
+
+    Profiler(const Profiler &) = delete;
+
+    Profiler &operator=(const Profiler &) = delete;
+
+    // per thread, like Arena::current()
+    static Profiler *&current() {
+        static thread_local Profiler *current = nullptr;
+        return current;
+    }
+
+    // times a statement while it's alive; id keeps the statement's entry
+    // between runs, -1 before the first one
+    class Scope {
+    public:
+        Scope(Profiler &profiler, int &id, int line, int column) :
+                profiler_(profiler) {
+            if (id < 0) {
+                id = profiler.add_(line, column);
+            }
+            profiler.stack_.push_back({id, Clock::now()});
+        }
+
+        Scope(const Scope &) = delete;
+
+        Scope &operator=(const Scope &) = delete;
+
+        ~Scope() {
+            profiler_.leave_(Clock::now());
+        }
+
+    private:
+        Profiler &profiler_;
+    };
+
+    // runs of the statements starting on the line
+    uint64_t count(int line) const {
+        uint64_t count = 0;
+        for (const auto &entry : entries_) {
+            if (entry.line == line) {
+                count += entry.count;
+            }
+        }
+        return count;
+    }
+
+    // the source with runs and times of the statements on each line
+    void write_listing(std::ostream &out) {
+        finish_();
+        size_t last = lines_.size();
+        for (const auto &entry : entries_) {
+            last = std::max(last, static_cast<size_t>(entry.line));
+        }
+        std::vector<Line> lines(last + 1);
+        Clock::duration total(0);
+        for (const auto &entry : entries_) {
+            auto &line = lines[entry.line];
+            line.count += entry.count;
+            line.exclusive += entry.inclusive - entry.children;
+            if (entry.parent < 0 || entries_[entry.parent].line != entry.line) {
+                line.inclusive += entry.inclusive;
+            }
+            if (entry.parent < 0) {
+                total += entry.inclusive;
+            }
+        }
+        char buf[96];
+        out << "# " << name_ << ": " << ms_(total) << " ms\n";
+        out << "#  line        count     incl, ms     excl, ms  source\n";
+        for (size_t i = 1; i <= last; ++i) {
+            const auto &line = lines[i];
+            if (!line.count && lines_.empty()) {
+                continue;
+            }
+            const char *text = i <= lines_.size() ? lines_[i - 1].c_str() : "";
+            if (line.count) {
+                snprintf(buf, sizeof(buf), "%7zu %12llu %12s %12s  ", i,
+                         static_cast<unsigned long long>(line.count),
+                         ms_(line.inclusive).c_str(), ms_(line.exclusive).c_str());
+            } else {
+                snprintf(buf, sizeof(buf), "%7zu %12s %12s %12s  ", i, "", "", "");
+            }
+            out << buf << text << "\n";
+        }
+    }
+
+    // one line per stack: frames separated by ';' and the exclusive time
+    // in microseconds, the folded format of flamegraph.pl and speedscope
+    void write_folded(std::ostream &out) {
+        finish_();
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            auto exclusive = std::chrono::duration_cast<std::chrono::microseconds>(
+                    entries_[i].inclusive - entries_[i].children).count();
+            if (exclusive <= 0) {
+                continue;
+            }
+            out << stack_name_(static_cast<int>(i)) << " " << exclusive << "\n";
+        }
+    }
+
+    // writes <output>.prof and <output>.folded
+    bool write() {
+        std::ofstream listing(output_ + ".prof");
+        write_listing(listing);
+        std::ofstream folded(output_ + ".folded");
+        write_folded(folded);
+        return listing.good() && folded.good();
+    }
+
+private:
+    struct Entry {
+        int line;
+        int column;
+        int parent;
+        uint64_t count;
+        Clock::duration inclusive;
+        Clock::duration children;
+    };
+
+    struct Frame {
+        int id;
+        Clock::time_point start;
+    };
+
+    struct Line {
+        uint64_t count = 0;
+        Clock::duration inclusive = Clock::duration(0);
+        Clock::duration exclusive = Clock::duration(0);
+    };
+
+    std::string name_;
+    std::string output_;
+    std::vector<std::string> lines_;
+    std::vector<Entry> entries_;
+    std::vector<Frame> stack_;
+
+    int add_(int line, int column) {
+        int parent = stack_.empty() ? -1 : stack_.back().id;
+        entries_.push_back({line, column, parent, 0, Clock::duration(0),
+                            Clock::duration(0)});
+        return static_cast<int>(entries_.size()) - 1;
+    }
+
+    void leave_(Clock::time_point now) {
+        auto frame = stack_.back();
+        stack_.pop_back();
+        auto elapsed = now - frame.start;
+        auto &entry = entries_[frame.id];
+        ++entry.count;
+        entry.inclusive += elapsed;
+        if (!stack_.empty()) {
+            entries_[stack_.back().id].children += elapsed;
+        }
+    }
+
+    // statements still running when exit() is called end here
+    void finish_() {
+        auto now = Clock::now();
+        while (!stack_.empty()) {
+            leave_(now);
+        }
+    }
+
+    // the word the statement starts with and its position: for@3:5
+    std::string frame_name_(const Entry &entry) const {
+        std::string word;
+        if (entry.line > 0 && static_cast<size_t>(entry.line) <= lines_.size()) {
+            const auto &text = lines_[entry.line - 1];
+            for (size_t i = entry.column > 0 ? entry.column - 1 : 0;
+                 i < text.size() && (isalnum(static_cast<unsigned char>(text[i])) ||
+                                     text[i] == '_'); ++i) {
+                word += text[i];
+            }
+        }
+        if (word.empty()) {
+            word = "statement";
+        }
+        return word + "@" + std::to_string(entry.line) + ":" +
+               std::to_string(entry.column);
+    }
+
+    std::string stack_name_(int id) const {
+        std::string name = frame_name_(entries_[id]);
+        for (int i = entries_[id].parent; i >= 0; i = entries_[i].parent) {
+            name = frame_name_(entries_[i]) + ";" + name;
+        }
+        return name_ + ";" + name;
+    }
+
+    static std::string ms_(Clock::duration duration) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.3f",
+                 std::chrono::duration<double, std::milli>(duration).count());
+        return buf;
+    }
+};
+
+#endif //INTERPRETER_PROFILER_H
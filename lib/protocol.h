@@ -0,0 +1,247 @@
+#ifndef INTERPRETER_PROTOCOL_H
+#define INTERPRETER_PROTOCOL_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// The protocol of --serve, over a Unix domain socket or stdin/stdout. A
+// request names a script and carries its input:
+//
+//     run <input size> <script path>\n<input>
+//
+// and is answered with what the program wrote to stdout and to stderr
+// (syntax errors), the time it took and whether the script was compiled
+// by an earlier request:
+//
+//     ok <output size> <errors size> <microseconds> <cached>\n<output><errors>
+//     error <message size>\n<message>
+//
+// Sizes are in bytes. Any number of requests can be sent one after another,
+// they are answered in order. A request with more input than the server
+// takes is answered with an error and ends the stream.
+
+// input a server takes by default, see --max-input
+const uint64_t MAX_REQUEST_INPUT = 1 << 30;
+
+struct ServeRequest {
+    std::string script;
+    std::string input;
+};
+
+struct ServeResponse {
+    bool ok = false;
+    std::string output;
+    std::string errors; // the message if not ok
+    uint64_t microseconds = 0;
+    bool cached = false;
+};
+
+// buffered reads of a file descriptor
+class FdReader {
+public:
+    explicit FdReader(int fd) : fd_(fd) {}
+
+    FdReader(const FdReader &) = delete;
+
+    FdReader &operator=(const FdReader &) = delete;
+
+    // the next line without '\n', false at the end of input
+    bool read_line(std::string &line) {
+        line.clear();
+        while (true) {
+            if (pos_ == size_ && !fill_()) {
+                return false;
+            }
+            const char *start = buf_ + pos_;
+            auto newline = static_cast<const char *>(memchr(start, '\n', size_ - pos_));
+            if (newline) {
+                line.append(start, newline - start);
+                pos_ += newline - start + 1;
+                return true;
+            }
+            line.append(start, size_ - pos_);
+            pos_ = size_;
+        }
+    }
+
+    // size bytes; the size comes from the other side, so the storage grows
+    // with what has arrived rather than being taken at once
+    bool read(std::string &data, size_t size) {
+        data.clear();
+        data.reserve(size < SIZE ? size : SIZE);
+        while (data.size() < size) {
+            if (pos_ == size_ && !fill_()) {
+                return false;
+            }
+            size_t chunk = std::min(size - data.size(), size_ - pos_);
+            data.append(buf_ + pos_, chunk);
+            pos_ += chunk;
+        }
+        return true;
+    }
+
+private:
+    static const size_t SIZE = 1 << 16;
+
+    int fd_;
+    char buf_[SIZE];
+    size_t pos_ = 0;
+    size_t size_ = 0;
+
+    bool fill_() {
+        ssize_t len;
+        do {
+            len = ::read(fd_, buf_, SIZE);
+        } while (len < 0 && errno == EINTR);
+        if (len <= 0) {
+            return false;
+        }
+        pos_ = 0;
+        size_ = static_cast<size_t>(len);
+        return true;
+    }
+};
+
+inline bool write_all(int fd, const std::string &data) {
+    const char *pos = data.data();
+    size_t left = data.size();
+    while (left) {
+        ssize_t len = ::write(fd, pos, left);
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len <= 0) {
+            return false;
+        }
+        pos += len;
+        left -= len;
+    }
+    return true;
+}
+
+// the number at text, moved past it and one space after it
+inline bool parse_size(const char *&text, uint64_t &size) {
+    if (*text < '0' || *text > '9') {
+        return false;
+    }
+    char *end;
+    errno = 0;
+    size = strtoull(text, &end, 10);
+    if (errno) {
+        return false;
+    }
+    text = end;
+    if (*text == ' ') {
+        ++text;
+    }
+    return true;
+}
+
+inline std::string encode_request(const ServeRequest &request) {
+    return "run " + std::to_string(request.input.size()) + " " +
+           request.script + "\n" + request.input;
+}
+
+// false at the end of input, or with error set if the request is broken
+// or carries more than max_input bytes
+inline bool read_request(FdReader &reader, ServeRequest &request,
+                         std::string &error, uint64_t max_input = MAX_REQUEST_INPUT) {
+    std::string line;
+    error.clear();
+    if (!reader.read_line(line)) {
+        return false;
+    }
+    bool run = line.compare(0, 4, "run ") == 0;
+    const char *text = line.c_str() + (run ? 4 : 0);
+    uint64_t size;
+    if (!run || !parse_size(text, size) || !*text) {
+        error = "Bad request: " + line;
+        return false;
+    }
+    if (size > max_input) {
+        error = "Request input too big: " + std::to_string(size) + " bytes";
+        return false;
+    }
+    request.script = text;
+    if (!reader.read(request.input, size)) {
+        error = "Request input is cut off";
+        return false;
+    }
+    return true;
+}
+
+inline std::string encode_response(const ServeResponse &response) {
+    if (!response.ok) {
+        return "error " + std::to_string(response.errors.size()) + "\n" +
+               response.errors;
+    }
+    return "ok " + std::to_string(response.output.size()) + " " +
+           std::to_string(response.errors.size()) + " " +
+           std::to_string(response.microseconds) + " " +
+           (response.cached ? "1" : "0") + "\n" + response.output +
+           response.errors;
+}
+
+inline bool read_response(FdReader &reader, ServeResponse &response) {
+    std::string line;
+    if (!reader.read_line(line)) {
+        return false;
+    }
+    uint64_t size;
+    response = ServeResponse();
+    if (line.compare(0, 6, "error ") == 0) {
+        const char *text = line.c_str() + 6;
+        return parse_size(text, size) && reader.read(response.errors, size);
+    }
+    if (line.compare(0, 3, "ok ") != 0) {
+        return false;
+    }
+    const char *text = line.c_str() + 3;
+    uint64_t errors, cached;
+    if (!parse_size(text, size) ||
+        !parse_size(text, errors) || !parse_size(text, response.microseconds) ||
+        !parse_size(text, cached)) {
+        return false;
+    }
+    response.ok = true;
+    response.cached = cached != 0;
+    return reader.read(response.output, size) &&
+           reader.read(response.errors, errors);
+}
+
+// false if the path is too long for a socket address
+inline bool socket_address(const std::string &path, sockaddr_un &address) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// a connection to the server listening at path, -1 on failure
+inline int connect_socket(const std::string &path) {
+    sockaddr_un address;
+    if (!socket_address(path, address)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+#endif //INTERPRETER_PROTOCOL_H
@@ -0,0 +1,88 @@
+#ifndef INTERPRETER_RESOLVER_H
+#define INTERPRETER_RESOLVER_H
+
+#include <unordered_map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <machine.h>
+#include <enums.h>
+
+struct ResolvedVariable {
+    VariableSlot slot;
+    TypeIdentifyer type;
+};
+
+class Resolver {
+public:
+    Resolver() {
+        frames_.emplace_back();
+    }
+
+    void begin() {
+        declared_.clear();
+    }
+
+    // forgets global variables declared by a statement that failed to resolve
+    void rollback() {
+        while (frames_.size() > 1) {
+            leave_scope();
+        }
+        for (const auto &name : declared_) {
+            vars_.erase(name);
+        }
+        auto &global = frames_.back();
+        global.resize(global.size() - declared_.size());
+        declared_.clear();
+    }
+
+    void enter_scope() {
+        frames_.emplace_back();
+    }
+
+    // returns the number of slots the left frame needs
+    int leave_scope() {
+        if (frames_.size() == 1) {
+            throw std::underflow_error("No local level to leave");
+        }
+        for (const auto &name : frames_.back()) {
+            vars_.erase(name);
+        }
+        int size = static_cast<int>(frames_.back().size());
+        frames_.pop_back();
+        return size;
+    }
+
+    VariableSlot declare(const std::string &name, TypeIdentifyer type) {
+        if (vars_.find(name) != vars_.end()) {
+            throw std::invalid_argument("Redefinition of variable " + name);
+        }
+        VariableSlot slot = {static_cast<int>(frames_.size()) - 1,
+                             static_cast<int>(frames_.back().size())};
+        vars_[name] = {slot, type};
+        frames_.back().push_back(name);
+        if (frames_.size() == 1) {
+            declared_.push_back(name);
+        }
+        return slot;
+    }
+
+    const ResolvedVariable &lookup(const std::string &name) const {
+        auto it = vars_.find(name);
+        if (it == vars_.end()) {
+            throw std::invalid_argument("No variable " + name);
+        }
+        return it->second;
+    }
+
+    int globals() const {
+        return static_cast<int>(frames_.front().size());
+    }
+
+private:
+    std::unordered_map<std::string, ResolvedVariable> vars_;
+    std::vector<std::vector<std::string>> frames_;
+    std::vector<std::string> declared_;
+};
+
+#endif //INTERPRETER_RESOLVER_H
@@ -0,0 +1,161 @@
+#ifndef INTERPRETER_RUNTIME_H
+#define INTERPRETER_RUNTIME_H
+
+#include <climits>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <array.h>
+#include <bigint.h>
+#include <hash_map.h>
+#include <input.h>
+#include <output.h>
+#include <operations.h>
+
+// Runtime of the programs translated to C++ by --emit-c, see Transpiler.
+// Input, output and errors go through the interpreter's own buffers, so a
+// compiled program prints what the interpreter would, byte for byte.
+// Arrays are vectors indexed and summed by the functions of array.h, maps
+// are FlatMaps used through the functions of hash_map.h.
+
+// s * times, empty unless times is positive
+inline std::string repeat_string(const std::string &str, int times) {
+    std::string result;
+    if (times > 0) {
+        result.reserve(str.size() * times);
+    }
+    for (int i = 0; i < times; ++i) {
+        result += str;
+    }
+    return result;
+}
+
+// iterations of a loop from first to bound by step, which is negative if
+// the counter goes down; counted in 64 bits, so the counter can't wrap
+inline int64_t loop_iterations(int first, int bound, int step, bool inclusive) {
+    int64_t distance = step > 0 ? int64_t(bound) - first : int64_t(first) - bound;
+    int64_t magnitude = step > 0 ? step : -int64_t(step);
+    if (distance < (inclusive ? 0 : 1)) {
+        return 0;
+    }
+    return (distance - (inclusive ? 0 : 1)) / magnitude + 1;
+}
+
+class Runtime {
+public:
+    Runtime() : input_(std::cin), output_(std::cout) {
+        input_.tie(&output_);
+    }
+
+    Runtime(const Runtime &) = delete;
+
+    Runtime &operator=(const Runtime &) = delete;
+
+    // read_int()/read_ints()/read_long()/read_word()/read_line() read the file
+    bool open_input(const char *filename) {
+        if (!input_.open(filename)) {
+            std::cerr << "Can't open file " << filename << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    int read_int() {
+        return input_.read_int();
+    }
+
+    Long read_long() {
+        return input_.read_long();
+    }
+
+    std::vector<int> read_ints(int size) {
+        auto items = make_array<int>(size);
+        if (!items.empty()) {
+            input_.read_ints(items.data(), items.size());
+        }
+        return items;
+    }
+
+    std::vector<std::string> read_all_words() {
+        std::vector<std::string> words;
+        for (auto word = input_.read_word(); !word.empty(); word = input_.read_word()) {
+            words.push_back(std::move(word));
+        }
+        check_array_size(words.size());
+        return words;
+    }
+
+    std::string read_word() {
+        return input_.read_word();
+    }
+
+    std::string read_line() {
+        return input_.read_line();
+    }
+
+    void write(int val) {
+        output_.write_int(val);
+    }
+
+    void write(const Long &val) {
+        output_.write_long(val);
+    }
+
+    void write(const std::string &str) {
+        output_.write(str);
+    }
+
+    template <class T>
+    void write_line(const T &val) {
+        write(val);
+        output_.put('\n');
+    }
+
+    void exit() {
+        output_.flush();
+        throw Exit();
+    }
+
+    // runs a statement of the program; a runtime error is reported and the
+    // next statement runs, nothing runs after exit()
+    template <class Statement>
+    void run(Statement statement) {
+        if (exited_) {
+            return;
+        }
+        try {
+            statement();
+        } catch (std::exception &e) {
+            report(e.what());
+        } catch (Exit &) {
+            exited_ = true;
+        }
+    }
+
+    // the error of a statement that failed before the program was run
+    void report(const char *error) {
+        if (exited_) {
+            return;
+        }
+        output_.flush();
+        std::cout << "Error: " << error << "\n";
+    }
+
+    int finish() {
+        output_.flush();
+        return 0;
+    }
+
+private:
+    // not an std::exception, so the handlers of runtime errors let it pass
+    struct Exit {};
+
+    InputBuffer input_;
+    OutputBuffer output_;
+    bool exited_ = false;
+};
+
+#endif //INTERPRETER_RUNTIME_H
@@ -0,0 +1,362 @@
+#ifndef INTERPRETER_SERVER_H
+#define INTERPRETER_SERVER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <system_error>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <parser.h>
+#include <protocol.h>
+
+// Runs requests of --serve on the bytecode engine. Scripts are compiled
+// on the first request and kept until the file changes; every request runs
+// on a fresh Interpreter. Compiled scripts hold reference counted strings,
+// so a runner belongs to one thread.
+class ScriptRunner {
+public:
+    explicit ScriptRunner(int optimization) : optimization_(optimization) {}
+
+    ServeResponse run(const ServeRequest &request) {
+        auto start = std::chrono::steady_clock::now();
+        ServeResponse response;
+        const Script *script = load_(request.script, response);
+        if (!script) {
+            return response;
+        }
+        std::istringstream in(request.input);
+        std::ostringstream out;
+        {
+            Interpreter interpreter(in, out, out);
+            interpreter.run_compiled(script->program);
+            interpreter.output().flush();
+        }
+        response.ok = true;
+        response.output = out.str();
+        response.errors = script->errors;
+        response.microseconds = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        return response;
+    }
+
+private:
+    struct Script {
+        struct timespec modified;
+        off_t size;
+        CompiledProgram program;
+        std::string errors; // syntax errors, reported on every run
+    };
+
+    int optimization_;
+    std::unordered_map<std::string, Script> scripts_;
+
+    static struct timespec modified_(const struct stat &info) {
+#ifdef __APPLE__
+        return info.st_mtimespec;
+#else
+        return info.st_mtim;
+#endif
+    }
+
+    const Script *load_(const std::string &path, ServeResponse &response) {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) {
+            response.errors = "Can't open file " + path;
+            return nullptr;
+        }
+        auto modified = modified_(info);
+        auto it = scripts_.find(path);
+        if (it != scripts_.end() && it->second.size == info.st_size &&
+            it->second.modified.tv_sec == modified.tv_sec &&
+            it->second.modified.tv_nsec == modified.tv_nsec) {
+            response.cached = true;
+            return &it->second;
+        }
+        std::istringstream in;
+        std::ostringstream out, errors;
+        Interpreter interpreter(in, out, out);
+        interpreter.set_optimization(optimization_);
+        interpreter.set_whole_program(true);
+        ParserContext context(interpreter, errors);
+        if (!context.open_file(path.c_str())) {
+            response.errors = "Can't open file " + path;
+            return nullptr;
+        }
+        Script &script = scripts_[path];
+        {
+            ArenaScope nodes(interpreter.arena());
+            context.parse();
+            script.program = interpreter.compile_program();
+        }
+        script.modified = modified;
+        script.size = info.st_size;
+        script.errors = errors.str();
+        return &script;
+    }
+};
+
+// A pool of threads with a ScriptRunner each, answering requests over a
+// Unix domain socket or a pair of file descriptors. A request that fails,
+// with too much input or out of memory, is answered with an error; the
+// server goes on.
+class Server {
+public:
+    Server(size_t workers, int optimization, uint64_t max_input = MAX_REQUEST_INPUT) :
+            max_input_(max_input) {
+        for (size_t i = 0; i < workers; ++i) {
+            workers_.emplace_back([this, optimization]() {
+                ScriptRunner runner(optimization);
+                work_(runner);
+            });
+        }
+    }
+
+    Server(const Server &) = delete;
+
+    Server &operator=(const Server &) = delete;
+
+    // finishes the queued work first
+    ~Server() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        wake_.notify_all();
+        for (auto &worker : workers_) {
+            worker.join();
+        }
+    }
+
+    // answers the requests read from in to out until in is over; requests
+    // run in parallel, the responses are written in order
+    void serve(int in, int out) {
+        ignore_broken_pipes_();
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<std::future<std::string>> responses;
+        bool done = false;
+        std::thread writer([&]() {
+            while (true) {
+                std::future<std::string> response;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ready.wait(lock, [&]() { return done || !responses.empty(); });
+                    if (responses.empty()) {
+                        return;
+                    }
+                    response = std::move(responses.front());
+                    responses.pop_front();
+                }
+                write_all(out, response.get());
+            }
+        });
+        FdReader reader(in);
+        std::string error;
+        while (true) {
+            auto request = std::make_shared<ServeRequest>();
+            bool read;
+            try {
+                read = read_request(reader, *request, error, max_input_);
+            } catch (std::exception &e) {
+                read = false;
+                error = e.what();
+            }
+            if (!read && error.empty()) {
+                break;
+            }
+            auto response = std::make_shared<std::promise<std::string>>();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                responses.push_back(response->get_future());
+            }
+            ready.notify_one();
+            if (!read) {
+                // the stream can't be followed past a broken request
+                ServeResponse failure;
+                failure.errors = error;
+                response->set_value(encode_response(failure));
+                break;
+            }
+            submit_([request, response](ScriptRunner &runner) {
+                response->set_value(answer_(runner, *request));
+            });
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        ready.notify_one();
+        writer.join();
+    }
+
+    // accepts connections on the socket at path. Each connection has a
+    // thread of its own that reads the requests and writes the responses
+    // like serve(), while the requests run on the workers, so a client that
+    // keeps its connection idle holds no worker. Returns false on failure
+    // and true after stop(), once the open connections are closed. A socket
+    // left at path by a server that is gone is replaced.
+    bool listen(const std::string &path) {
+        ignore_broken_pipes_();
+        sockaddr_un address;
+        if (!socket_address(path, address)) {
+            return false;
+        }
+        struct stat info;
+        if (lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+            int live = connect_socket(path);
+            if (live >= 0) {
+                close(live);
+                return false;
+            }
+            unlink(path.c_str());
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return false;
+        }
+        if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+            ::listen(fd, SOMAXCONN) < 0) {
+            close(fd);
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex_);
+            if (stopping_) {
+                close(fd);
+                return true;
+            }
+            listening_ = fd;
+        }
+        while (true) {
+            int client = accept(fd, nullptr, nullptr);
+            if (client >= 0) {
+                open_connection_(client);
+                continue;
+            }
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            bool stopped;
+            {
+                std::lock_guard<std::mutex> lock(connections_mutex_);
+                stopped = stopping_;
+                listening_ = -1;
+            }
+            close(fd);
+            close_connections_();
+            return stopped;
+        }
+    }
+
+    // makes listen() return; safe from any thread
+    void stop() {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        stopping_ = true;
+        if (listening_ >= 0) {
+            shutdown(listening_, SHUT_RDWR);
+        }
+    }
+
+private:
+    typedef std::function<void(ScriptRunner &)> Task;
+
+    uint64_t max_input_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Task> tasks_;
+    bool stopped_ = false;
+
+    // the sockets of the open connections and the listening one, guarded
+    // by connections_mutex_
+    std::mutex connections_mutex_;
+    std::condition_variable connections_closed_;
+    std::unordered_set<int> connections_;
+    int listening_ = -1;
+    bool stopping_ = false;
+
+    // a client is turned away if there is no thread left for it
+    void open_connection_(int client) {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        try {
+            std::thread([this, client]() {
+                serve(client, client);
+                // closed under the lock, so close_connections_ never shuts
+                // down a descriptor that has been reused
+                std::lock_guard<std::mutex> lock(connections_mutex_);
+                connections_.erase(client);
+                close(client);
+                connections_closed_.notify_all();
+            }).detach();
+        } catch (std::system_error &) {
+            close(client);
+            return;
+        }
+        connections_.insert(client);
+    }
+
+    // ends the reads of the open connections and waits for their threads
+    void close_connections_() {
+        std::unique_lock<std::mutex> lock(connections_mutex_);
+        for (int client : connections_) {
+            shutdown(client, SHUT_RDWR);
+        }
+        connections_closed_.wait(lock, [this]() { return connections_.empty(); });
+    }
+
+    void submit_(Task task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        wake_.notify_one();
+    }
+
+    void work_(ScriptRunner &runner) {
+        while (true) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this]() { return stopped_ || !tasks_.empty(); });
+                if (tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task(runner);
+        }
+    }
+
+    // the encoded response; what a request throws is its error
+    static std::string answer_(ScriptRunner &runner, const ServeRequest &request) {
+        try {
+            return encode_response(runner.run(request));
+        } catch (std::exception &e) {
+            ServeResponse failure;
+            failure.errors = e.what();
+            return encode_response(failure);
+        }
+    }
+
+    // a client that goes away must not take the server down with it
+    static void ignore_broken_pipes_() {
+        signal(SIGPIPE, SIG_IGN);
+    }
+};
+
+#endif //INTERPRETER_SERVER_H
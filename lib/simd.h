@@ -0,0 +1,337 @@
+#ifndef INTERPRETER_SIMD_H
+#define INTERPRETER_SIMD_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define INTERPRETER_SIMD 1
+#else
+#define INTERPRETER_SIMD 0
+#endif
+
+// Bulk operations on ints. On x86-64 they run on SSE2, which every such
+// CPU has, or on AVX2 if the CPU has it, chosen on the first call; other
+// platforms get plain loops. Any of them can be asked for, for tests and
+// benchmarks, as long as supported() says the CPU runs it.
+class IntKernels {
+public:
+    enum class Isa {
+        SCALAR,
+        SSE2,
+        AVX2,
+    };
+
+    static Isa best() {
+        static const Isa isa = detect_();
+        return isa;
+    }
+
+    static bool supported(Isa isa) {
+        return static_cast<int>(isa) <= static_cast<int>(best());
+    }
+
+    static const char *name(Isa isa) {
+        switch (isa) {
+            case Isa::SSE2:
+                return "sse2";
+            case Isa::AVX2:
+                return "avx2";
+            default:
+                return "scalar";
+        }
+    }
+
+    // in 64 bits, so it can't overflow
+    static int64_t sum(const int *data, size_t size, Isa isa = best()) {
+#if INTERPRETER_SIMD
+        if (isa == Isa::AVX2) {
+            return sum_avx2_(data, size);
+        }
+        if (isa == Isa::SSE2) {
+            return sum_sse2_(data, size);
+        }
+#endif
+        return sum_scalar_(data, size, 0);
+    }
+
+    // the size must be positive
+    static int min(const int *data, size_t size, Isa isa = best()) {
+#if INTERPRETER_SIMD
+        if (isa == Isa::AVX2) {
+            return min_avx2_(data, size);
+        }
+        if (isa == Isa::SSE2) {
+            return extreme_sse2_<true>(data, size);
+        }
+#endif
+        return *std::min_element(data, data + size);
+    }
+
+    static int max(const int *data, size_t size, Isa isa = best()) {
+#if INTERPRETER_SIMD
+        if (isa == Isa::AVX2) {
+            return max_avx2_(data, size);
+        }
+        if (isa == Isa::SSE2) {
+            return extreme_sse2_<false>(data, size);
+        }
+#endif
+        return *std::max_element(data, data + size);
+    }
+
+    static size_t count(const int *data, size_t size, int val, Isa isa = best()) {
+#if INTERPRETER_SIMD
+        if (isa == Isa::AVX2) {
+            return count_avx2_(data, size, val);
+        }
+        if (isa == Isa::SSE2) {
+            return count_sse2_(data, size, val);
+        }
+#endif
+        return count_scalar_(data, size, val);
+    }
+
+    static void fill(int *data, size_t size, int val, Isa isa = best()) {
+#if INTERPRETER_SIMD
+        if (isa == Isa::AVX2) {
+            fill_avx2_(data, size, val);
+            return;
+        }
+        if (isa == Isa::SSE2) {
+            fill_sse2_(data, size, val);
+            return;
+        }
+#endif
+        std::fill(data, data + size, val);
+    }
+
+private:
+    // lane counters of count() are added up this often, so they can't wrap
+    static const size_t COUNT_BLOCK = size_t(1) << 24;
+
+    static Isa detect_() {
+#if INTERPRETER_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return Isa::AVX2;
+        }
+        return Isa::SSE2;
+#else
+        return Isa::SCALAR;
+#endif
+    }
+
+    static int64_t sum_scalar_(const int *data, size_t size, int64_t sum) {
+        for (size_t i = 0; i < size; ++i) {
+            sum += data[i];
+        }
+        return sum;
+    }
+
+    static size_t count_scalar_(const int *data, size_t size, int val) {
+        size_t count = 0;
+        for (size_t i = 0; i < size; ++i) {
+            count += data[i] == val;
+        }
+        return count;
+    }
+
+#if INTERPRETER_SIMD
+    static int64_t sum_sse2_(const int *data, size_t size) {
+        __m128i acc0 = _mm_setzero_si128();
+        __m128i acc1 = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            __m128i sign = _mm_srai_epi32(v, 31);
+            acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v, sign));
+            acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v, sign));
+        }
+        int64_t lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), _mm_add_epi64(acc0, acc1));
+        return sum_scalar_(data + i, size - i, lanes[0] + lanes[1]);
+    }
+
+    // SSE2 has no min and max of ints, the lanes are picked by a mask
+    template <bool Min>
+    static int extreme_sse2_(const int *data, size_t size) {
+        if (size < 4) {
+            return Min ? *std::min_element(data, data + size)
+                       : *std::max_element(data, data + size);
+        }
+        __m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        size_t i = 4;
+        for (; i + 4 <= size; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            __m128i take = Min ? _mm_cmplt_epi32(v, acc) : _mm_cmpgt_epi32(v, acc);
+            acc = _mm_or_si128(_mm_and_si128(take, v), _mm_andnot_si128(take, acc));
+        }
+        int lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc);
+        int result = lanes[0];
+        for (int lane : {lanes[1], lanes[2], lanes[3]}) {
+            result = Min ? std::min(result, lane) : std::max(result, lane);
+        }
+        for (; i < size; ++i) {
+            result = Min ? std::min(result, data[i]) : std::max(result, data[i]);
+        }
+        return result;
+    }
+
+    static size_t count_sse2_(const int *data, size_t size, int val) {
+        __m128i key = _mm_set1_epi32(val);
+        size_t count = 0;
+        size_t i = 0;
+        while (i + 4 <= size) {
+            size_t left = (size - i) / 4 * 4;
+            size_t end = i + (left < COUNT_BLOCK ? left : COUNT_BLOCK);
+            __m128i acc = _mm_setzero_si128();
+            for (; i < end; i += 4) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                acc = _mm_sub_epi32(acc, _mm_cmpeq_epi32(v, key));
+            }
+            uint32_t lanes[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc);
+            count += size_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+        }
+        return count + count_scalar_(data + i, size - i, val);
+    }
+
+    static void fill_sse2_(int *data, size_t size, int val) {
+        __m128i v = _mm_set1_epi32(val);
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), v);
+        }
+        std::fill(data + i, data + size, val);
+    }
+
+    __attribute__((target("avx2")))
+    static int64_t sum_avx2_(const int *data, size_t size) {
+        __m256i acc0 = _mm256_setzero_si256();
+        __m256i acc1 = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            acc0 = _mm256_add_epi64(acc0, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+            acc1 = _mm256_add_epi64(acc1, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+        }
+        int64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), _mm256_add_epi64(acc0, acc1));
+        return sum_scalar_(data + i, size - i, lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+    }
+
+    __attribute__((target("avx2")))
+    static int min_avx2_(const int *data, size_t size) {
+        if (size < 8) {
+            return *std::min_element(data, data + size);
+        }
+        __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+        size_t i = 8;
+        for (; i + 8 <= size; i += 8) {
+            acc = _mm256_min_epi32(acc, _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i *>(data + i)));
+        }
+        int lanes[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), acc);
+        int result = *std::min_element(lanes, lanes + 8);
+        return i < size ? std::min(result, *std::min_element(data + i, data + size)) : result;
+    }
+
+    __attribute__((target("avx2")))
+    static int max_avx2_(const int *data, size_t size) {
+        if (size < 8) {
+            return *std::max_element(data, data + size);
+        }
+        __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+        size_t i = 8;
+        for (; i + 8 <= size; i += 8) {
+            acc = _mm256_max_epi32(acc, _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i *>(data + i)));
+        }
+        int lanes[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), acc);
+        int result = *std::max_element(lanes, lanes + 8);
+        return i < size ? std::max(result, *std::max_element(data + i, data + size)) : result;
+    }
+
+    __attribute__((target("avx2")))
+    static size_t count_avx2_(const int *data, size_t size, int val) {
+        __m256i key = _mm256_set1_epi32(val);
+        size_t count = 0;
+        size_t i = 0;
+        while (i + 8 <= size) {
+            size_t left = (size - i) / 8 * 8;
+            size_t end = i + (left < COUNT_BLOCK ? left : COUNT_BLOCK);
+            __m256i acc = _mm256_setzero_si256();
+            for (; i < end; i += 8) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                acc = _mm256_sub_epi32(acc, _mm256_cmpeq_epi32(v, key));
+            }
+            uint32_t lanes[8];
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), acc);
+            for (uint32_t lane : lanes) {
+                count += lane;
+            }
+        }
+        return count + count_scalar_(data + i, size - i, val);
+    }
+
+    __attribute__((target("avx2")))
+    static void fill_avx2_(int *data, size_t size, int val) {
+        __m256i v = _mm256_set1_epi32(val);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(data + i), v);
+        }
+        std::fill(data + i, data + size, val);
+    }
+#endif
+};
+
+// Decimal numbers for InputBuffer::read_ints(): digits are told from other
+// bytes 16 at a time, then up to eight of them are converted at once in a
+// 64-bit word.
+class DigitKernels {
+public:
+    // leading digits of the 16 bytes at text, all of them readable
+    static int leading_digits(const char *text) {
+#if INTERPRETER_SIMD
+        __m128i v = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(text)),
+                                 _mm_set1_epi8('0'));
+        __m128i digits = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(9)), v);
+        return __builtin_ctz(~static_cast<unsigned>(_mm_movemask_epi8(digits)));
+#else
+        int count = 0;
+        while (count < 16 && static_cast<unsigned char>(text[count] - '0') < 10) {
+            ++count;
+        }
+        return count;
+#endif
+    }
+
+    // value of 1 to 8 digits at text, 8 bytes readable
+    static uint32_t parse_digits(const char *text, int count) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        uint64_t chunk;
+        memcpy(&chunk, text, sizeof(chunk));
+        // the first digit goes to the top, zeros come in below it
+        chunk <<= 8 * (8 - count);
+        chunk = ((chunk & 0x0F0F0F0F0F0F0F0FULL) * 2561) >> 8;
+        chunk = ((chunk & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+        return static_cast<uint32_t>(((chunk & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32);
+#else
+        uint32_t val = 0;
+        for (int i = 0; i < count; ++i) {
+            val = val * 10 + (text[i] - '0');
+        }
+        return val;
+#endif
+    }
+};
+
+#endif //INTERPRETER_SIMD_H
@@ -1,10 +1,29 @@
 #ifndef SYNTAX_TREE_H
 #define SYNTAX_TREE_H
 
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
 #include <iostream>
+#include <sstream>
 #include <vector>
 #include <memory>
+#include <type_traits>
+#include <stdexcept>
 #include <machine.h>
+#include <bytecode.h>
+#include <resolver.h>
+#include <type_checker.h>
+#include <optimizer.h>
+#include <arena.h>
+#include <profiler.h>
+#include <parallel.h>
+#include <jit.h>
+#include <transpiler.h>
+#include <runtime.h>
+#include <operations.h>
 #include <enums.h>
 
 class Node {
@@ -17,12 +36,99 @@ public:
 
     virtual ~Node() = default;
 
+    // nodes go to the current arena if there is one
+    static void *operator new(size_t size) {
+        return Arena::allocate(Arena::current(), size, &destroy_);
+    }
+
+    static void operator delete(void *ptr) {
+        Arena::deallocate(ptr);
+    }
+
+    // frees a child node; children owned by an arena are left to it
+    static void destroy(Node *node) {
+        if (node && !Arena::owner(node)) {
+            delete node;
+        }
+    }
+
+    // where the node starts in the source, 0 if it was built elsewhere
+    int line() const {
+        return line_;
+    }
+
+    int column() const {
+        return column_;
+    }
+
+    void set_position(int line, int column) {
+        line_ = line;
+        column_ = column;
+    }
+
     virtual void print(int depth, std::ostream &out) = 0;
 
     virtual void evaluate(Machine &machine) {};
 
+    // binds variables to frame slots before the node is executed
+    virtual void resolve(Resolver &resolver) {}
+
+    // checks operand types, returns the node to execute in place of this one
+    virtual Node *check(TypeChecker &checker) {
+        return this;
+    }
+
+    // returns a simplified node to execute in place of this one
+    virtual Node *optimize(Optimizer &optimizer) {
+        return this;
+    }
+
+    // same for a node run as a statement, nullptr if nothing is left to run
+    virtual Node *prune(Optimizer &optimizer) {
+        return this;
+    }
+
+    // adds slots of the variables the node may assign
+    virtual void collect_assigned(std::vector<VariableSlot> &assigned) {}
+
+    // emits bytecode and returns the register holding the result
+    virtual int compile(Compiler &compiler) {
+        throw std::logic_error("Node can't be compiled");
+    }
+
+    // emits machine code, false if the node can't be compiled to it
+    virtual bool jit(JitCompiler &jit) {
+        return false;
+    }
+
+    // returns the node to execute in place of this one, with the loops
+    // that compile to machine code replaced
+    virtual Node *native(JitCompiler &jit) {
+        return this;
+    }
+
+    // writes the node as C++ and returns the expression of its value, empty
+    // if it has none
+    virtual std::string transpile(Transpiler &transpiler) {
+        throw std::logic_error("Node can't be transpiled");
+    }
+
+protected:
+    // counted in the machine's metrics by the class of the node whose
+    // evaluation it is, passed as this
+    template <class T>
+    static void count_evaluation_(Machine &machine, const T *) {
+        INTERPRETER_METRIC(machine.metrics().count(NodeKinds::id<T>()));
+    }
+
 private:
     const NodeType type_;
+    int line_ = 0;
+    int column_ = 0;
+
+    static void destroy_(void *node) {
+        static_cast<Node *>(node)->~Node();
+    }
 };
 
 class ExpressionNode : public Node {
@@ -30,12 +136,96 @@ public:
     explicit ExpressionNode(NodeType type = NodeType::EMPTY) :
             Node(type) {}
 
+    TypeIdentifyer value_type() const {
+        return value_type_;
+    }
+
+    // false for nodes that leave nothing on the operand stack
+    virtual bool has_value() const {
+        return true;
+    }
+
     void print(int depth, std::ostream &out) override {}
 
+    ExpressionNode *check(TypeChecker &checker) override {
+        return this;
+    }
+
+    ExpressionNode *optimize(Optimizer &optimizer) override {
+        return this;
+    }
+
+    // true if the value can't change while none of the assigned variables
+    // does, and computing it has no effects and can't fail
+    virtual bool loop_invariant(const std::vector<VariableSlot> &assigned) const {
+        return false;
+    }
+
+    // a statement with nothing but a constant or a variable does nothing
+    Node *prune(Optimizer &optimizer) override {
+        if (nodeType() == NodeType::EMPTY ||
+            nodeType() == NodeType::CONSTANT ||
+            nodeType() == NodeType::VARIABLE) {
+            return nullptr;
+        }
+        return this;
+    }
+
     void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
         machine.push(TypeIdentifyer::INT_T);
         machine.top() = true;
     }
+
+    // evaluates an int expression without going through the operand stack
+    virtual int eval_int(Machine &machine) {
+        evaluate(machine);
+        auto &val = machine.top();
+        if (val.type() != TypeIdentifyer::INT_T) {
+            throw std::invalid_argument(NOT_BOOL_INT);
+        }
+        int val_v = *val;
+        machine.pop();
+        return val_v;
+    }
+
+    // same for a long expression
+    virtual Long eval_long(Machine &machine) {
+        evaluate(machine);
+        Long val = machine.top().get_long();
+        machine.pop();
+        return val;
+    }
+
+    int compile(Compiler &compiler) override {
+        int reg = compiler.temp();
+        compiler.emit(OpCode::LOAD_INT, reg, true);
+        return reg;
+    }
+
+    bool jit(JitCompiler &jit) override {
+        if (nodeType() != NodeType::EMPTY) {
+            return false;
+        }
+        jit.load_int(true);
+        return true;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        return "1";
+    }
+
+    // emits a jump to otherwise taken if the value is 0
+    virtual bool jit_branch(JitCompiler &jit, JitCompiler::Label &otherwise) {
+        if (!this->jit(jit)) {
+            return false;
+        }
+        jit.jump_if_zero(otherwise);
+        return true;
+    }
+
+protected:
+    TypeIdentifyer value_type_ = TypeIdentifyer::INT_T;
 };
 
 class CmdNode : public Node {
@@ -44,16 +234,20 @@ public:
             Node(NodeType::COMMAND), cmd_(cmd) {}
 
     ~CmdNode() override {
-        delete cmd_;
+        destroy(cmd_);
     }
 
     void setSimple() {
         simple_ = true;
     }
 
+    bool empty() const {
+        return !cmd_;
+    }
+
     void print(int depth, std::ostream &out) override {
         auto tab = std::string(depth, '\t');
-        if (cmd_->nodeType() == NodeType::EMPTY) {
+        if (!cmd_ || cmd_->nodeType() == NodeType::EMPTY) {
             return;
         }
         if (cmd_->nodeType() == NodeType::COMMAND_LIST) {
@@ -69,23 +263,144 @@ public:
         }
     }
 
+    void resolve(Resolver &resolver) override {
+        if (cmd_) {
+            if (!simple_) {
+                resolver.enter_scope();
+            }
+            cmd_->resolve(resolver);
+            if (!simple_) {
+                frame_size_ = resolver.leave_scope();
+            }
+        }
+    }
+
+    CmdNode *check(TypeChecker &checker) override {
+        if (cmd_) {
+            checker.check(cmd_);
+        }
+        if (Profiler::current() && cmd_ && cmd_->nodeType() != NodeType::COMMAND_LIST) {
+            return profiled_();
+        }
+        return this;
+    }
+
+    CmdNode *optimize(Optimizer &optimizer) override {
+        if (cmd_) {
+            optimizer.optimize(cmd_);
+            optimizer.prune(cmd_);
+        }
+        return this;
+    }
+
+    Node *prune(Optimizer &optimizer) override {
+        return cmd_ ? this : nullptr;
+    }
+
+    void collect_assigned(std::vector<VariableSlot> &assigned) override {
+        if (cmd_) {
+            cmd_->collect_assigned(assigned);
+        }
+    }
+
     void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
         if (cmd_) {
             if (!simple_) {
-                machine.enter_local_level();
+                machine.enter_frame(frame_size_);
             }
             cmd_->evaluate(machine);
             if (!simple_) {
-                machine.leave_local_level();
+                machine.leave_frame();
             }
         }
     }
 
-private:
+    int compile(Compiler &compiler) override {
+        if (cmd_) {
+            int mark = compiler.temps();
+            if (!simple_) {
+                compiler.enter_scope(frame_size_);
+            }
+            cmd_->compile(compiler);
+            if (!simple_) {
+                compiler.leave_scope();
+            }
+            compiler.free_temps(mark);
+        }
+        return Compiler::NO_REG;
+    }
+
+    // the variables of the block are the loop's, no frame is entered
+    bool jit(JitCompiler &jit) override {
+        return !cmd_ || cmd_->jit(jit);
+    }
+
+    CmdNode *native(JitCompiler &jit) override {
+        if (cmd_) {
+            jit.native(cmd_);
+        }
+        return this;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        if (cmd_) {
+            if (!simple_) {
+                transpiler.enter_scope();
+            }
+            cmd_->transpile(transpiler);
+            if (!simple_) {
+                transpiler.leave_scope();
+            }
+        }
+        return std::string();
+    }
+
+protected:
     Node *cmd_;
     bool simple_ = false;
+    int frame_size_ = 0;
+
+private:
+    CmdNode *profiled_();
+};
+
+// a statement timed by the profiler; while a profiler is current, check()
+// puts it in place of every CmdNode but blocks, which are only timed
+// through the statements in them, so nothing is timed otherwise
+class ProfiledCmdNode : public CmdNode {
+public:
+    ProfiledCmdNode(Profiler &profiler, Node *cmd, bool simple, int frame_size) :
+            CmdNode(cmd), profiler_(profiler) {
+        simple_ = simple;
+        frame_size_ = frame_size;
+    }
+
+    CmdNode *check(TypeChecker &checker) override {
+        if (cmd_) {
+            checker.check(cmd_);
+        }
+        return this;
+    }
+
+    void evaluate(Machine &machine) override {
+        Profiler::Scope scope(profiler_, profile_id_, line(), column());
+        CmdNode::evaluate(machine);
+    }
+
+private:
+    Profiler &profiler_;
+    int profile_id_ = -1;
 };
 
+inline CmdNode *CmdNode::profiled_() {
+    auto profiled = new ProfiledCmdNode(*Profiler::current(), cmd_, simple_,
+                                        frame_size_);
+    profiled->set_position(line(), column());
+    cmd_ = nullptr;
+    return profiled;
+}
+
 class CmdListNode : public Node {
 public:
     CmdListNode() : Node(NodeType::COMMAND_LIST) {}
@@ -100,7 +415,7 @@ public:
 
     ~CmdListNode() override {
         for (auto cmd : cmds_) {
-            delete cmd;
+            destroy(cmd);
         }
     }
 
@@ -110,12 +425,80 @@ public:
         }
     }
 
+    void resolve(Resolver &resolver) override {
+        for (auto cmd : cmds_) {
+            cmd->resolve(resolver);
+        }
+    }
+
+    CmdListNode *check(TypeChecker &checker) override {
+        for (auto &cmd : cmds_) {
+            checker.check(cmd);
+        }
+        return this;
+    }
+
+    CmdListNode *optimize(Optimizer &optimizer) override {
+        size_t kept = 0;
+        for (auto cmd : cmds_) {
+            optimizer.optimize(cmd);
+            if (cmd->empty()) {
+                destroy(cmd);
+            } else {
+                cmds_[kept++] = cmd;
+            }
+        }
+        cmds_.resize(kept);
+        return this;
+    }
+
+    Node *prune(Optimizer &optimizer) override {
+        return cmds_.empty() ? nullptr : this;
+    }
+
+    void collect_assigned(std::vector<VariableSlot> &assigned) override {
+        for (auto cmd : cmds_) {
+            cmd->collect_assigned(assigned);
+        }
+    }
+
     void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
         for (auto cmd : cmds_) {
             cmd->evaluate(machine);
         }
     }
 
+    int compile(Compiler &compiler) override {
+        for (auto cmd : cmds_) {
+            cmd->compile(compiler);
+        }
+        return Compiler::NO_REG;
+    }
+
+    bool jit(JitCompiler &jit) override {
+        for (auto cmd : cmds_) {
+            if (!cmd->jit(jit)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    CmdListNode *native(JitCompiler &jit) override {
+        for (auto &cmd : cmds_) {
+            jit.native(cmd);
+        }
+        return this;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        for (auto cmd : cmds_) {
+            cmd->transpile(transpiler);
+        }
+        return std::string();
+    }
+
 private:
     std::vector<CmdNode *> cmds_;
 };
@@ -135,6 +518,26 @@ public:
                 out << "string";
                 break;
             }
+            case (TypeIdentifyer::LONG_T): {
+                out << "long";
+                break;
+            }
+            case (TypeIdentifyer::INT_ARRAY_T): {
+                out << "int[]";
+                break;
+            }
+            case (TypeIdentifyer::STRING_ARRAY_T): {
+                out << "string[]";
+                break;
+            }
+            case (TypeIdentifyer::INT_MAP_T): {
+                out << "map<int,int>";
+                break;
+            }
+            case (TypeIdentifyer::STRING_MAP_T): {
+                out << "map<string,int>";
+                break;
+            }
         }
     }
 
@@ -148,12 +551,9 @@ private:
 
 class ValueNode : public ExpressionNode {
 public:
-    ValueNode(std::string value, TypeNode *type_n) :
-            ExpressionNode(NodeType::CONSTANT),
-            value_(std::move(value)), type_n_(type_n) {}
-
-    ~ValueNode() override {
-        delete type_n_;
+    ValueNode(std::string value, TypeIdentifyer type) :
+            ExpressionNode(NodeType::CONSTANT), value_(std::move(value)) {
+        value_type_ = type;
     }
 
     void print(int depth, std::ostream &out) override {
@@ -161,14 +561,17 @@ public:
     }
 
     void evaluate(Machine &machine) override {
-        machine.push(type_n_->type());
-        machine.top().pval() = std::make_shared<std::string>(value_);
+        count_evaluation_(machine, this);
+        machine.push(value_type_);
+        machine.top().load_str(value_);
+    }
+
+    bool loop_invariant(const std::vector<VariableSlot> &assigned) const override {
+        return true;
     }
 
 protected:
     std::string value_;
-private:
-    TypeNode *type_n_;
 };
 
 class IntValueNode : public ValueNode {
@@ -178,15 +581,40 @@ public:
     }
 
     explicit IntValueNode(const std::string &value) :
-            ValueNode(value, new TypeNode(TypeIdentifyer::INT_T)) {
+            ValueNode(value, TypeIdentifyer::INT_T) {
         int_value_ = strtol(value.c_str(), nullptr, 10);
     }
 
+    explicit IntValueNode(int value) :
+            ValueNode(std::to_string(value), TypeIdentifyer::INT_T),
+            int_value_(value) {}
+
     void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
         machine.push(TypeIdentifyer::INT_T);
         machine.top() = int_value_;
     }
 
+    int eval_int(Machine &machine) override {
+        count_evaluation_(machine, this);
+        return int_value_;
+    }
+
+    int compile(Compiler &compiler) override {
+        int reg = compiler.temp();
+        compiler.emit(OpCode::LOAD_INT, reg, int_value_);
+        return reg;
+    }
+
+    bool jit(JitCompiler &jit) override {
+        jit.load_int(int_value_);
+        return true;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        return Transpiler::literal(int_value_);
+    }
+
 private:
     int int_value_;
 };
@@ -198,777 +626,4608 @@ public:
     }
 
     explicit StringValueNode(const std::string &value) :
-            ValueNode(value, new TypeNode(TypeIdentifyer::STRING_T)) {}
+            ValueNode(value, TypeIdentifyer::STRING_T),
+            constant_(Value::interned(value)) {}
 
-    void evaluate(Machine &machine) override {
-        machine.push(TypeIdentifyer::STRING_T);
-        machine.top().load_str(value_);
+    void print(int depth, std::ostream &out) override {
+        out << '"' << value_ << '"';
     }
-};
-
-
-class VariableNode : public ExpressionNode {
-public:
-    explicit VariableNode(std::string name) :
-            ExpressionNode(NodeType::VARIABLE), name_(std::move(name)) {}
 
-    std::string name() {
-        return name_;
+    // evaluates to the interned value, no string is copied
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        machine.push(constant_);
     }
 
-    void print(int depth, std::ostream &out) override {
-        out << name_;
+    int compile(Compiler &compiler) override {
+        int reg = compiler.temp();
+        compiler.emit(OpCode::LOAD_STR, reg, compiler.constant(value_));
+        return reg;
     }
 
-    void evaluate(Machine &machine) override {
-        machine.push(machine.get(name_));
+    std::string transpile(Transpiler &transpiler) override {
+        return Transpiler::literal(value_);
     }
 
 private:
-    std::string name_;
+    Value constant_;
 };
 
-class OperatorNode : public ExpressionNode {
+class LongValueNode : public ValueNode {
 public:
-    explicit OperatorNode(std::string oper = "") :
-            ExpressionNode(NodeType::OPERATOR), oper_(std::move(oper)) {}
-
-    void print(int depth, std::ostream &out) override {
-        out << oper_;
+    const Long &value() const {
+        return long_value_;
     }
 
-private:
-    std::string oper_;
-};
+    explicit LongValueNode(Long value) :
+            ValueNode(value.to_string(), TypeIdentifyer::LONG_T),
+            long_value_(std::move(value)) {}
 
-class BinaryOperator : public OperatorNode {
-public:
-    BinaryOperator(ExpressionNode *left, ExpressionNode *right,
-                   const std::string &oper = "") :
-            OperatorNode(oper), left_(left), right_(right) {}
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        machine.push(TypeIdentifyer::LONG_T);
+        machine.top().load_long(long_value_);
+    }
 
-    ~BinaryOperator() override {
-        delete left_;
-        delete right_;
+    Long eval_long(Machine &machine) override {
+        count_evaluation_(machine, this);
+        return long_value_;
     }
 
-    void print(int depth, std::ostream &out) override {
-        left_->print(depth, out);
-        out << " ";
-        OperatorNode::print(depth, out);
-        out << " ";
-        right_->print(depth, out);
+    int compile(Compiler &compiler) override {
+        int reg = compiler.temp();
+        compiler.emit(OpCode::LOAD_LONG, reg, compiler.constant(long_value_));
+        return reg;
     }
 
-    void evaluate(Machine &machine) override {
-        left_->evaluate(machine);
-        right_->evaluate(machine);
+    std::string transpile(Transpiler &transpiler) override {
+        return Transpiler::literal(long_value_);
     }
 
 private:
-    ExpressionNode *left_;
-    ExpressionNode *right_;
+    Long long_value_;
 };
 
-class UnaryOperator : public OperatorNode {
-public:
-    explicit UnaryOperator(ExpressionNode *arg, const std::string &oper = "") :
-            OperatorNode(oper), arg_(arg) {}
+// a number too big for an int is a long
+inline ValueNode *number_constant(const std::string &digits) {
+    Long value = Long::parse(digits);
+    if (value.is_small() && value.small() <= INT_MAX) {
+        return new IntValueNode(digits);
+    }
+    return new LongValueNode(value);
+}
 
-    ~UnaryOperator() override {
-        delete arg_;
+inline IntValueNode *int_constant(ExpressionNode *node) {
+    if (node->nodeType() == NodeType::CONSTANT &&
+        node->value_type() == TypeIdentifyer::INT_T) {
+        return static_cast<IntValueNode *>(node);
     }
+    return nullptr;
+}
 
-    void print(int depth, std::ostream &out) override {
-        OperatorNode::print(depth, out);
-        arg_->print(depth, out);
+inline LongValueNode *long_constant(ExpressionNode *node) {
+    if (node->nodeType() == NodeType::CONSTANT &&
+        node->value_type() == TypeIdentifyer::LONG_T) {
+        return static_cast<LongValueNode *>(node);
     }
+    return nullptr;
+}
 
-    void evaluate(Machine &machine) override {
-        arg_->evaluate(machine);
+inline StringValueNode *string_constant(ExpressionNode *node) {
+    if (node->nodeType() == NodeType::CONSTANT &&
+        node->value_type() == TypeIdentifyer::STRING_T) {
+        return static_cast<StringValueNode *>(node);
     }
+    return nullptr;
+}
 
-private:
-    ExpressionNode *arg_;
-};
+// evaluating the node has no effects and can't fail
+inline bool is_pure(ExpressionNode *node) {
+    return node->nodeType() == NodeType::CONSTANT ||
+           node->nodeType() == NodeType::VARIABLE;
+}
 
-class NotOperator : public UnaryOperator {
+class VariableNode : public ExpressionNode {
 public:
-    explicit NotOperator(ExpressionNode *arg) :
-            UnaryOperator(arg, "!") {}
-
+    explicit VariableNode(std::string name) :
+            ExpressionNode(NodeType::VARIABLE), name_(std::move(name)) {}
+
+    std::string name() {
+        return name_;
+    }
+
+    VariableSlot slot() const {
+        return slot_;
+    }
+
+    void print(int depth, std::ostream &out) override {
+        out << name_;
+    }
+
+    void declare(Resolver &resolver, TypeIdentifyer type) {
+        slot_ = resolver.declare(name_, type);
+        value_type_ = type;
+    }
+
+    void resolve(Resolver &resolver) override {
+        const auto &var = resolver.lookup(name_);
+        slot_ = var.slot;
+        value_type_ = var.type;
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        machine.push(machine.slot(slot_));
+    }
+
+    int eval_int(Machine &machine) override {
+        count_evaluation_(machine, this);
+        return machine.slot(slot_).get_int();
+    }
+
+    Long eval_long(Machine &machine) override {
+        count_evaluation_(machine, this);
+        return machine.slot(slot_).get_long();
+    }
+
+    int compile(Compiler &compiler) override {
+        return compiler.variable(slot_);
+    }
+
+    bool jit(JitCompiler &jit) override {
+        if (value_type_ != TypeIdentifyer::INT_T) {
+            return false;
+        }
+        jit.load(slot_);
+        return true;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        return transpiler.variable(name_, slot_);
+    }
+
+    bool same(const VariableNode &other) const {
+        return slot_ == other.slot_;
+    }
+
+    bool loop_invariant(const std::vector<VariableSlot> &assigned) const override {
+        for (auto slot : assigned) {
+            if (slot == slot_) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    std::string name_;
+    VariableSlot slot_ = {0, 0};
+};
+
+// int expression computed once on entry to a loop, see LoopOperatorNode
+class HoistedNode : public ExpressionNode {
+public:
+    explicit HoistedNode(ExpressionNode *expression) :
+            ExpressionNode(NodeType::OPERATOR), expression_(expression) {}
+
+    ~HoistedNode() override {
+        destroy(expression_);
+    }
+
+    void print(int depth, std::ostream &out) override {
+        out << "(";
+        expression_->print(depth, out);
+        out << ")";
+    }
+
+    bool loop_invariant(const std::vector<VariableSlot> &assigned) const override {
+        return true;
+    }
+
+    void update(Machine &machine) {
+        value_ = expression_->eval_int(machine);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        machine.push(TypeIdentifyer::INT_T);
+        *machine.top() = value_;
+    }
+
+    int eval_int(Machine &machine) override {
+        count_evaluation_(machine, this);
+        return value_;
+    }
+
+    // the register stays reserved by the loop while it runs
+    void compile_value(Compiler &compiler) {
+        reg_ = expression_->compile(compiler);
+    }
+
+    int compile(Compiler &compiler) override {
+        return reg_;
+    }
+
+    // the value is kept by the compiled loop for the node
+    bool jit_value(JitCompiler &jit) {
+        if (!expression_->jit(jit)) {
+            return false;
+        }
+        jit.store_temporary(this);
+        return true;
+    }
+
+    bool jit(JitCompiler &jit) override {
+        jit.load_temporary(this);
+        return true;
+    }
+
+    void transpile_value(Transpiler &transpiler) {
+        name_ = transpiler.temporary(TypeIdentifyer::INT_T,
+                                     expression_->transpile(transpiler));
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        return name_;
+    }
+
+private:
+    ExpressionNode *expression_;
+    int value_ = 0;
+    int reg_ = Compiler::NO_REG;
+    std::string name_;
+};
+
+inline void Optimizer::hoist_(ExpressionNode *&node) {
+    if (loops_.empty() || parallel_ || node->nodeType() != NodeType::OPERATOR ||
+        node->value_type() != TypeIdentifyer::INT_T ||
+        dynamic_cast<HoistedNode *>(node) ||
+        !node->loop_invariant(*loops_.back().assigned)) {
+        return;
+    }
+    auto hoisted = new HoistedNode(node);
+    loops_.back().hoisted->push_back(hoisted);
+    node = hoisted;
+}
+
+// the node as a long, an int is converted
+inline ExpressionNode *widen(ExpressionNode *node);
+
+class OperatorNode : public ExpressionNode {
+public:
+    explicit OperatorNode(std::string oper = "") :
+            ExpressionNode(NodeType::OPERATOR), oper_(std::move(oper)) {}
+
+    void print(int depth, std::ostream &out) override {
+        out << oper_;
+    }
+
+private:
+    std::string oper_;
+};
+
+class BinaryOperator : public OperatorNode {
+public:
+    BinaryOperator(ExpressionNode *left, ExpressionNode *right,
+                   const std::string &oper = "") :
+            OperatorNode(oper), left_(left), right_(right) {}
+
+    ~BinaryOperator() override {
+        destroy(left_);
+        destroy(right_);
+    }
+
+    void print(int depth, std::ostream &out) override {
+        print_operand(left_, depth, out);
+        out << " ";
+        OperatorNode::print(depth, out);
+        out << " ";
+        print_operand(right_, depth, out);
+    }
+
+    void resolve(Resolver &resolver) override {
+        left_->resolve(resolver);
+        right_->resolve(resolver);
+    }
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        checker.check_value(left_);
+        checker.check_value(right_);
+        return this;
+    }
+
+    ExpressionNode *optimize(Optimizer &optimizer) override {
+        optimizer.optimize(left_);
+        optimizer.optimize(right_);
+        return this;
+    }
+
+    ExpressionNode *left() const {
+        return left_;
+    }
+
+    ExpressionNode *right() const {
+        return right_;
+    }
+
+    ExpressionNode *take_left() {
+        auto node = left_;
+        left_ = nullptr;
+        return node;
+    }
+
+    ExpressionNode *take_right() {
+        auto node = right_;
+        right_ = nullptr;
+        return node;
+    }
+
+    static void print_operand(ExpressionNode *node, int depth,
+                              std::ostream &out) {
+        bool nested = dynamic_cast<BinaryOperator *>(node) != nullptr;
+        if (nested) {
+            out << "(";
+        }
+        node->print(depth, out);
+        if (nested) {
+            out << ")";
+        }
+    }
+
+    void evaluate(Machine &machine) override {
+        left_->evaluate(machine);
+        right_->evaluate(machine);
+    }
+
+protected:
+    int compile(Compiler &compiler, OpCode op) {
+        int mark = compiler.temps();
+        int left = left_->compile(compiler);
+        int right = right_->compile(compiler);
+        compiler.free_temps(mark);
+        int reg = compiler.temp();
+        compiler.emit(op, reg, left, right);
+        return reg;
+    }
+
+    // the left operand to eax, the right one to ecx
+    bool jit_operands(JitCompiler &jit) {
+        if (auto constant = int_constant(right_)) {
+            if (!left_->jit(jit)) {
+                return false;
+            }
+            jit.operand_int(constant->value());
+            return true;
+        }
+        if (right_->nodeType() == NodeType::VARIABLE &&
+            right_->value_type() == TypeIdentifyer::INT_T) {
+            if (!left_->jit(jit)) {
+                return false;
+            }
+            jit.operand(static_cast<VariableNode *>(right_)->slot());
+            return true;
+        }
+        if (!right_->jit(jit)) {
+            return false;
+        }
+        jit.push();
+        if (!left_->jit(jit)) {
+            return false;
+        }
+        jit.pop_operand();
+        return true;
+    }
+
+    // (left op right), the operands are transpiled left to right
+    std::string transpile_infix(Transpiler &transpiler, const std::string &op) {
+        auto left = left_->transpile(transpiler);
+        auto right = right_->transpile(transpiler);
+        return "(" + left + " " + op + " " + right + ")";
+    }
+
+    bool operands_are(TypeIdentifyer left, TypeIdentifyer right) const {
+        return left_->value_type() == left && right_->value_type() == right;
+    }
+
+    // a long and an int or another long
+    bool long_operands() const {
+        return operands_are(TypeIdentifyer::LONG_T, TypeIdentifyer::LONG_T) ||
+               operands_are(TypeIdentifyer::LONG_T, TypeIdentifyer::INT_T) ||
+               operands_are(TypeIdentifyer::INT_T, TypeIdentifyer::LONG_T);
+    }
+
+    // hands the operands over to a specialized node
+    template <class T>
+    T *specialize() {
+        auto node = new T(left_, right_);
+        left_ = nullptr;
+        right_ = nullptr;
+        return node;
+    }
+
+    // same for a long operation, an int operand is widened
+    template <class T>
+    T *specialize_long() {
+        left_ = widen(left_);
+        right_ = widen(right_);
+        return specialize<T>();
+    }
+
+    bool same_operands() const {
+        return left_->nodeType() == NodeType::VARIABLE &&
+               right_->nodeType() == NodeType::VARIABLE &&
+               static_cast<VariableNode *>(left_)->same(
+                       *static_cast<VariableNode *>(right_));
+    }
+
+    ExpressionNode *left_;
+    ExpressionNode *right_;
+};
+
+class UnaryOperator : public OperatorNode {
+public:
+    explicit UnaryOperator(ExpressionNode *arg, const std::string &oper = "") :
+            OperatorNode(oper), arg_(arg) {}
+
+    ~UnaryOperator() override {
+        destroy(arg_);
+    }
+
+    void print(int depth, std::ostream &out) override {
+        OperatorNode::print(depth, out);
+        bool nested = dynamic_cast<BinaryOperator *>(arg_) ||
+                      dynamic_cast<UnaryOperator *>(arg_);
+        out << (nested ? "(" : "");
+        arg_->print(depth, out);
+        out << (nested ? ")" : "");
+    }
+
+    void resolve(Resolver &resolver) override {
+        arg_->resolve(resolver);
+    }
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        checker.check_value(arg_);
+        return this;
+    }
+
+    ExpressionNode *optimize(Optimizer &optimizer) override {
+        optimizer.optimize(arg_);
+        return this;
+    }
+
+    void evaluate(Machine &machine) override {
+        arg_->evaluate(machine);
+    }
+
+protected:
+    int compile(Compiler &compiler, OpCode op) {
+        int mark = compiler.temps();
+        int arg = arg_->compile(compiler);
+        compiler.free_temps(mark);
+        int reg = compiler.temp();
+        compiler.emit(op, reg, arg);
+        return reg;
+    }
+
+    template <class T>
+    T *specialize() {
+        auto node = new T(arg_);
+        arg_ = nullptr;
+        return node;
+    }
+
+    ExpressionNode *arg_;
+};
+
+template <class Op>
+class IntBinaryOperator : public BinaryOperator {
+public:
+    IntBinaryOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, Op::name()) {}
+
+    // eval_int counts the evaluation
+    void evaluate(Machine &machine) override {
+        int result = eval_int(machine);
+        machine.push(TypeIdentifyer::INT_T);
+        *machine.top() = result;
+    }
+
+    int eval_int(Machine &machine) override {
+        count_evaluation_(machine, this);
+        int fval = left_->eval_int(machine);
+        int sval = right_->eval_int(machine);
+        return Op::apply(fval, sval);
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, Op::int_opcode());
+    }
+
+    bool jit(JitCompiler &jit) override {
+        if (!jit_operands(jit)) {
+            return false;
+        }
+        jit.binary<Op>();
+        return true;
+    }
+
+    // comparisons jump on the flags, the value isn't computed
+    bool jit_branch(JitCompiler &jit, JitCompiler::Label &otherwise) override {
+        if (!JitCompiler::compares<Op>()) {
+            return ExpressionNode::jit_branch(jit, otherwise);
+        }
+        if (!jit_operands(jit)) {
+            return false;
+        }
+        jit.jump_unless<Op>(otherwise);
+        return true;
+    }
+
+    // a division that may fail is checked by Op::apply() in the program
+    std::string transpile(Transpiler &transpiler) override {
+        if (safe_()) {
+            return transpile_infix(transpiler, Op::name());
+        }
+        auto left = left_->transpile(transpiler);
+        auto right = right_->transpile(transpiler);
+        return transpiler.temporary(
+                TypeIdentifyer::INT_T,
+                std::string(std::is_same<Op, Div>::value ? "Div" : "Mod") +
+                "::apply(" + left + ", " + right + ")");
+    }
+
+    ExpressionNode *optimize(Optimizer &optimizer) override {
+        BinaryOperator::optimize(optimizer);
+        auto left = int_constant(left_);
+        auto right = int_constant(right_);
+        if (left && right) {
+            try {
+                return new IntValueNode(Op::apply(left->value(),
+                                                  right->value()));
+            } catch (std::runtime_error &) {
+                // division by zero is reported when the code runs
+                return this;
+            }
+        }
+        return optimizer.algebra() ? simplify_() : this;
+    }
+
+    bool loop_invariant(const std::vector<VariableSlot> &assigned) const override {
+        return safe_() && left_->loop_invariant(assigned) &&
+               right_->loop_invariant(assigned);
+    }
+
+private:
+    ExpressionNode *simplify_() {
+        return this;
+    }
+
+    // the operation can't fail whatever the operands are
+    bool safe_() const {
+        return true;
+    }
+
+    bool is_(ExpressionNode *node, int value) const {
+        auto constant = int_constant(node);
+        return constant && constant->value() == value;
+    }
+
+    // x op x for comparisons of a variable with itself
+    ExpressionNode *same_operands_are_(int value) {
+        if (same_operands()) {
+            return new IntValueNode(value);
+        }
+        return this;
+    }
+};
+
+template <>
+inline ExpressionNode *IntBinaryOperator<Add>::simplify_() {
+    if (is_(right_, 0)) {
+        return take_left();
+    }
+    if (is_(left_, 0)) {
+        return take_right();
+    }
+    return this;
+}
+
+template <>
+inline ExpressionNode *IntBinaryOperator<Sub>::simplify_() {
+    if (is_(right_, 0)) {
+        return take_left();
+    }
+    if (same_operands()) {
+        return new IntValueNode(0);
+    }
+    return this;
+}
+
+template <>
+inline ExpressionNode *IntBinaryOperator<Mul>::simplify_() {
+    if (is_(right_, 1)) {
+        return take_left();
+    }
+    if (is_(left_, 1)) {
+        return take_right();
+    }
+    if ((is_(left_, 0) && is_pure(right_)) ||
+        (is_(right_, 0) && is_pure(left_))) {
+        return new IntValueNode(0);
+    }
+    return this;
+}
+
+template <>
+inline bool IntBinaryOperator<Div>::safe_() const {
+    auto divisor = int_constant(right_);
+    return divisor && divisor->value() != 0;
+}
+
+template <>
+inline bool IntBinaryOperator<Mod>::safe_() const {
+    auto divisor = int_constant(right_);
+    return divisor && divisor->value() != 0;
+}
+
+template <>
+inline ExpressionNode *IntBinaryOperator<Div>::simplify_() {
+    return is_(right_, 1) ? take_left() : this;
+}
+
+template <>
+inline ExpressionNode *IntBinaryOperator<Mod>::simplify_() {
+    if (is_(right_, 1) && is_pure(left_)) {
+        return new IntValueNode(0);
+    }
+    return this;
+}
+
+template <>
+inline ExpressionNode *IntBinaryOperator<Eq>::simplify_() {
+    return same_operands_are_(1);
+}
+
+template <>
+inline ExpressionNode *IntBinaryOperator<NotEq>::simplify_() {
+    return same_operands_are_(0);
+}
+
+template <>
+inline ExpressionNode *IntBinaryOperator<Less>::simplify_() {
+    return same_operands_are_(0);
+}
+
+template <>
+inline ExpressionNode *IntBinaryOperator<Gr>::simplify_() {
+    return same_operands_are_(0);
+}
+
+template <>
+inline ExpressionNode *IntBinaryOperator<LessEq>::simplify_() {
+    return same_operands_are_(1);
+}
+
+template <>
+inline ExpressionNode *IntBinaryOperator<GrEq>::simplify_() {
+    return same_operands_are_(1);
+}
+
+template <class Op>
+class IntUnaryOperator : public UnaryOperator {
+public:
+    explicit IntUnaryOperator(ExpressionNode *arg) :
+            UnaryOperator(arg, Op::name()) {}
+
+    // eval_int counts the evaluation
+    void evaluate(Machine &machine) override {
+        int result = eval_int(machine);
+        machine.push(TypeIdentifyer::INT_T);
+        *machine.top() = result;
+    }
+
+    int eval_int(Machine &machine) override {
+        count_evaluation_(machine, this);
+        return Op::apply(arg_->eval_int(machine));
+    }
+
+    int compile(Compiler &compiler) override {
+        return UnaryOperator::compile(compiler, Op::int_opcode());
+    }
+
+    bool jit(JitCompiler &jit) override {
+        if (!arg_->jit(jit)) {
+            return false;
+        }
+        jit.unary<Op>();
+        return true;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        return std::string("(") + Op::name() + arg_->transpile(transpiler) + ")";
+    }
+
+    ExpressionNode *optimize(Optimizer &optimizer) override {
+        UnaryOperator::optimize(optimizer);
+        if (auto arg = int_constant(arg_)) {
+            return new IntValueNode(Op::apply(arg->value()));
+        }
+        return optimizer.algebra() ? simplify_() : this;
+    }
+
+    bool loop_invariant(const std::vector<VariableSlot> &assigned) const override {
+        return arg_->loop_invariant(assigned);
+    }
+
+private:
+    ExpressionNode *simplify_() {
+        return this;
+    }
+};
+
+template <>
+inline ExpressionNode *IntUnaryOperator<Neg>::simplify_() {
+    auto inner = dynamic_cast<IntUnaryOperator<Neg> *>(arg_);
+    if (inner) {
+        auto node = inner->arg_;
+        inner->arg_ = nullptr;
+        return node;
+    }
+    return this;
+}
+
+template <class Op>
+class StrCompareOperator : public BinaryOperator {
+public:
+    StrCompareOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, Op::name()) {}
+
+    // eval_int counts the evaluation
+    void evaluate(Machine &machine) override {
+        int result = eval_int(machine);
+        machine.push(TypeIdentifyer::INT_T);
+        *machine.top() = result;
+    }
+
+    int eval_int(Machine &machine) override {
+        count_evaluation_(machine, this);
+        left_->evaluate(machine);
+        right_->evaluate(machine);
+        int result = apply_(machine.top(1), machine.top(0));
+        machine.pop();
+        machine.pop();
+        return result;
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, Op::opcode());
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        return transpile_infix(transpiler, Op::name());
+    }
+
+    ExpressionNode *optimize(Optimizer &optimizer) override {
+        BinaryOperator::optimize(optimizer);
+        auto left = string_constant(left_);
+        auto right = string_constant(right_);
+        if (left && right) {
+            return new IntValueNode(Op::apply(left->value(), right->value()));
+        }
+        return this;
+    }
+
+private:
+    static int apply_(const Value &fval, const Value &sval) {
+        return Op::apply(fval.str(), sval.str());
+    }
+};
+
+template <>
+inline int StrCompareOperator<Eq>::apply_(const Value &fval, const Value &sval) {
+    return fval.str_equal(sval);
+}
+
+template <>
+inline int StrCompareOperator<NotEq>::apply_(const Value &fval, const Value &sval) {
+    return !fval.str_equal(sval);
+}
+
+class StrConcatOperator : public BinaryOperator {
+public:
+    StrConcatOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, Add::name()) {
+        value_type_ = TypeIdentifyer::STRING_T;
+    }
+
+    // the left operand is appended to unless it is shared, so a chain
+    // a + b + c + ... copies a once and then grows
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        BinaryOperator::evaluate(machine);
+        machine.top(1).append(machine.top(0).str());
+        machine.pop();
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, Add::opcode());
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        return transpile_infix(transpiler, Add::name());
+    }
+
+    ExpressionNode *optimize(Optimizer &optimizer) override {
+        BinaryOperator::optimize(optimizer);
+        auto left = string_constant(left_);
+        auto right = string_constant(right_);
+        if (left && right && left->value().size() + right->value().size() <=
+                             Optimizer::MAX_FOLDED_STRING) {
+            return new StringValueNode(left->value() + right->value());
+        }
+        if (optimizer.algebra()) {
+            if (right && right->value().empty()) {
+                return take_left();
+            }
+            if (left && left->value().empty()) {
+                return take_right();
+            }
+        }
+        return this;
+    }
+};
+
+class StrRepeatOperator : public BinaryOperator {
+public:
+    StrRepeatOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, Mul::name()) {
+        value_type_ = TypeIdentifyer::STRING_T;
+        str_left_ = left->value_type() == TypeIdentifyer::STRING_T;
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        BinaryOperator::evaluate(machine);
+        const std::string &str = machine.top(str_left_ ? 1 : 0).str();
+        int times = machine.top(str_left_ ? 0 : 1).get_int();
+        std::string result = repeat_string(str, times);
+        machine.pop();
+        machine.top().load_str(std::move(result));
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, OpCode::MUL);
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        auto left = left_->transpile(transpiler);
+        auto right = right_->transpile(transpiler);
+        return transpiler.temporary(TypeIdentifyer::STRING_T, "repeat_string(" +
+                                    (str_left_ ? left + ", " + right : right + ", " + left) + ")");
+    }
+
+    ExpressionNode *optimize(Optimizer &optimizer) override {
+        BinaryOperator::optimize(optimizer);
+        auto str = string_constant(str_left_ ? left_ : right_);
+        auto times = int_constant(str_left_ ? right_ : left_);
+        if (str && times && (times->value() <= 0 ||
+                             str->value().size() * times->value() <=
+                             Optimizer::MAX_FOLDED_STRING)) {
+            std::string result;
+            for (int i = 0; i < times->value(); ++i) {
+                result += str->value();
+            }
+            return new StringValueNode(result);
+        }
+        return this;
+    }
+
+private:
+    bool str_left_;
+};
+
+// an int used as a long, put in by the checker; shows as the int
+class WidenNode : public UnaryOperator {
+public:
+    explicit WidenNode(ExpressionNode *arg) : UnaryOperator(arg) {
+        value_type_ = TypeIdentifyer::LONG_T;
+    }
+
+    void print(int depth, std::ostream &out) override {
+        arg_->print(depth, out);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        int val = arg_->eval_int(machine);
+        machine.push(TypeIdentifyer::LONG_T);
+        machine.top().load_long(val);
+    }
+
+    Long eval_long(Machine &machine) override {
+        count_evaluation_(machine, this);
+        return arg_->eval_int(machine);
+    }
+
+    int compile(Compiler &compiler) override {
+        return UnaryOperator::compile(compiler, OpCode::WIDEN);
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        return "Long(" + arg_->transpile(transpiler) + ")";
+    }
+
+    ExpressionNode *optimize(Optimizer &optimizer) override {
+        UnaryOperator::optimize(optimizer);
+        if (auto arg = int_constant(arg_)) {
+            return new LongValueNode(arg->value());
+        }
+        return this;
+    }
+};
+
+inline ExpressionNode *widen(ExpressionNode *node) {
+    if (node->value_type() == TypeIdentifyer::INT_T) {
+        return new WidenNode(node);
+    }
+    return node;
+}
+
+// operation on longs, see Long; comparisons make an int
+template <class Op>
+class LongBinaryOperator : public BinaryOperator {
+public:
+    LongBinaryOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, Op::name()) {
+        value_type_ = std::is_same<decltype(Op::apply(Long(), Long())), int>::value ?
+                      TypeIdentifyer::INT_T : TypeIdentifyer::LONG_T;
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        auto result = apply_(machine);
+        machine.push(value_type_);
+        store_(machine.top(), std::move(result));
+    }
+
+    int eval_int(Machine &machine) override {
+        count_evaluation_(machine, this);
+        return int_(apply_(machine));
+    }
+
+    Long eval_long(Machine &machine) override {
+        count_evaluation_(machine, this);
+        return apply_(machine);
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, Op::long_opcode());
+    }
+
+    // a division that may fail is checked by Op::apply() in the program
+    std::string transpile(Transpiler &transpiler) override {
+        auto divisor = long_constant(right_);
+        if ((!std::is_same<Op, Div>::value && !std::is_same<Op, Mod>::value) ||
+            (divisor && divisor->value() != 0)) {
+            return transpile_infix(transpiler, Op::name());
+        }
+        auto left = left_->transpile(transpiler);
+        auto right = right_->transpile(transpiler);
+        return transpiler.temporary(
+                TypeIdentifyer::LONG_T,
+                std::string(std::is_same<Op, Div>::value ? "Div" : "Mod") +
+                "::apply(" + left + ", " + right + ")");
+    }
+
+    ExpressionNode *optimize(Optimizer &optimizer) override {
+        BinaryOperator::optimize(optimizer);
+        auto left = long_constant(left_);
+        auto right = long_constant(right_);
+        if (left && right) {
+            try {
+                return constant_(Op::apply(left->value(), right->value()));
+            } catch (std::runtime_error &) {
+                // division by zero is reported when the code runs
+                return this;
+            }
+        }
+        return this;
+    }
+
+private:
+    auto apply_(Machine &machine) -> decltype(Op::apply(Long(), Long())) {
+        Long fval = left_->eval_long(machine);
+        return Op::apply(fval, right_->eval_long(machine));
+    }
+
+    static int int_(int result) {
+        return result;
+    }
+
+    // the checker lets no long be used as an int
+    static int int_(const Long &result) {
+        throw std::invalid_argument(NOT_BOOL_INT);
+    }
+
+    static void store_(Value &val, int result) {
+        val = result;
+    }
+
+    static void store_(Value &val, Long result) {
+        val.load_long(std::move(result));
+    }
+
+    static ExpressionNode *constant_(int result) {
+        return new IntValueNode(result);
+    }
+
+    static ExpressionNode *constant_(Long result) {
+        return new LongValueNode(std::move(result));
+    }
+};
+
+class LongNegOperator : public UnaryOperator {
+public:
+    explicit LongNegOperator(ExpressionNode *arg) :
+            UnaryOperator(arg, Neg::name()) {
+        value_type_ = TypeIdentifyer::LONG_T;
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        UnaryOperator::evaluate(machine);
+        machine.top().load_long(Neg::apply(machine.top().get_long()));
+    }
+
+    Long eval_long(Machine &machine) override {
+        count_evaluation_(machine, this);
+        return Neg::apply(arg_->eval_long(machine));
+    }
+
+    int compile(Compiler &compiler) override {
+        return UnaryOperator::compile(compiler, Neg::long_opcode());
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        return std::string("(") + Neg::name() + arg_->transpile(transpiler) + ")";
+    }
+
+    ExpressionNode *optimize(Optimizer &optimizer) override {
+        UnaryOperator::optimize(optimizer);
+        if (auto arg = long_constant(arg_)) {
+            return new LongValueNode(Neg::apply(arg->value()));
+        }
+        return this;
+    }
+};
+
+typedef IntBinaryOperator<Add> IntAdd;
+typedef IntBinaryOperator<Sub> IntSub;
+typedef IntBinaryOperator<Mul> IntMul;
+typedef IntBinaryOperator<Div> IntDiv;
+typedef IntBinaryOperator<Mod> IntMod;
+typedef IntBinaryOperator<And> IntAnd;
+typedef IntBinaryOperator<Or> IntOr;
+typedef IntBinaryOperator<Eq> IntEq;
+typedef IntBinaryOperator<NotEq> IntNotEq;
+typedef IntBinaryOperator<Less> IntLess;
+typedef IntBinaryOperator<Gr> IntGr;
+typedef IntBinaryOperator<LessEq> IntLessEq;
+typedef IntBinaryOperator<GrEq> IntGrEq;
+typedef IntUnaryOperator<Not> IntNot;
+typedef IntUnaryOperator<Neg> IntNeg;
+typedef StrConcatOperator StrConcat;
+typedef StrRepeatOperator StrRepeat;
+typedef StrCompareOperator<Eq> StrEq;
+typedef StrCompareOperator<NotEq> StrNotEq;
+typedef StrCompareOperator<Less> StrLess;
+typedef StrCompareOperator<Gr> StrGr;
+typedef StrCompareOperator<LessEq> StrLessEq;
+typedef StrCompareOperator<GrEq> StrGrEq;
+typedef LongBinaryOperator<Add> LongAdd;
+typedef LongBinaryOperator<Sub> LongSub;
+typedef LongBinaryOperator<Mul> LongMul;
+typedef LongBinaryOperator<Div> LongDiv;
+typedef LongBinaryOperator<Mod> LongMod;
+typedef LongBinaryOperator<Eq> LongEq;
+typedef LongBinaryOperator<NotEq> LongNotEq;
+typedef LongBinaryOperator<Less> LongLess;
+typedef LongBinaryOperator<Gr> LongGr;
+typedef LongBinaryOperator<LessEq> LongLessEq;
+typedef LongBinaryOperator<GrEq> LongGrEq;
+typedef LongNegOperator LongNeg;
+
+class NotOperator : public UnaryOperator {
+public:
+    explicit NotOperator(ExpressionNode *arg) :
+            UnaryOperator(arg, "!") {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        UnaryOperator::check(checker);
+        if (arg_->value_type() == TypeIdentifyer::INT_T) {
+            return specialize<IntNot>();
+        }
+        throw std::invalid_argument(NOT_BOOL_INT);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        UnaryOperator::evaluate(machine);
+        auto &val = machine.top();
+        switch (val.type()) {
+            case TypeIdentifyer::INT_T: {
+                int val_v = *val;
+                machine.pop();
+                machine.push(TypeIdentifyer::INT_T);
+                *machine.top() = !val_v;
+                break;
+            }
+            case TypeIdentifyer::STRING_T: {
+                bool val_v = !val.str().empty();
+                machine.pop();
+                machine.push(TypeIdentifyer::INT_T);
+                *machine.top() = !val_v;
+            }
+            default: {
+                throw std::invalid_argument(NOT_BOOL_INT);
+            }
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        return UnaryOperator::compile(compiler, OpCode::NOT);
+    }
+};
+
+class UnaryMinusOperator : public UnaryOperator {
+public:
+    explicit UnaryMinusOperator(ExpressionNode *arg) :
+            UnaryOperator(arg, "-") {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        UnaryOperator::check(checker);
+        if (arg_->value_type() == TypeIdentifyer::INT_T) {
+            return specialize<IntNeg>();
+        }
+        if (arg_->value_type() == TypeIdentifyer::LONG_T) {
+            return specialize<LongNeg>();
+        }
+        throw std::invalid_argument(NOT_INT);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        UnaryOperator::evaluate(machine);
+        auto &val = machine.top();
+        if (val.type() != TypeIdentifyer::INT_T) {
+            throw std::invalid_argument(NOT_INT);
+        }
+        int val_v = *val;
+        machine.pop();
+        machine.push(TypeIdentifyer::INT_T);
+        *machine.top() = -val_v;
+    }
+
+    int compile(Compiler &compiler) override {
+        return UnaryOperator::compile(compiler, OpCode::NEG);
+    }
+};
+
+class PlusOperator : public BinaryOperator {
+public:
+    PlusOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, "+") {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        BinaryOperator::check(checker);
+        if (operands_are(TypeIdentifyer::INT_T, TypeIdentifyer::INT_T)) {
+            return specialize<IntAdd>();
+        }
+        if (long_operands()) {
+            return specialize_long<LongAdd>();
+        }
+        if (operands_are(TypeIdentifyer::STRING_T, TypeIdentifyer::STRING_T)) {
+            return specialize<StrConcat>();
+        }
+        throw std::invalid_argument(NOT_INT);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        BinaryOperator::evaluate(machine);
+        auto &fval = machine.top(1);
+        auto &sval = machine.top(0);
+        if (fval.type() == TypeIdentifyer::INT_T &&
+            sval.type() == TypeIdentifyer::INT_T) {
+            int fval_v = *fval;
+            int sval_v = *sval;
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = fval_v + sval_v;
+        } else if (fval.type() == TypeIdentifyer::STRING_T &&
+                   sval.type() == TypeIdentifyer::STRING_T) {
+            fval.append(sval.str());
+            machine.pop();
+        } else {
+            throw std::invalid_argument(NOT_INT);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, OpCode::ADD);
+    }
+};
+
+class MinusOperator : public BinaryOperator {
+public:
+    MinusOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, "-") {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        BinaryOperator::check(checker);
+        if (operands_are(TypeIdentifyer::INT_T, TypeIdentifyer::INT_T)) {
+            return specialize<IntSub>();
+        }
+        if (long_operands()) {
+            return specialize_long<LongSub>();
+        }
+        throw std::invalid_argument(NOT_INT);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        BinaryOperator::evaluate(machine);
+        auto &fval = machine.top(1);
+        auto &sval = machine.top(0);
+        if (fval.type() == TypeIdentifyer::INT_T &&
+            sval.type() == TypeIdentifyer::INT_T) {
+            int fval_v = *fval;
+            int sval_v = *sval;
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = fval_v - sval_v;
+        } else {
+            throw std::invalid_argument(NOT_INT);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, OpCode::SUB);
+    }
+};
+
+class MultOperator : public BinaryOperator {
+public:
+    MultOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, "*") {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        BinaryOperator::check(checker);
+        if (operands_are(TypeIdentifyer::INT_T, TypeIdentifyer::INT_T)) {
+            return specialize<IntMul>();
+        }
+        if (long_operands()) {
+            return specialize_long<LongMul>();
+        }
+        if (operands_are(TypeIdentifyer::STRING_T, TypeIdentifyer::INT_T) ||
+            operands_are(TypeIdentifyer::INT_T, TypeIdentifyer::STRING_T)) {
+            return specialize<StrRepeat>();
+        }
+        throw std::invalid_argument(NOT_INT);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        BinaryOperator::evaluate(machine);
+        auto &fval = machine.top(1);
+        auto &sval = machine.top(0);
+        if (fval.type() == TypeIdentifyer::INT_T &&
+            sval.type() == TypeIdentifyer::INT_T) {
+            int fval_v = *fval;
+            int sval_v = *sval;
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = fval_v * sval_v;
+        } else if ((fval.type() == TypeIdentifyer::STRING_T &&
+                    sval.type() == TypeIdentifyer::INT_T) ||
+                    (fval.type() == TypeIdentifyer::INT_T &&
+                    sval.type() ==  TypeIdentifyer::STRING_T)) {
+            if (sval.type() == TypeIdentifyer::STRING_T) {
+                std::swap(fval, sval);
+            }
+            const std::string &str = fval.str();
+            int times = *sval;
+            std::string result;
+            if (times > 0) {
+                result.reserve(str.size() * times);
+            }
+            for (int i = 0; i < times; ++i) {
+                result += str;
+            }
+            machine.pop();
+            machine.top().load_str(std::move(result));
+        } else {
+            throw std::invalid_argument(NOT_INT);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, OpCode::MUL);
+    }
+};
+
+class DivideOperator : public BinaryOperator {
+public:
+    DivideOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, "/") {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        BinaryOperator::check(checker);
+        if (operands_are(TypeIdentifyer::INT_T, TypeIdentifyer::INT_T)) {
+            return specialize<IntDiv>();
+        }
+        if (long_operands()) {
+            return specialize_long<LongDiv>();
+        }
+        throw std::invalid_argument(NOT_INT);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        BinaryOperator::evaluate(machine);
+        auto &fval = machine.top(1);
+        auto &sval = machine.top(0);
+        if (fval.type() == TypeIdentifyer::INT_T &&
+            sval.type() == TypeIdentifyer::INT_T) {
+            int fval_v = *fval;
+            int sval_v = *sval;
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            if (sval_v == 0) {
+                throw std::runtime_error("Division by zero.");
+            }
+            *machine.top() = fval_v / sval_v;
+        } else {
+            throw std::invalid_argument(NOT_INT);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, OpCode::DIV);
+    }
+};
+
+class ModOperator : public BinaryOperator {
+public:
+    ModOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, "/") {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        BinaryOperator::check(checker);
+        if (operands_are(TypeIdentifyer::INT_T, TypeIdentifyer::INT_T)) {
+            return specialize<IntMod>();
+        }
+        if (long_operands()) {
+            return specialize_long<LongMod>();
+        }
+        throw std::invalid_argument(NOT_INT);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        BinaryOperator::evaluate(machine);
+        auto &fval = machine.top(1);
+        auto &sval = machine.top(0);
+        if (fval.type() == TypeIdentifyer::INT_T &&
+            sval.type() == TypeIdentifyer::INT_T) {
+            int fval_v = *fval;
+            int sval_v = *sval;
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            if (sval_v == 0) {
+                throw std::runtime_error("Division by zero.");
+            }
+            *machine.top() = fval_v % sval_v;
+        } else {
+            throw std::invalid_argument(NOT_INT);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, OpCode::MOD);
+    }
+};
+
+
+class AndOperator : public BinaryOperator {
+public:
+    AndOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, "&&") {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        BinaryOperator::check(checker);
+        if (operands_are(TypeIdentifyer::INT_T, TypeIdentifyer::INT_T)) {
+            return specialize<IntAnd>();
+        }
+        throw std::invalid_argument(NOT_BOOL_INT);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        BinaryOperator::evaluate(machine);
+        auto &fval = machine.top(1);
+        auto &sval = machine.top(0);
+        if (fval.type() == TypeIdentifyer::INT_T &&
+            sval.type() == TypeIdentifyer::INT_T) {
+            int fval_v = *fval;
+            int sval_v = *sval;
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = fval_v && sval_v;
+        } else {
+            throw std::invalid_argument(NOT_BOOL_INT);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, OpCode::AND);
+    }
+};
+
+class OrOperator : public BinaryOperator {
+public:
+    OrOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, "||") {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        BinaryOperator::check(checker);
+        if (operands_are(TypeIdentifyer::INT_T, TypeIdentifyer::INT_T)) {
+            return specialize<IntOr>();
+        }
+        throw std::invalid_argument(NOT_BOOL_INT);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        BinaryOperator::evaluate(machine);
+        auto &fval = machine.top(1);
+        auto &sval = machine.top(0);
+        if (fval.type() == TypeIdentifyer::INT_T &&
+            sval.type() == TypeIdentifyer::INT_T) {
+            int fval_v = *fval;
+            int sval_v = *sval;
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = fval_v || sval_v;
+        } else {
+            throw std::invalid_argument(NOT_BOOL_INT);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, OpCode::OR);
+    }
+};
+
+class EqOperator : public BinaryOperator {
+public:
+    EqOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, "==") {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        BinaryOperator::check(checker);
+        if (operands_are(TypeIdentifyer::INT_T, TypeIdentifyer::INT_T)) {
+            return specialize<IntEq>();
+        }
+        if (long_operands()) {
+            return specialize_long<LongEq>();
+        }
+        if (operands_are(TypeIdentifyer::STRING_T, TypeIdentifyer::STRING_T)) {
+            return specialize<StrEq>();
+        }
+        throw std::invalid_argument(NOT_INT);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        BinaryOperator::evaluate(machine);
+        auto &fval = machine.top(1);
+        auto &sval = machine.top(0);
+        if (fval.type() == TypeIdentifyer::INT_T &&
+            sval.type() == TypeIdentifyer::INT_T) {
+            int fval_v = *fval;
+            int sval_v = *sval;
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = fval_v == sval_v;
+        } else if (fval.type() == TypeIdentifyer::STRING_T &&
+                   sval.type() == TypeIdentifyer::STRING_T) {
+            int result = fval.str_equal(sval);
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = result;
+        } else {
+            throw std::invalid_argument(NOT_INT);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, OpCode::EQ);
+    }
+};
+
+class NotEqOperator : public BinaryOperator {
+public:
+    NotEqOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, "!=") {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        BinaryOperator::check(checker);
+        if (operands_are(TypeIdentifyer::INT_T, TypeIdentifyer::INT_T)) {
+            return specialize<IntNotEq>();
+        }
+        if (long_operands()) {
+            return specialize_long<LongNotEq>();
+        }
+        if (operands_are(TypeIdentifyer::STRING_T, TypeIdentifyer::STRING_T)) {
+            return specialize<StrNotEq>();
+        }
+        throw std::invalid_argument(NOT_INT);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        BinaryOperator::evaluate(machine);
+        auto &fval = machine.top(1);
+        auto &sval = machine.top(0);
+        if (fval.type() == TypeIdentifyer::INT_T &&
+            sval.type() == TypeIdentifyer::INT_T) {
+            int fval_v = *fval;
+            int sval_v = *sval;
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = fval_v != sval_v;
+        } else if (fval.type() == TypeIdentifyer::STRING_T &&
+                   sval.type() == TypeIdentifyer::STRING_T) {
+            int result = !fval.str_equal(sval);
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = result;
+        } else {
+            throw std::invalid_argument(NOT_INT);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, OpCode::NOT_EQ);
+    }
+};
+
+class LessOperator : public BinaryOperator {
+public:
+    LessOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, "<") {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        BinaryOperator::check(checker);
+        if (operands_are(TypeIdentifyer::INT_T, TypeIdentifyer::INT_T)) {
+            return specialize<IntLess>();
+        }
+        if (long_operands()) {
+            return specialize_long<LongLess>();
+        }
+        if (operands_are(TypeIdentifyer::STRING_T, TypeIdentifyer::STRING_T)) {
+            return specialize<StrLess>();
+        }
+        throw std::invalid_argument(NOT_INT);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        BinaryOperator::evaluate(machine);
+        auto &fval = machine.top(1);
+        auto &sval = machine.top(0);
+        if (fval.type() == TypeIdentifyer::INT_T &&
+            sval.type() == TypeIdentifyer::INT_T) {
+            int fval_v = *fval;
+            int sval_v = *sval;
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = fval_v < sval_v;
+        } else if (fval.type() == TypeIdentifyer::STRING_T &&
+                   sval.type() == TypeIdentifyer::STRING_T) {
+            int result = fval.str() < sval.str();
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = result;
+        } else {
+            throw std::invalid_argument(NOT_INT);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, OpCode::LESS);
+    }
+};
+
+class GrOperator : public BinaryOperator {
+public:
+    GrOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, ">") {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        BinaryOperator::check(checker);
+        if (operands_are(TypeIdentifyer::INT_T, TypeIdentifyer::INT_T)) {
+            return specialize<IntGr>();
+        }
+        if (long_operands()) {
+            return specialize_long<LongGr>();
+        }
+        if (operands_are(TypeIdentifyer::STRING_T, TypeIdentifyer::STRING_T)) {
+            return specialize<StrGr>();
+        }
+        throw std::invalid_argument(NOT_INT);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        BinaryOperator::evaluate(machine);
+        auto &fval = machine.top(1);
+        auto &sval = machine.top(0);
+        if (fval.type() == TypeIdentifyer::INT_T &&
+            sval.type() == TypeIdentifyer::INT_T) {
+            int fval_v = *fval;
+            int sval_v = *sval;
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = fval_v > sval_v;
+        } else if (fval.type() == TypeIdentifyer::STRING_T &&
+                   sval.type() == TypeIdentifyer::STRING_T) {
+            int result = fval.str() > sval.str();
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = result;
+        } else {
+            throw std::invalid_argument(NOT_INT);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, OpCode::GR);
+    }
+};
+
+class LessEqOperator : public BinaryOperator {
+public:
+    LessEqOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, "<=") {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        BinaryOperator::check(checker);
+        if (operands_are(TypeIdentifyer::INT_T, TypeIdentifyer::INT_T)) {
+            return specialize<IntLessEq>();
+        }
+        if (long_operands()) {
+            return specialize_long<LongLessEq>();
+        }
+        if (operands_are(TypeIdentifyer::STRING_T, TypeIdentifyer::STRING_T)) {
+            return specialize<StrLessEq>();
+        }
+        throw std::invalid_argument(NOT_INT);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        BinaryOperator::evaluate(machine);
+        auto &fval = machine.top(1);
+        auto &sval = machine.top(0);
+        if (fval.type() == TypeIdentifyer::INT_T &&
+            sval.type() == TypeIdentifyer::INT_T) {
+            int fval_v = *fval;
+            int sval_v = *sval;
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = fval_v <= sval_v;
+        } else if (fval.type() == TypeIdentifyer::STRING_T &&
+                   sval.type() == TypeIdentifyer::STRING_T) {
+            int result = fval.str() <= sval.str();
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = result;
+        } else {
+            throw std::invalid_argument(NOT_INT);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, OpCode::LESS_EQ);
+    }
+};
+
+class GrEqOperator : public BinaryOperator {
+public:
+    GrEqOperator(ExpressionNode *left, ExpressionNode *right) :
+            BinaryOperator(left, right, ">=") {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        BinaryOperator::check(checker);
+        if (operands_are(TypeIdentifyer::INT_T, TypeIdentifyer::INT_T)) {
+            return specialize<IntGrEq>();
+        }
+        if (long_operands()) {
+            return specialize_long<LongGrEq>();
+        }
+        if (operands_are(TypeIdentifyer::STRING_T, TypeIdentifyer::STRING_T)) {
+            return specialize<StrGrEq>();
+        }
+        throw std::invalid_argument(NOT_INT);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        BinaryOperator::evaluate(machine);
+        auto &fval = machine.top(1);
+        auto &sval = machine.top(0);
+        if (fval.type() == TypeIdentifyer::INT_T &&
+            sval.type() == TypeIdentifyer::INT_T) {
+            int fval_v = *fval;
+            int sval_v = *sval;
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = fval_v >= sval_v;
+        } else if (fval.type() == TypeIdentifyer::STRING_T &&
+                   sval.type() == TypeIdentifyer::STRING_T) {
+            int result = fval.str() >= sval.str();
+            machine.pop();
+            machine.pop();
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = result;
+        } else {
+            throw std::invalid_argument(NOT_INT);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        return BinaryOperator::compile(compiler, OpCode::GR_EQ);
+    }
+};
+
+class AssignOperator : public OperatorNode {
+public:
+    AssignOperator(const std::string &var_name, ExpressionNode *expression) :
+            AssignOperator(new VariableNode(var_name), expression) {}
+
+    AssignOperator(VariableNode *variable, ExpressionNode *expression) :
+            OperatorNode("="), variable_(variable), expression_(expression) {}
+
+    ~AssignOperator() override {
+        destroy(variable_);
+        destroy(expression_);
+    }
+
+    void print(int depth, std::ostream &out) override {
+        variable_->print(depth, out);
+        out << " ";
+        OperatorNode::print(depth, out);
+        out << " ";
+        expression_->print(depth, out);
+    }
+
+    bool has_value() const override {
+        return false;
+    }
+
+    VariableNode *variable() const {
+        return variable_;
+    }
+
+    ExpressionNode *expression() const {
+        return expression_;
+    }
+
+    void resolve(Resolver &resolver) override {
+        expression_->resolve(resolver);
+        variable_->resolve(resolver);
+    }
+
+    ExpressionNode *check(TypeChecker &checker) override;
+
+    ExpressionNode *optimize(Optimizer &optimizer) override {
+        optimizer.optimize(expression_);
+        return this;
+    }
+
+    void collect_assigned(std::vector<VariableSlot> &assigned) override {
+        assigned.push_back(variable_->slot());
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        expression_->evaluate(machine);
+        auto &expr = machine.top();
+        auto &var = machine.slot(variable_->slot());
+        if (var.type() != expr.type()) {
+            throw std::invalid_argument(VAR_NEQ_EXPR);
+        }
+        var = expr;
+        machine.pop();
+    }
+
+    int compile(Compiler &compiler) override {
+        int mark = compiler.temps();
+        int expr = expression_->compile(compiler);
+        int var = variable_->compile(compiler);
+        compiler.emit(OpCode::ASSIGN, var, expr);
+        compiler.free_temps(mark);
+        return Compiler::NO_REG;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        auto expr = expression_->transpile(transpiler);
+        transpiler.line(variable_->transpile(transpiler) + " = " + expr + ";");
+        return std::string();
+    }
+
+protected:
+    VariableNode *variable_;
+    ExpressionNode *expression_;
+};
+
+// assignment of an int expression, the types are checked beforehand
+class IntAssignOperator : public AssignOperator {
+public:
+    IntAssignOperator(VariableNode *variable, ExpressionNode *expression) :
+            AssignOperator(variable, expression) {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        return this;
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        int val = expression_->eval_int(machine);
+        machine.slot(variable_->slot()) = val;
+    }
+
+    int compile(Compiler &compiler) override {
+        int mark = compiler.temps();
+        int expr = expression_->compile(compiler);
+        compiler.emit(OpCode::MOVE, variable_->compile(compiler), expr);
+        compiler.free_temps(mark);
+        return Compiler::NO_REG;
+    }
+
+    bool jit(JitCompiler &jit) override {
+        if (!expression_->jit(jit)) {
+            return false;
+        }
+        jit.store(variable_->slot());
+        return true;
+    }
+
+    ExpressionNode *optimize(Optimizer &optimizer) override;
+
+private:
+    template <class Op>
+    ExpressionNode *update_();
+};
+
+// assignment of a long expression, the types are checked beforehand
+class LongAssignOperator : public AssignOperator {
+public:
+    LongAssignOperator(VariableNode *variable, ExpressionNode *expression) :
+            AssignOperator(variable, expression) {}
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        return this;
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        machine.slot(variable_->slot()).load_long(expression_->eval_long(machine));
+    }
+
+    int compile(Compiler &compiler) override {
+        int mark = compiler.temps();
+        int expr = expression_->compile(compiler);
+        compiler.emit(OpCode::MOVE, variable_->compile(compiler), expr);
+        compiler.free_temps(mark);
+        return Compiler::NO_REG;
+    }
+};
+
+// reduction x = x op expr, the variable is updated in place
+template <class Op>
+class IntUpdateOperator : public IntAssignOperator {
+public:
+    IntUpdateOperator(VariableNode *variable, ExpressionNode *operand) :
+            IntAssignOperator(variable, operand) {}
+
+    VariableSlot slot() const {
+        return variable_->slot();
+    }
+
+    ExpressionNode *operand() const {
+        return expression_;
+    }
+
+    void print(int depth, std::ostream &out) override {
+        variable_->print(depth, out);
+        out << " = ";
+        variable_->print(depth, out);
+        out << " " << Op::name() << " ";
+        BinaryOperator::print_operand(expression_, depth, out);
+    }
+
+    ExpressionNode *optimize(Optimizer &optimizer) override {
+        optimizer.optimize(expression_);
+        return this;
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        int val = expression_->eval_int(machine);
+        auto &var = machine.slot(variable_->slot());
+        var = Op::apply(var.get_int(), val);
+    }
+
+    int compile(Compiler &compiler) override {
+        int mark = compiler.temps();
+        int expr = expression_->compile(compiler);
+        int var = variable_->compile(compiler);
+        compiler.emit(Op::int_opcode(), var, var, expr);
+        compiler.free_temps(mark);
+        return Compiler::NO_REG;
+    }
+
+    bool jit(JitCompiler &jit) override {
+        if (!expression_->jit(jit)) {
+            return false;
+        }
+        jit.update<Op>(variable_->slot());
+        return true;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        auto expr = expression_->transpile(transpiler);
+        transpiler.line(variable_->transpile(transpiler) + " " + Op::name() + "= " +
+                        expr + ";");
+        return std::string();
+    }
+};
+
+// s = s + a + b + ..., the parts are appended to the variable in place, so
+// a string built in a loop takes amortized linear time
+class StrAppendOperator : public AssignOperator {
+public:
+    StrAppendOperator(VariableNode *variable, std::vector<ExpressionNode *> parts) :
+            AssignOperator(variable, nullptr), parts_(std::move(parts)) {}
+
+    ~StrAppendOperator() override {
+        for (auto part : parts_) {
+            destroy(part);
+        }
+    }
+
+    // takes the parts out of the concatenation if its leftmost operand is
+    // the variable itself
+    static StrAppendOperator *make(VariableNode *&variable,
+                                   ExpressionNode *&expression) {
+        std::vector<ExpressionNode *> parts;
+        ExpressionNode *node = expression;
+        while (auto concat = dynamic_cast<StrConcatOperator *>(node)) {
+            node = concat->left();
+        }
+        if (node == expression || node->nodeType() != NodeType::VARIABLE ||
+            !static_cast<VariableNode *>(node)->same(*variable)) {
+            return nullptr;
+        }
+        for (node = expression; node->nodeType() != NodeType::VARIABLE;
+             node = static_cast<StrConcatOperator *>(node)->left()) {
+            parts.push_back(static_cast<StrConcatOperator *>(node)->take_right());
+        }
+        std::reverse(parts.begin(), parts.end());
+        auto append = new StrAppendOperator(variable, std::move(parts));
+        delete expression;
+        variable = nullptr;
+        expression = nullptr;
+        return append;
+    }
+
+    void print(int depth, std::ostream &out) override {
+        variable_->print(depth, out);
+        out << " = ";
+        variable_->print(depth, out);
+        for (auto part : parts_) {
+            out << " + ";
+            BinaryOperator::print_operand(part, depth, out);
+        }
+    }
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        return this;
+    }
+
+    ExpressionNode *optimize(Optimizer &optimizer) override {
+        for (auto &part : parts_) {
+            optimizer.optimize(part);
+        }
+        return this;
+    }
+
+    // all parts are evaluated before the variable changes
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        for (auto part : parts_) {
+            part->evaluate(machine);
+        }
+        auto &var = machine.slot(variable_->slot());
+        for (size_t i = parts_.size(); i > 0; --i) {
+            var.append(machine.top(static_cast<int>(i) - 1).str());
+        }
+        for (size_t i = 0; i < parts_.size(); ++i) {
+            machine.pop();
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        int mark = compiler.temps();
+        int var = variable_->compile(compiler);
+        std::vector<int> regs;
+        for (auto part : parts_) {
+            int reg = part->compile(compiler);
+            if (reg == var) {
+                int copy = compiler.temp();
+                compiler.emit(OpCode::MOVE, copy, reg);
+                reg = copy;
+            }
+            regs.push_back(reg);
+        }
+        for (int reg : regs) {
+            compiler.emit(OpCode::APPEND, var, reg);
+        }
+        compiler.free_temps(mark);
+        return Compiler::NO_REG;
+    }
+
+    // with several parts, they are copied before the variable changes
+    std::string transpile(Transpiler &transpiler) override {
+        std::vector<std::string> parts;
+        for (auto part : parts_) {
+            auto code = part->transpile(transpiler);
+            if (parts_.size() > 1 && part->nodeType() != NodeType::CONSTANT) {
+                code = transpiler.temporary(TypeIdentifyer::STRING_T, code);
+            }
+            parts.push_back(code);
+        }
+        auto var = variable_->transpile(transpiler);
+        for (const auto &part : parts) {
+            transpiler.line(var + " += " + part + ";");
+        }
+        return std::string();
+    }
+
+private:
+    std::vector<ExpressionNode *> parts_;
+};
+
+template <class Op>
+ExpressionNode *IntAssignOperator::update_() {
+    auto op = dynamic_cast<IntBinaryOperator<Op> *>(expression_);
+    if (!op || op->left()->nodeType() != NodeType::VARIABLE ||
+        !static_cast<VariableNode *>(op->left())->same(*variable_)) {
+        return nullptr;
+    }
+    auto node = new IntUpdateOperator<Op>(variable_, op->take_right());
+    variable_ = nullptr;
+    return node;
+}
+
+inline ExpressionNode *IntAssignOperator::optimize(Optimizer &optimizer) {
+    AssignOperator::optimize(optimizer);
+    if (!optimizer.loops()) {
+        return this;
+    }
+    ExpressionNode *node = nullptr;
+    if ((node = update_<Add>()) || (node = update_<Sub>()) ||
+        (node = update_<Mul>())) {
+        return node;
+    }
+    return this;
+}
+
+inline ExpressionNode *AssignOperator::check(TypeChecker &checker) {
+    checker.check_value(expression_);
+    if (variable_->value_type() == TypeIdentifyer::LONG_T) {
+        expression_ = widen(expression_);
+    }
+    if (variable_->value_type() != expression_->value_type()) {
+        throw std::invalid_argument(VAR_NEQ_EXPR);
+    }
+    if (variable_->value_type() == TypeIdentifyer::INT_T) {
+        auto node = new IntAssignOperator(variable_, expression_);
+        variable_ = nullptr;
+        expression_ = nullptr;
+        return node;
+    }
+    if (variable_->value_type() == TypeIdentifyer::LONG_T) {
+        auto node = new LongAssignOperator(variable_, expression_);
+        variable_ = nullptr;
+        expression_ = nullptr;
+        return node;
+    }
+    if (auto node = StrAppendOperator::make(variable_, expression_)) {
+        return node;
+    }
+    return this;
+}
+
+class CreateOperator : public OperatorNode {
+public:
+    CreateOperator(TypeNode *var_type, const std::string &var_name,
+                   ExpressionNode *expression = nullptr) :
+            CreateOperator(var_type, new VariableNode(var_name),
+                           expression) {}
+
+    CreateOperator(TypeIdentifyer type, const std::string &var_name,
+                   ExpressionNode *expression = nullptr) :
+            CreateOperator(new TypeNode(type), new VariableNode(var_name),
+                           expression) {}
+
+    CreateOperator(TypeNode *var_type, VariableNode *var,
+                   ExpressionNode *expression = nullptr) :
+            OperatorNode("="),
+            var_type_(var_type), var_(var), expression_(expression) {}
+
+    ~CreateOperator() override {
+        destroy(var_type_);
+        destroy(var_);
+        destroy(expression_);
+    }
+
+    void print(int depth, std::ostream &out) override {
+        var_type_->print(depth, out);
+        out << " ";
+        var_->print(depth, out);
+        if (expression_) {
+            out << " ";
+            OperatorNode::print(depth, out);
+            out << " ";
+            expression_->print(depth, out);
+        }
+    }
+
+    bool has_value() const override {
+        return false;
+    }
+
+    VariableNode *variable() const {
+        return var_;
+    }
+
+    ExpressionNode *expression() const {
+        return expression_;
+    }
+
+    void resolve(Resolver &resolver) override {
+        var_->declare(resolver, var_type_->type());
+        if (expression_) {
+            expression_->resolve(resolver);
+        }
+    }
+
+    ExpressionNode *check(TypeChecker &checker) override {
+        if (expression_) {
+            checker.check_value(expression_);
+            if (var_type_->type() == TypeIdentifyer::LONG_T) {
+                expression_ = widen(expression_);
+            }
+            if (var_type_->type() != expression_->value_type()) {
+                throw std::invalid_argument(VAR_NEQ_EXPR);
+            }
+        }
+        return this;
+    }
+
+    ExpressionNode *optimize(Optimizer &optimizer) override {
+        if (expression_) {
+            optimizer.optimize(expression_);
+        }
+        return this;
+    }
+
+    void collect_assigned(std::vector<VariableSlot> &assigned) override {
+        assigned.push_back(var_->slot());
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        machine.slot(var_->slot()) = Value(var_type_->type());
+        if (expression_) {
+            expression_->evaluate(machine);
+            auto &expr = machine.top();
+            auto &var = machine.slot(var_->slot());
+            if (var.type() != expr.type()) {
+                throw std::invalid_argument(VAR_NEQ_EXPR);
+            }
+            var = expr;
+            machine.pop();
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        int var = compiler.variable(var_->slot());
+        compiler.emit(OpCode::DECL, var, static_cast<int>(var_type_->type()));
+        if (expression_) {
+            int mark = compiler.temps();
+            compiler.emit(OpCode::ASSIGN, var, expression_->compile(compiler));
+            compiler.free_temps(mark);
+        }
+        return Compiler::NO_REG;
+    }
+
+    bool jit(JitCompiler &jit) override {
+        if (var_type_->type() != TypeIdentifyer::INT_T) {
+            return false;
+        }
+        // the expression sees the variable as 0, like evaluate() does
+        jit.declare(var_->slot());
+        jit.load_int(0);
+        jit.store(var_->slot());
+        if (expression_) {
+            if (!expression_->jit(jit)) {
+                return false;
+            }
+            jit.store(var_->slot());
+        }
+        return true;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        auto type = var_type_->type();
+        transpiler.declare(var_->name(), var_->slot(), type);
+        auto var = var_->transpile(transpiler);
+        bool cleared = type == TypeIdentifyer::STRING_T || is_array(type) || is_map(type);
+        auto reset = var + (cleared ? ".clear();" : " = 0;");
+        if (!expression_) {
+            transpiler.line(reset);
+            return std::string();
+        }
+        // the variable is reset for an expression reading it, the one
+        // declared at the top of the block may be left from the last
+        // iteration of a loop
+        size_t mark = transpiler.mark();
+        auto expr = expression_->transpile(transpiler);
+        auto computed = transpiler.take(mark);
+        computed.push_back(expr);
+        if (Transpiler::uses(computed, var)) {
+            transpiler.line(reset);
+        }
+        computed.pop_back();
+        transpiler.put(computed);
+        transpiler.line(var + " = " + expr + ";");
+        return std::string();
+    }
+
+private:
+    TypeNode *var_type_;
+    VariableNode *var_;
+    ExpressionNode *expression_;
+};
+
+class IfOperatorNode : public OperatorNode {
+public:
+    IfOperatorNode(ExpressionNode *condition,
+                   CmdNode *true_branch,
+                   CmdNode *false_branch = nullptr) :
+            condition_(condition),
+            true_branch_(true_branch),
+            false_branch_(false_branch) {}
+
+    ~IfOperatorNode() override {
+        destroy(condition_);
+        destroy(true_branch_);
+        destroy(false_branch_);
+    }
+
+    void print(int depth, std::ostream &out) override {
+        auto tab = std::string(depth, '\t');
+        out << tab << "if (";
+        condition_->print(depth, out);
+        out << ")\n";
+        true_branch_->print(depth, out);
+        if (false_branch_) {
+            out << tab << "else\n";
+            false_branch_->print(depth, out);
+        }
+    }
+
+    void resolve(Resolver &resolver) override {
+        condition_->resolve(resolver);
+        true_branch_->resolve(resolver);
+        if (false_branch_) {
+            false_branch_->resolve(resolver);
+        }
+    }
+
+    OperatorNode *check(TypeChecker &checker) override {
+        checker.check_condition(condition_);
+        checker.check(true_branch_);
+        if (false_branch_) {
+            checker.check(false_branch_);
+        }
+        return this;
+    }
+
+    OperatorNode *optimize(Optimizer &optimizer) override {
+        optimizer.optimize(condition_);
+        optimizer.optimize(true_branch_);
+        if (false_branch_) {
+            optimizer.optimize(false_branch_);
+        }
+        return this;
+    }
+
+    // a constant condition leaves only one of the branches
+    Node *prune(Optimizer &optimizer) override {
+        auto cond = int_constant(condition_);
+        if (!cond) {
+            return this;
+        }
+        Node *branch = cond->value() ? true_branch_ : false_branch_;
+        if (cond->value()) {
+            true_branch_ = nullptr;
+        } else {
+            false_branch_ = nullptr;
+        }
+        return branch;
+    }
+
+    void collect_assigned(std::vector<VariableSlot> &assigned) override {
+        true_branch_->collect_assigned(assigned);
+        if (false_branch_) {
+            false_branch_->collect_assigned(assigned);
+        }
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        if (condition_->eval_int(machine)) {
+            true_branch_->evaluate(machine);
+        } else {
+            if (false_branch_) {
+                false_branch_->evaluate(machine);
+            }
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        int mark = compiler.temps();
+        int cond = condition_->compile(compiler);
+        compiler.free_temps(mark);
+        int to_false = compiler.emit(OpCode::JUMP_FALSE, cond);
+        true_branch_->compile(compiler);
+        if (false_branch_) {
+            int to_end = compiler.emit(OpCode::JUMP);
+            compiler.patch(to_false);
+            false_branch_->compile(compiler);
+            compiler.patch(to_end);
+        } else {
+            compiler.patch(to_false);
+        }
+        return Compiler::NO_REG;
+    }
+
+    bool jit(JitCompiler &jit) override {
+        JitCompiler::Label otherwise, end;
+        if (!condition_->jit_branch(jit, otherwise) || !true_branch_->jit(jit)) {
+            return false;
+        }
+        if (false_branch_) {
+            jit.jump(end);
+            jit.bind(otherwise);
+            if (!false_branch_->jit(jit)) {
+                return false;
+            }
+            jit.bind(end);
+        } else {
+            jit.bind(otherwise);
+        }
+        return true;
+    }
+
+    OperatorNode *native(JitCompiler &jit) override {
+        jit.native(true_branch_);
+        if (false_branch_) {
+            jit.native(false_branch_);
+        }
+        return this;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        transpiler.open("if " + Transpiler::parenthesized(condition_->transpile(transpiler)));
+        true_branch_->transpile(transpiler);
+        if (false_branch_) {
+            transpiler.reopen("else");
+            false_branch_->transpile(transpiler);
+        }
+        transpiler.close();
+        return std::string();
+    }
+
+private:
+    ExpressionNode *condition_;
+    CmdNode *true_branch_;
+    CmdNode *false_branch_;
+};
+
+// Loop-invariant int expressions of a loop are replaced with HoistedNode
+// and computed once before the first iteration.
+class LoopOperatorNode : public OperatorNode {
+protected:
+    // second optimizer pass over the loop parts, done once per loop
+    template <class... Parts>
+    void hoist_(Optimizer &optimizer,
+                const std::vector<VariableSlot> &assigned, Parts *&... parts) {
+        optimizer.enter_loop(assigned, hoisted_, indexed_);
+        int expand[] = {(optimizer.optimize(parts), 0)...};
+        (void) expand;
+        optimizer.leave_loop();
+    }
+
+    // a loop is optimized once, a pass over an enclosing loop only learns
+    // the arrays it indexes
+    bool optimized_again_(Optimizer &optimizer) {
+        if (!optimized_) {
+            optimized_ = true;
+            return false;
+        }
+        for (const auto &access : indexed_) {
+            optimizer.indexed(access.first, access.second);
+        }
+        return true;
+    }
+
+    void update_hoisted_(Machine &machine) {
+        for (auto node : hoisted_) {
+            node->update(machine);
+        }
+    }
+
+    void compile_hoisted_(Compiler &compiler) {
+        for (auto node : hoisted_) {
+            node->compile_value(compiler);
+        }
+    }
+
+    bool jit_hoisted_(JitCompiler &jit) {
+        for (auto node : hoisted_) {
+            if (!node->jit_value(jit)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // the loop compiled to machine code, nullptr if it can't be
+    Node *native_loop_(JitCompiler &jit);
+
+    void transpile_hoisted_(Transpiler &transpiler) {
+        for (auto node : hoisted_) {
+            node->transpile_value(transpiler);
+        }
+    }
+
+    // while (condition) { cmd after }, a condition that needs temporaries
+    // is computed at the top of the body
+    void transpile_loop_(Transpiler &transpiler, ExpressionNode *condition,
+                         CmdNode *cmd, ExpressionNode *after = nullptr) {
+        size_t mark = transpiler.mark();
+        auto cond = condition->transpile(transpiler);
+        auto computed = transpiler.take(mark);
+        if (computed.empty()) {
+            transpiler.open("while " + Transpiler::parenthesized(cond));
+        } else {
+            transpiler.open("while (true)");
+            transpiler.put(computed, 1);
+            transpiler.line("if (!" + cond + ") break;");
+        }
+        cmd->transpile(transpiler);
+        if (after) {
+            after->transpile(transpiler);
+        }
+        transpiler.close();
+    }
+
+    std::vector<HoistedNode *> hoisted_;
+    // array and index variables of array[index] in the body
+    std::vector<std::pair<VariableSlot, VariableSlot>> indexed_;
+    bool optimized_ = false;
+};
+
+class WhileOperatorNode : public LoopOperatorNode {
+public:
+    WhileOperatorNode(ExpressionNode *condition, CmdNode *cmd) :
+            condition_(condition), cmd_(cmd) {}
+
+    ~WhileOperatorNode() override {
+        destroy(condition_);
+        destroy(cmd_);
+    }
+
+    void print(int depth, std::ostream &out) override {
+        auto tab = std::string(depth, '\t');
+        out << tab << "while (";
+        condition_->print(depth, out);
+        out << ")\n";
+        cmd_->print(depth, out);
+    }
+
+    void resolve(Resolver &resolver) override {
+        condition_->resolve(resolver);
+        cmd_->resolve(resolver);
+    }
+
+    OperatorNode *check(TypeChecker &checker) override {
+        checker.check_condition(condition_);
+        checker.check(cmd_);
+        return this;
+    }
+
+    OperatorNode *optimize(Optimizer &optimizer) override {
+        if (optimized_again_(optimizer)) {
+            return this;
+        }
+        optimizer.optimize(condition_);
+        optimizer.optimize(cmd_);
+        if (optimizer.loops()) {
+            std::vector<VariableSlot> assigned;
+            cmd_->collect_assigned(assigned);
+            hoist_(optimizer, assigned, condition_, cmd_);
+        }
+        return this;
+    }
+
+    Node *prune(Optimizer &optimizer) override {
+        auto cond = int_constant(condition_);
+        return cond && !cond->value() ? nullptr : this;
+    }
+
+    void collect_assigned(std::vector<VariableSlot> &assigned) override {
+        cmd_->collect_assigned(assigned);
+    }
+
     void evaluate(Machine &machine) override {
-        UnaryOperator::evaluate(machine);
-        auto &val = machine.top();
-        switch (val.type()) {
-            case TypeIdentifyer::INT_T: {
-                int val_v = *val;
-                machine.pop();
-                machine.push(TypeIdentifyer::INT_T);
-                *machine.top() = !val_v;
+        count_evaluation_(machine, this);
+        update_hoisted_(machine);
+        while (true) {
+            if (!condition_->eval_int(machine)) {
+                break;
+            }
+            cmd_->evaluate(machine);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        int loop_mark = compiler.temps();
+        compile_hoisted_(compiler);
+        int start = compiler.label();
+        int mark = compiler.temps();
+        int cond = condition_->compile(compiler);
+        compiler.free_temps(mark);
+        int to_end = compiler.emit(OpCode::JUMP_FALSE, cond);
+        cmd_->compile(compiler);
+        compiler.emit(OpCode::JUMP, start);
+        compiler.patch(to_end);
+        compiler.free_temps(loop_mark);
+        return Compiler::NO_REG;
+    }
+
+    bool jit(JitCompiler &jit) override {
+        JitCompiler::Label start, end;
+        if (!jit_hoisted_(jit)) {
+            return false;
+        }
+        jit.enter_loop();
+        jit.bind(start);
+        if (!condition_->jit_branch(jit, end) || !cmd_->jit(jit)) {
+            return false;
+        }
+        jit.jump(start);
+        jit.bind(end);
+        jit.leave_loop();
+        return true;
+    }
+
+    Node *native(JitCompiler &jit) override {
+        if (auto node = native_loop_(jit)) {
+            return node;
+        }
+        jit.native(cmd_);
+        return this;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        transpile_hoisted_(transpiler);
+        transpile_loop_(transpiler, condition_, cmd_);
+        return std::string();
+    }
+
+private:
+    ExpressionNode *condition_;
+    CmdNode *cmd_;
+};
+
+class ForOperatorNode : public LoopOperatorNode {
+public:
+    ForOperatorNode(ExpressionNode *init, ExpressionNode *condition, ExpressionNode *after, CmdNode *cmd) :
+            init_(init), condition_(condition), after_(after), cmd_(cmd) {}
+
+    ~ForOperatorNode() override {
+        destroy(init_);
+        destroy(condition_);
+        destroy(after_);
+        destroy(cmd_);
+    }
+
+    void print(int depth, std::ostream &out) override {
+        auto tab = std::string(depth, '\t');
+        out << tab << "for (";
+        init_->print(depth, out);
+        out << ";";
+        condition_->print(depth, out);
+        out << ";";
+        after_->print(depth, out);
+        out << ")\n";
+        cmd_->print(depth, out);
+    }
+
+    void resolve(Resolver &resolver) override {
+        init_->resolve(resolver);
+        condition_->resolve(resolver);
+        cmd_->resolve(resolver);
+        after_->resolve(resolver);
+    }
+
+    OperatorNode *check(TypeChecker &checker) override {
+        checker.check(init_);
+        checker.check_condition(condition_);
+        checker.check(cmd_);
+        checker.check(after_);
+        return this;
+    }
+
+    OperatorNode *optimize(Optimizer &optimizer) override {
+        if (optimized_again_(optimizer)) {
+            return this;
+        }
+        optimizer.optimize(init_);
+        optimizer.optimize(condition_);
+        optimizer.optimize(after_);
+        optimizer.optimize(cmd_);
+        if (!optimizer.loops()) {
+            return this;
+        }
+        std::vector<VariableSlot> assigned;
+        cmd_->collect_assigned(assigned);
+        size_t body_assigned = assigned.size();
+        after_->collect_assigned(assigned);
+        hoist_(optimizer, assigned, condition_, after_, cmd_);
+        assigned.resize(body_assigned);
+        auto counted = counted_(assigned);
+        return counted ? counted : this;
+    }
+
+    void collect_assigned(std::vector<VariableSlot> &assigned) override {
+        init_->collect_assigned(assigned);
+        after_->collect_assigned(assigned);
+        cmd_->collect_assigned(assigned);
+    }
+
+    // the body of a loop that never runs is dropped, init is still done
+    Node *prune(Optimizer &optimizer) override {
+        auto cond = int_constant(condition_);
+        if (!cond || cond->value()) {
+            return this;
+        }
+        Node *init = init_;
+        init_ = nullptr;
+        optimizer.prune(init);
+        if (!init) {
+            return nullptr;
+        }
+        auto cmd = new CmdNode(init);
+        cmd->setSimple();
+        cmd->set_position(line(), column());
+        return cmd;
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        init_->evaluate(machine);
+        update_hoisted_(machine);
+        while (true) {
+            if (!condition_->eval_int(machine)) {
+                break;
+            }
+            cmd_->evaluate(machine);
+            after_->evaluate(machine);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        int loop_mark = compiler.temps();
+        init_->compile(compiler);
+        compiler.free_temps(loop_mark);
+        compile_hoisted_(compiler);
+        int mark = compiler.temps();
+        int start = compiler.label();
+        int cond = condition_->compile(compiler);
+        compiler.free_temps(mark);
+        int to_end = compiler.emit(OpCode::JUMP_FALSE, cond);
+        cmd_->compile(compiler);
+        after_->compile(compiler);
+        compiler.free_temps(mark);
+        compiler.emit(OpCode::JUMP, start);
+        compiler.patch(to_end);
+        compiler.free_temps(loop_mark);
+        return Compiler::NO_REG;
+    }
+
+    bool jit(JitCompiler &jit) override {
+        JitCompiler::Label start, end;
+        if (!init_->jit(jit) || !jit_hoisted_(jit)) {
+            return false;
+        }
+        jit.enter_loop();
+        jit.bind(start);
+        if (!condition_->jit_branch(jit, end) || !cmd_->jit(jit) ||
+            !after_->jit(jit)) {
+            return false;
+        }
+        jit.jump(start);
+        jit.bind(end);
+        jit.leave_loop();
+        return true;
+    }
+
+    Node *native(JitCompiler &jit) override {
+        if (auto node = native_loop_(jit)) {
+            return node;
+        }
+        jit.native(cmd_);
+        return this;
+    }
+
+    // CountedForNode too: the compiler keeps the bound and the counter in
+    // registers by itself
+    std::string transpile(Transpiler &transpiler) override {
+        init_->transpile(transpiler);
+        transpile_hoisted_(transpiler);
+        transpile_loop_(transpiler, condition_, cmd_, after_);
+        return std::string();
+    }
+
+protected:
+    ExpressionNode *init_;
+    ExpressionNode *condition_;
+    ExpressionNode *after_;
+    CmdNode *cmd_;
+
+private:
+    OperatorNode *counted_(const std::vector<VariableSlot> &body_assigned);
+
+    template <class Cmp>
+    OperatorNode *counted_(const std::vector<VariableSlot> &body_assigned);
+
+    template <class Cmp, class Step>
+    OperatorNode *counted_(VariableNode *var, ExpressionNode *bound,
+                           const std::vector<VariableSlot> &body_assigned);
+};
+
+// the last value a counter going one way takes is the bound plus LAST
+template <class Cmp, class Step>
+struct CounterRange {
+    static const bool KNOWN = false;
+    static const int LAST = 0;
+};
+
+template <>
+struct CounterRange<Less, Add> {
+    static const bool KNOWN = true;
+    static const int LAST = -1;
+};
+
+template <>
+struct CounterRange<LessEq, Add> {
+    static const bool KNOWN = true;
+    static const int LAST = 0;
+};
+
+template <>
+struct CounterRange<Gr, Sub> {
+    static const bool KNOWN = true;
+    static const int LAST = 1;
+};
+
+template <>
+struct CounterRange<GrEq, Sub> {
+    static const bool KNOWN = true;
+    static const int LAST = 0;
+};
+
+// for (...; i < bound; i = i + step) where the body doesn't assign i and
+// the bound doesn't change: the counter is kept in a native int and the
+// bound is computed once
+template <class Cmp, class Step>
+class CountedForNode : public ForOperatorNode {
+public:
+    CountedForNode(ExpressionNode *init, ExpressionNode *condition,
+                   ExpressionNode *after, CmdNode *cmd,
+                   std::vector<HoistedNode *> hoisted,
+                   VariableSlot slot, ExpressionNode *bound, int step) :
+            ForOperatorNode(init, condition, after, cmd),
+            slot_(slot), bound_(bound), step_(step) {
+        hoisted_ = std::move(hoisted);
+        optimized_ = true;
+    }
+
+    // arrays the body indexes by the counter and doesn't assign; with a
+    // step small enough that the counter can't wrap before leaving them,
+    // the bytecode checks the first and the last index once and runs a
+    // copy of the loop without the checks of these arrays
+    void guard(std::vector<std::pair<VariableSlot, VariableSlot>> indexed,
+               const std::vector<VariableSlot> &body_assigned) {
+        indexed_ = std::move(indexed);
+        if (!CounterRange<Cmp, Step>::KNOWN || step_ <= 0 || step_ > MAX_ARRAY_SIZE) {
+            return;
+        }
+        for (const auto &access : indexed_) {
+            if (access.second == slot_ &&
+                std::find(body_assigned.begin(), body_assigned.end(), access.first) ==
+                body_assigned.end() &&
+                std::find(guarded_.begin(), guarded_.end(), access.first) ==
+                guarded_.end()) {
+                guarded_.push_back(access.first);
+            }
+        }
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        init_->evaluate(machine);
+        update_hoisted_(machine);
+        int bound = bound_->eval_int(machine);
+        int counter = machine.slot(slot_).get_int();
+        while (true) {
+            machine.slot(slot_) = counter;
+            if (!Cmp::apply(counter, bound)) {
+                break;
+            }
+            cmd_->evaluate(machine);
+            counter = Step::apply(counter, step_);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        int loop_mark = compiler.temps();
+        init_->compile(compiler);
+        compiler.free_temps(loop_mark);
+        compile_hoisted_(compiler);
+        int bound = bound_->compile(compiler);
+        int step = compiler.temp();
+        compiler.emit(OpCode::LOAD_INT, step, step_);
+        int var = compiler.variable(slot_);
+        if (guarded_.empty()) {
+            compile_loop_(compiler, var, bound, step);
+            compiler.free_temps(loop_mark);
+            return Compiler::NO_REG;
+        }
+        int mark = compiler.temps();
+        int last = compiler.temp();
+        int ok = compiler.temp();
+        compiler.emit(OpCode::LOAD_INT, last, CounterRange<Cmp, Step>::LAST);
+        compiler.emit(OpCode::INT_ADD, last, bound, last);
+        std::vector<int> to_checked;
+        for (auto slot : guarded_) {
+            int array = compiler.variable(slot);
+            for (int index : {var, last}) {
+                compiler.emit(OpCode::IN_BOUNDS, ok, array, index);
+                to_checked.push_back(compiler.emit(OpCode::JUMP_FALSE, ok));
+            }
+        }
+        compiler.free_temps(mark);
+        compiler.push_bounds(slot_, guarded_);
+        compile_loop_(compiler, var, bound, step);
+        compiler.pop_bounds();
+        int to_end = compiler.emit(OpCode::JUMP);
+        for (int jump : to_checked) {
+            compiler.patch(jump);
+        }
+        compile_loop_(compiler, var, bound, step);
+        compiler.patch(to_end);
+        compiler.free_temps(loop_mark);
+        return Compiler::NO_REG;
+    }
+
+    // the bound is kept by the compiled loop for the node
+    bool jit(JitCompiler &jit) override {
+        JitCompiler::Label start, end;
+        if (!init_->jit(jit) || !jit_hoisted_(jit) || !bound_->jit(jit)) {
+            return false;
+        }
+        jit.store_temporary(this);
+        jit.enter_loop();
+        jit.bind(start);
+        jit.load(slot_);
+        jit.operand_temporary(this);
+        jit.jump_unless<Cmp>(end);
+        if (!cmd_->jit(jit)) {
+            return false;
+        }
+        jit.load_int(step_);
+        jit.update<Step>(slot_);
+        jit.jump(start);
+        jit.bind(end);
+        jit.leave_loop();
+        return true;
+    }
+
+private:
+    VariableSlot slot_;
+    ExpressionNode *bound_;
+    int step_;
+    std::vector<VariableSlot> guarded_;
+
+    void compile_loop_(Compiler &compiler, int var, int bound, int step) {
+        int mark = compiler.temps();
+        int start = compiler.label();
+        int cond = compiler.temp();
+        compiler.emit(Cmp::int_opcode(), cond, var, bound);
+        compiler.free_temps(mark);
+        int to_end = compiler.emit(OpCode::JUMP_FALSE, cond);
+        cmd_->compile(compiler);
+        compiler.free_temps(mark);
+        compiler.emit(Step::int_opcode(), var, var, step);
+        compiler.emit(OpCode::JUMP, start);
+        compiler.patch(to_end);
+    }
+};
+
+inline OperatorNode *ForOperatorNode::counted_(
+        const std::vector<VariableSlot> &body_assigned) {
+    OperatorNode *node = nullptr;
+    if ((node = counted_<Less>(body_assigned)) ||
+        (node = counted_<LessEq>(body_assigned)) ||
+        (node = counted_<Gr>(body_assigned)) ||
+        (node = counted_<GrEq>(body_assigned)) ||
+        (node = counted_<NotEq>(body_assigned))) {
+        return node;
+    }
+    return nullptr;
+}
+
+template <class Cmp>
+OperatorNode *ForOperatorNode::counted_(
+        const std::vector<VariableSlot> &body_assigned) {
+    auto cond = dynamic_cast<IntBinaryOperator<Cmp> *>(condition_);
+    if (!cond || cond->left()->nodeType() != NodeType::VARIABLE) {
+        return nullptr;
+    }
+    auto var = static_cast<VariableNode *>(cond->left());
+    std::vector<VariableSlot> assigned = body_assigned;
+    assigned.push_back(var->slot());
+    if (!var->loop_invariant(body_assigned) ||
+        !cond->right()->loop_invariant(assigned)) {
+        return nullptr;
+    }
+    OperatorNode *node = nullptr;
+    auto bound = cond->right();
+    if ((node = counted_<Cmp, Add>(var, bound, body_assigned)) ||
+        (node = counted_<Cmp, Sub>(var, bound, body_assigned)) ||
+        (node = counted_<Cmp, Mul>(var, bound, body_assigned)) ||
+        (node = counted_<Cmp, Div>(var, bound, body_assigned))) {
+        return node;
+    }
+    return nullptr;
+}
+
+template <class Cmp, class Step>
+OperatorNode *ForOperatorNode::counted_(VariableNode *var, ExpressionNode *bound,
+                                        const std::vector<VariableSlot> &body_assigned) {
+    auto after = dynamic_cast<IntUpdateOperator<Step> *>(after_);
+    if (!after || !(after->slot() == var->slot())) {
+        return nullptr;
+    }
+    auto step = int_constant(after->operand());
+    if (!step || (std::is_same<Step, Div>::value && step->value() == 0)) {
+        return nullptr;
+    }
+    auto node = new CountedForNode<Cmp, Step>(
+            init_, condition_, after_, cmd_, std::move(hoisted_),
+            var->slot(), bound, step->value());
+    node->guard(std::move(indexed_), body_assigned);
+    init_ = nullptr;
+    condition_ = nullptr;
+    after_ = nullptr;
+    cmd_ = nullptr;
+    return node;
+}
+
+// a loop compiled by JitCompiler; if the code gives up, the loop it was
+// compiled from is run instead, from the start, since the code leaves the
+// variables as they were
+class NativeLoopNode : public OperatorNode {
+public:
+    NativeLoopNode(OperatorNode *loop, std::unique_ptr<NativeLoop> native) :
+            loop_(loop), native_(std::move(native)),
+            variables_(native_->variables) {}
+
+    ~NativeLoopNode() override {
+        destroy(loop_);
+    }
+
+    void print(int depth, std::ostream &out) override {
+        out << std::string(depth, '\t') << "// native\n";
+        loop_->print(depth, out);
+    }
+
+    void collect_assigned(std::vector<VariableSlot> &assigned) override {
+        loop_->collect_assigned(assigned);
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        for (const auto &input : native_->inputs) {
+            variables_[input.first] = machine.slot(input.second).get_int();
+        }
+        if (native_->code.run(variables_.data()) != 0) {
+            loop_->evaluate(machine);
+            return;
+        }
+        for (const auto &output : native_->outputs) {
+            machine.slot(output.second) = variables_[output.first];
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        return loop_->compile(compiler);
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        return loop_->transpile(transpiler);
+    }
+
+private:
+    OperatorNode *loop_;
+    std::unique_ptr<NativeLoop> native_;
+    std::vector<int> variables_;
+};
+
+inline Node *LoopOperatorNode::native_loop_(JitCompiler &jit) {
+    auto native = jit.compile(*this);
+    if (!native) {
+        return nullptr;
+    }
+    auto node = new NativeLoopNode(this, std::move(native));
+    node->set_position(line(), column());
+    return node;
+}
+
+// reduce(op: variable, ...) of a parallel for
+class ReductionListNode : public Node {
+public:
+    enum class Op {
+        ADD,
+        MUL,
+        MIN,
+        MAX,
+        AND,
+        OR,
+    };
+
+    struct Reduction {
+        Op op;
+        VariableNode *variable;
+    };
+
+    ReductionListNode() : Node(NodeType::OPERATOR) {}
+
+    ~ReductionListNode() override {
+        for (auto &reduction : reductions_) {
+            destroy(reduction.variable);
+        }
+    }
+
+    // false if there is no such operation
+    bool add(const std::string &op, const std::string &name) {
+        for (auto known : {Op::ADD, Op::MUL, Op::MIN, Op::MAX, Op::AND, Op::OR}) {
+            if (op == name_(known)) {
+                reductions_.push_back({known, new VariableNode(name)});
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const std::vector<Reduction> &reductions() const {
+        return reductions_;
+    }
+
+    void print(int depth, std::ostream &out) override {
+        if (reductions_.empty()) {
+            return;
+        }
+        out << " reduce(";
+        for (size_t i = 0; i < reductions_.size(); ++i) {
+            out << (i ? ", " : "") << name_(reductions_[i].op) << ": ";
+            reductions_[i].variable->print(depth, out);
+        }
+        out << ")";
+    }
+
+    void resolve(Resolver &resolver) override {
+        for (auto &reduction : reductions_) {
+            reduction.variable->resolve(resolver);
+        }
+    }
+
+    static int identity(Op op) {
+        switch (op) {
+            case Op::MUL:
+            case Op::AND: {
+                return 1;
+            }
+            case Op::MIN: {
+                return INT_MAX;
+            }
+            case Op::MAX: {
+                return INT_MIN;
+            }
+            default: {
+                return 0;
+            }
+        }
+    }
+
+    static int apply(Op op, int fval, int sval) {
+        switch (op) {
+            case Op::ADD: {
+                return Add::apply(fval, sval);
+            }
+            case Op::MUL: {
+                return Mul::apply(fval, sval);
+            }
+            case Op::MIN: {
+                return std::min(fval, sval);
+            }
+            case Op::MAX: {
+                return std::max(fval, sval);
+            }
+            case Op::AND: {
+                return And::apply(fval, sval);
+            }
+            case Op::OR: {
+                return Or::apply(fval, sval);
+            }
+        }
+        return fval;
+    }
+
+    // var = op(outer, var), outer is a register
+    static void compile_apply(Compiler &compiler, Op op, int var, int outer) {
+        switch (op) {
+            case Op::ADD: {
+                compiler.emit(Add::int_opcode(), var, outer, var);
+                break;
+            }
+            case Op::MUL: {
+                compiler.emit(Mul::int_opcode(), var, outer, var);
+                break;
+            }
+            case Op::AND: {
+                compiler.emit(And::int_opcode(), var, outer, var);
+                break;
+            }
+            case Op::OR: {
+                compiler.emit(Or::int_opcode(), var, outer, var);
                 break;
             }
-            case TypeIdentifyer::STRING_T: {
-                bool val_v = !val.get_str().empty();
-                machine.pop();
-                machine.push(TypeIdentifyer::INT_T);
-                *machine.top() = !val_v;
+            case Op::MIN:
+            case Op::MAX: {
+                int mark = compiler.temps();
+                int better = compiler.temp();
+                compiler.emit(op == Op::MIN ? Less::int_opcode() : Gr::int_opcode(),
+                              better, outer, var);
+                int to_end = compiler.emit(OpCode::JUMP_FALSE, better);
+                compiler.emit(OpCode::MOVE, var, outer);
+                compiler.patch(to_end);
+                compiler.free_temps(mark);
+                break;
+            }
+        }
+    }
+
+    // op(outer, var) in C++
+    static std::string transpile_apply(Op op, const std::string &var,
+                                       const std::string &outer) {
+        switch (op) {
+            case Op::MIN: {
+                return "std::min(" + outer + ", " + var + ")";
+            }
+            case Op::MAX: {
+                return "std::max(" + outer + ", " + var + ")";
             }
             default: {
-                throw std::invalid_argument(NOT_BOOL_INT);
+                return "(" + outer + " " + name_(op) + " " + var + ")";
+            }
+        }
+    }
+
+private:
+    std::vector<Reduction> reductions_;
+
+    static const char *name_(Op op) {
+        switch (op) {
+            case Op::ADD: {
+                return Add::name();
+            }
+            case Op::MUL: {
+                return Mul::name();
+            }
+            case Op::MIN: {
+                return "min";
+            }
+            case Op::MAX: {
+                return "max";
+            }
+            case Op::AND: {
+                return And::name();
+            }
+            case Op::OR: {
+                return Or::name();
             }
         }
+        return "";
     }
 };
 
-class UnaryMinusOperator : public UnaryOperator {
+// parallel for (int i = first; i < bound; i = i + step) reduce(...) cmd
+//
+// The iterations are split into chunks run by the threads of the shared
+// WorkStealingPool, each thread on a Machine of its own with a copy of the
+// frames. The body may assign only its own variables and the reduction
+// variables; these start at the identity of their operation on every
+// thread and are combined with their values from before the loop at the
+// end. What the chunks write is output in the order of the chunks, as if
+// the iterations ran one by one. Strings, input and exit() are rejected in
+// the body: string storage and the input can't be shared between threads.
+// After an error in the body the reduction variables are left unspecified.
+//
+// The loop runs on the calling thread alone while the pool is busy or the
+// profiler is on, and always in the bytecode engine, with the same
+// reductions.
+class ParallelForNode : public OperatorNode {
 public:
-    explicit UnaryMinusOperator(ExpressionNode *arg) :
-            UnaryOperator(arg, "-") {}
+    ParallelForNode(ExpressionNode *init, ExpressionNode *condition,
+                    ExpressionNode *after, ReductionListNode *reductions,
+                    CmdNode *cmd) :
+            init_(init), condition_(condition), after_(after),
+            reductions_(reductions), cmd_(cmd) {}
+
+    ~ParallelForNode() override {
+        destroy(init_);
+        destroy(condition_);
+        destroy(after_);
+        destroy(bound_);
+        destroy(reductions_);
+        destroy(cmd_);
+    }
+
+    void print(int depth, std::ostream &out) override {
+        auto tab = std::string(depth, '\t');
+        out << tab << "parallel for (";
+        init_->print(depth, out);
+        out << ";";
+        if (bound_) {
+            auto var = counter_->name();
+            out << var << " " << (step_ > 0 ? "<" : ">") << (inclusive_ ? "=" : "")
+                << " ";
+            BinaryOperator::print_operand(bound_, depth, out);
+            out << ";" << var << " = " << var << (step_ > 0 ? " + " : " - ")
+                << std::abs(static_cast<long long>(step_));
+        } else {
+            condition_->print(depth, out);
+            out << ";";
+            after_->print(depth, out);
+        }
+        out << ")";
+        reductions_->print(depth, out);
+        out << "\n";
+        cmd_->print(depth, out);
+    }
+
+    void resolve(Resolver &resolver) override {
+        init_->resolve(resolver);
+        condition_->resolve(resolver);
+        after_->resolve(resolver);
+        reductions_->resolve(resolver);
+        cmd_->resolve(resolver);
+    }
+
+    OperatorNode *check(TypeChecker &checker) override {
+        checker.check(init_);
+        {
+            TypeChecker::Parallel parallel(checker);
+            checker.check_condition(condition_);
+            checker.check(after_);
+            checker.check(cmd_);
+        }
+        split_();
+        check_assigned_();
+        sequential_ = Profiler::current() != nullptr;
+        return this;
+    }
+
+    OperatorNode *optimize(Optimizer &optimizer) override {
+        if (optimized_) {
+            return this;
+        }
+        optimized_ = true;
+        optimizer.optimize(init_);
+        optimizer.optimize(bound_);
+        optimizer.enter_parallel();
+        optimizer.optimize(cmd_);
+        optimizer.leave_parallel();
+        return this;
+    }
+
+    void collect_assigned(std::vector<VariableSlot> &assigned) override {
+        init_->collect_assigned(assigned);
+        for (auto &reduction : reductions_->reductions()) {
+            assigned.push_back(reduction.variable->slot());
+        }
+        cmd_->collect_assigned(assigned);
+    }
 
     void evaluate(Machine &machine) override {
-        UnaryOperator::evaluate(machine);
-        auto &val = machine.top();
-        if (val.type() != TypeIdentifyer::INT_T) {
-            throw std::invalid_argument(NOT_INT);
+        count_evaluation_(machine, this);
+        init_->evaluate(machine);
+        int first = machine.slot(counter_->slot()).get_int();
+        int64_t count = iterations_(first, bound_->eval_int(machine));
+        auto &pool = WorkStealingPool::shared();
+        if (sequential_ || count < 2 || pool.workers() < 2 ||
+            !run_parallel_(machine, pool, first, count)) {
+            run_sequential_(machine, first, count);
+        }
+    }
+
+    int compile(Compiler &compiler) override {
+        int loop_mark = compiler.temps();
+        init_->compile(compiler);
+        compiler.free_temps(loop_mark);
+        std::vector<int> outer;
+        for (auto &reduction : reductions_->reductions()) {
+            int reg = compiler.temp();
+            int var = reduction.variable->compile(compiler);
+            compiler.emit(OpCode::MOVE, reg, var);
+            compiler.emit(OpCode::LOAD_INT, var, ReductionListNode::identity(reduction.op));
+            outer.push_back(reg);
+        }
+        int bound = bound_->compile(compiler);
+        int step = compiler.temp();
+        compiler.emit(OpCode::LOAD_INT, step, step_);
+        int var = counter_->compile(compiler);
+        int mark = compiler.temps();
+        int start = compiler.label();
+        int cond = compiler.temp();
+        OpCode cmp = step_ > 0 ? (inclusive_ ? OpCode::INT_LESS_EQ : OpCode::INT_LESS)
+                               : (inclusive_ ? OpCode::INT_GR_EQ : OpCode::INT_GR);
+        compiler.emit(cmp, cond, var, bound);
+        compiler.free_temps(mark);
+        int to_end = compiler.emit(OpCode::JUMP_FALSE, cond);
+        cmd_->compile(compiler);
+        compiler.free_temps(mark);
+        compiler.emit(OpCode::INT_ADD, var, var, step);
+        compiler.emit(OpCode::JUMP, start);
+        compiler.patch(to_end);
+        for (size_t i = 0; i < outer.size(); ++i) {
+            auto &reduction = reductions_->reductions()[i];
+            ReductionListNode::compile_apply(compiler, reduction.op,
+                                             reduction.variable->compile(compiler),
+                                             outer[i]);
+        }
+        compiler.free_temps(loop_mark);
+        return Compiler::NO_REG;
+    }
+
+    // the iterations run one by one, in the order of run_sequential_()
+    std::string transpile(Transpiler &transpiler) override {
+        init_->transpile(transpiler);
+        auto counter = counter_->transpile(transpiler);
+        auto first = transpiler.temporary(TypeIdentifyer::INT_T, counter);
+        auto bound = bound_->transpile(transpiler);
+        auto count = transpiler.temporary(
+                "int64_t", "loop_iterations(" + first + ", " + bound + ", " +
+                           Transpiler::literal(step_) + ", " +
+                           (inclusive_ ? "true" : "false") + ")");
+        std::vector<std::string> outer;
+        for (auto &reduction : reductions_->reductions()) {
+            auto var = reduction.variable->transpile(transpiler);
+            outer.push_back(transpiler.temporary(TypeIdentifyer::INT_T, var));
+            transpiler.line(var + " = " + Transpiler::literal(
+                    ReductionListNode::identity(reduction.op)) + ";");
+        }
+        auto k = transpiler.name();
+        transpiler.open("for (int64_t " + k + " = 0; " + k + " < " + count + "; ++" + k + ")");
+        transpiler.line(counter + " = static_cast<int>(" + first + " + " + k + " * " +
+                        Transpiler::literal(step_) + ");");
+        cmd_->transpile(transpiler);
+        transpiler.close();
+        for (size_t i = 0; i < outer.size(); ++i) {
+            auto &reduction = reductions_->reductions()[i];
+            auto var = reduction.variable->transpile(transpiler);
+            transpiler.line(var + " = " + ReductionListNode::transpile_apply(
+                    reduction.op, var, outer[i]) + ";");
+        }
+        return std::string();
+    }
+
+private:
+    static const size_t CHUNKS_PER_WORKER = 8;
+
+    ExpressionNode *init_;
+    ExpressionNode *condition_;
+    ExpressionNode *after_;
+    ReductionListNode *reductions_;
+    CmdNode *cmd_;
+
+    // the loop taken apart by check()
+    VariableNode *counter_ = nullptr;
+    ExpressionNode *bound_ = nullptr;
+    bool inclusive_ = false;
+    int step_ = 0; // negative if the counter goes down
+    bool sequential_ = false;
+    bool optimized_ = false;
+
+    // a thread's machine, writing to a string for each chunk
+    struct Worker {
+        std::istringstream in;
+        std::ostringstream out;
+        Machine machine;
+
+        explicit Worker(const Machine &caller) : machine(in, out) {
+            machine.copy_frames(caller);
+        }
+
+        std::string take_output() {
+            machine.flush();
+            auto output = out.str();
+            out.str(std::string());
+            return output;
+        }
+    };
+
+    void split_() {
+        auto init = dynamic_cast<CreateOperator *>(init_);
+        if (!init || !init->expression() ||
+            init->variable()->value_type() != TypeIdentifyer::INT_T) {
+            throw std::invalid_argument("Parallel for must start with int declaration");
+        }
+        counter_ = init->variable();
+        if (!split_condition_<Less>(false) && !split_condition_<LessEq>(true) &&
+            !split_condition_<Gr>(false) && !split_condition_<GrEq>(true)) {
+            throw std::invalid_argument("Parallel for must compare its counter with <, <=, > or >=");
+        }
+        bool up = step_ > 0;
+        if (!split_step_<Add>(1) && !split_step_<Sub>(-1)) {
+            throw std::invalid_argument("Parallel for must step its counter by a constant");
+        }
+        if (up != (step_ > 0)) {
+            throw std::invalid_argument("Parallel for steps its counter away from the bound");
+        }
+        destroy(condition_);
+        destroy(after_);
+        condition_ = nullptr;
+        after_ = nullptr;
+    }
+
+    bool is_counter_(ExpressionNode *node) const {
+        return node->nodeType() == NodeType::VARIABLE &&
+               static_cast<VariableNode *>(node)->same(*counter_);
+    }
+
+    // takes the bound out of the condition, step_ is set to the direction
+    template <class Cmp>
+    bool split_condition_(bool inclusive) {
+        auto cond = dynamic_cast<IntBinaryOperator<Cmp> *>(condition_);
+        if (!cond || !is_counter_(cond->left())) {
+            return false;
+        }
+        bound_ = cond->take_right();
+        inclusive_ = inclusive;
+        step_ = std::is_same<Cmp, Less>::value || std::is_same<Cmp, LessEq>::value ? 1 : -1;
+        return true;
+    }
+
+    template <class Op>
+    bool split_step_(int sign) {
+        auto after = dynamic_cast<IntAssignOperator *>(after_);
+        auto op = after ? dynamic_cast<IntBinaryOperator<Op> *>(after->expression()) : nullptr;
+        if (!op || !after->variable()->same(*counter_) || !is_counter_(op->left())) {
+            return false;
+        }
+        auto step = int_constant(op->right());
+        if (!step || step->value() <= 0) {
+            return false;
+        }
+        step_ = sign * step->value();
+        return true;
+    }
+
+    // variables declared outside of the loop can be changed only through
+    // the reductions, so the iterations don't depend on each other
+    void check_assigned_() {
+        int depth = counter_->slot().depth;
+        std::vector<VariableSlot> reduced;
+        for (auto &reduction : reductions_->reductions()) {
+            auto var = reduction.variable;
+            if (var->value_type() != TypeIdentifyer::INT_T) {
+                throw std::invalid_argument("Reduction variable " + var->name() + " is not int");
+            }
+            if (var->same(*counter_)) {
+                throw std::invalid_argument("Counter of parallel for can't be reduced");
+            }
+            if (std::find(reduced.begin(), reduced.end(), var->slot()) != reduced.end()) {
+                throw std::invalid_argument("Variable " + var->name() + " is reduced twice");
+            }
+            reduced.push_back(var->slot());
+        }
+        std::vector<VariableSlot> assigned;
+        cmd_->collect_assigned(assigned);
+        for (auto slot : assigned) {
+            if (slot == counter_->slot()) {
+                throw std::invalid_argument("Counter of parallel for is assigned in its body");
+            }
+            if (slot.depth < depth &&
+                std::find(reduced.begin(), reduced.end(), slot) == reduced.end()) {
+                throw std::invalid_argument("Parallel for assigns a variable declared outside of it");
+            }
+        }
+    }
+
+    int64_t iterations_(int first, int bound) const {
+        return loop_iterations(first, bound, step_, inclusive_);
+    }
+
+    // runs iterations [begin, end) on the machine
+    void run_iterations_(Machine &machine, int first, int64_t begin, int64_t end) {
+        auto slot = counter_->slot();
+        for (int64_t k = begin; k < end; ++k) {
+            machine.slot(slot) = static_cast<int>(first + k * step_);
+            cmd_->evaluate(machine);
+        }
+    }
+
+    std::vector<int> start_reductions_(Machine &machine) {
+        std::vector<int> outer;
+        for (auto &reduction : reductions_->reductions()) {
+            auto &var = machine.slot(reduction.variable->slot());
+            outer.push_back(var.get_int());
+            var = ReductionListNode::identity(reduction.op);
+        }
+        return outer;
+    }
+
+    void run_sequential_(Machine &machine, int first, int64_t count) {
+        auto outer = start_reductions_(machine);
+        auto &reductions = reductions_->reductions();
+        run_iterations_(machine, first, 0, count);
+        for (size_t i = 0; i < reductions.size(); ++i) {
+            auto &var = machine.slot(reductions[i].variable->slot());
+            var = ReductionListNode::apply(reductions[i].op, outer[i], var.get_int());
         }
-        int val_v = *val;
-        machine.pop();
-        machine.push(TypeIdentifyer::INT_T);
-        *machine.top() = -val_v;
+    }
+
+    // false if the pool is busy
+    bool run_parallel_(Machine &machine, WorkStealingPool &pool, int first,
+                       int64_t count) {
+        size_t chunks = static_cast<size_t>(
+                std::min<int64_t>(count, pool.workers() * CHUNKS_PER_WORKER));
+        std::vector<std::unique_ptr<Worker>> workers(pool.workers());
+        std::vector<std::string> output(chunks);
+        std::vector<char> done(chunks, false);
+        auto &reductions = reductions_->reductions();
+        // workers are made on their threads, reading the caller's frames
+        auto job = [&](size_t index, size_t chunk) {
+            auto &worker = workers[index];
+            if (!worker) {
+                worker.reset(new Worker(machine));
+                for (auto &reduction : reductions) {
+                    worker->machine.slot(reduction.variable->slot()) =
+                            ReductionListNode::identity(reduction.op);
+                }
+            }
+            try {
+                run_iterations_(worker->machine, first, count * chunk / chunks,
+                                count * (chunk + 1) / chunks);
+            } catch (...) {
+                output[chunk] = worker->take_output();
+                throw;
+            }
+            output[chunk] = worker->take_output();
+            done[chunk] = true;
+        };
+        std::exception_ptr error;
+        try {
+            if (!pool.run(chunks, job)) {
+                return false;
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        // up to and with the chunk that failed
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            machine.write(output[chunk]);
+            if (!done[chunk]) {
+                break;
+            }
+        }
+        for (auto &worker : workers) {
+            if (worker) {
+                machine.metrics().add(worker->machine.metrics());
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        for (auto &reduction : reductions) {
+            auto &var = machine.slot(reduction.variable->slot());
+            for (auto &worker : workers) {
+                if (worker) {
+                    var = ReductionListNode::apply(
+                            reduction.op, var.get_int(),
+                            worker->machine.slot(reduction.variable->slot()).get_int());
+                }
+            }
+        }
+        return true;
     }
 };
 
-class PlusOperator : public BinaryOperator {
+// int[size] and string[size], of zeros and empty strings
+class NewArrayNode : public OperatorNode {
 public:
-    PlusOperator(ExpressionNode *left, ExpressionNode *right) :
-            BinaryOperator(left, right, "+") {}
+    NewArrayNode(TypeIdentifyer element, ExpressionNode *size) : size_(size) {
+        value_type_ = array_type(element);
+    }
 
-    void evaluate(Machine &machine) override {
-        BinaryOperator::evaluate(machine);
-        auto &fval = machine.top(1);
-        auto &sval = machine.top(0);
-        if (fval.type() == TypeIdentifyer::INT_T &&
-            sval.type() == TypeIdentifyer::INT_T) {
-            int fval_v = *fval;
-            int sval_v = *sval;
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v + sval_v;
-        } else if (fval.type() == TypeIdentifyer::STRING_T &&
-                   sval.type() == TypeIdentifyer::STRING_T) {
-            std::string fval_v = fval.get_str();
-            std::string sval_v = sval.get_str();
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::STRING_T);
-            machine.top().load_str(fval_v + sval_v);
-        } else {
+    ~NewArrayNode() override {
+        destroy(size_);
+    }
+
+    void print(int depth, std::ostream &out) override {
+        out << (value_type_ == TypeIdentifyer::INT_ARRAY_T ? "int[" : "string[");
+        size_->print(depth, out);
+        out << "]";
+    }
+
+    void resolve(Resolver &resolver) override {
+        size_->resolve(resolver);
+    }
+
+    OperatorNode *check(TypeChecker &checker) override {
+        checker.check_value(size_);
+        if (size_->value_type() != TypeIdentifyer::INT_T) {
             throw std::invalid_argument(NOT_INT);
         }
+        return this;
+    }
+
+    OperatorNode *optimize(Optimizer &optimizer) override {
+        optimizer.optimize(size_);
+        return this;
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        Value array(value_type_);
+        array.load_array(value_type_, size_->eval_int(machine));
+        machine.push(array);
+    }
+
+    int compile(Compiler &compiler) override {
+        int mark = compiler.temps();
+        int size = size_->compile(compiler);
+        compiler.free_temps(mark);
+        int reg = compiler.temp();
+        compiler.emit(OpCode::NEW_ARRAY, reg, size, static_cast<int>(value_type_));
+        return reg;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        auto size = size_->transpile(transpiler);
+        bool ints = value_type_ == TypeIdentifyer::INT_ARRAY_T;
+        return transpiler.movable(value_type_, std::string("make_array<") +
+                                               (ints ? "int" : "std::string") + ">(" + size + ")");
     }
+
+private:
+    ExpressionNode *size_;
 };
 
-class MinusOperator : public BinaryOperator {
+// array[index] of an array variable
+class IndexNode : public OperatorNode {
 public:
-    MinusOperator(ExpressionNode *left, ExpressionNode *right) :
-            BinaryOperator(left, right, "-") {}
+    IndexNode(VariableNode *array, ExpressionNode *index) :
+            array_(array), index_(index) {}
+
+    ~IndexNode() override {
+        destroy(array_);
+        destroy(index_);
+    }
+
+    void print(int depth, std::ostream &out) override {
+        array_->print(depth, out);
+        out << "[";
+        index_->print(depth, out);
+        out << "]";
+    }
+
+    void resolve(Resolver &resolver) override {
+        array_->resolve(resolver);
+        index_->resolve(resolver);
+    }
+
+    OperatorNode *check(TypeChecker &checker) override {
+        ExpressionNode *array = array_;
+        checker.check_value(array);
+        if (!is_array(array_->value_type())) {
+            throw std::invalid_argument(NOT_ARRAY);
+        }
+        checker.check_value(index_);
+        if (index_->value_type() != TypeIdentifyer::INT_T) {
+            throw std::invalid_argument(NOT_INT);
+        }
+        value_type_ = element_type(array_->value_type());
+        return this;
+    }
+
+    OperatorNode *optimize(Optimizer &optimizer) override {
+        optimizer.optimize(index_);
+        if (index_->nodeType() == NodeType::VARIABLE) {
+            optimizer.indexed(array_->slot(), static_cast<VariableNode *>(index_)->slot());
+        }
+        return this;
+    }
 
     void evaluate(Machine &machine) override {
-        BinaryOperator::evaluate(machine);
-        auto &fval = machine.top(1);
-        auto &sval = machine.top(0);
-        if (fval.type() == TypeIdentifyer::INT_T &&
-            sval.type() == TypeIdentifyer::INT_T) {
-            int fval_v = *fval;
-            int sval_v = *sval;
-            machine.pop();
-            machine.pop();
+        count_evaluation_(machine, this);
+        int index = index_->eval_int(machine);
+        const auto &array = machine.slot(array_->slot());
+        if (value_type_ == TypeIdentifyer::INT_T) {
+            const auto &items = array.ints();
+            check_index(index, items.size());
             machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v - sval_v;
+            *machine.top() = items[index];
         } else {
-            throw std::invalid_argument(NOT_INT);
+            const auto &items = array.strs();
+            check_index(index, items.size());
+            machine.push(items[index]);
         }
     }
+
+    int eval_int(Machine &machine) override {
+        count_evaluation_(machine, this);
+        int index = index_->eval_int(machine);
+        const auto &items = machine.slot(array_->slot()).ints();
+        check_index(index, items.size());
+        return items[index];
+    }
+
+    // without the check inside a loop that checked the bounds on entry
+    int compile(Compiler &compiler) override {
+        int mark = compiler.temps();
+        int index = index_->compile(compiler);
+        compiler.free_temps(mark);
+        int reg = compiler.temp();
+        compiler.emit(unchecked_(compiler) ? OpCode::INDEX_UNCHECKED : OpCode::INDEX,
+                      reg, array_->compile(compiler), index);
+        return reg;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        auto index = index_->transpile(transpiler);
+        return transpiler.temporary(value_type_, "array_at(" + array_->transpile(transpiler) +
+                                                 ", " + index + ")");
+    }
+
+private:
+    VariableNode *array_;
+    ExpressionNode *index_;
+
+    bool unchecked_(Compiler &compiler) const {
+        return index_->nodeType() == NodeType::VARIABLE &&
+               compiler.in_bounds(array_->slot(), static_cast<VariableNode *>(index_)->slot());
+    }
 };
 
-class MultOperator : public BinaryOperator {
+// array[index] = value; the array keeps its size, so it isn't assigned for
+// the loop optimizations
+class StoreIndexNode : public OperatorNode {
 public:
-    MultOperator(ExpressionNode *left, ExpressionNode *right) :
-            BinaryOperator(left, right, "*") {}
+    StoreIndexNode(VariableNode *array, ExpressionNode *index, ExpressionNode *value) :
+            OperatorNode("="), array_(array), index_(index), value_(value) {}
 
-    void evaluate(Machine &machine) override {
-        BinaryOperator::evaluate(machine);
-        auto &fval = machine.top(1);
-        auto &sval = machine.top(0);
-        if (fval.type() == TypeIdentifyer::INT_T &&
-            sval.type() == TypeIdentifyer::INT_T) {
-            int fval_v = *fval;
-            int sval_v = *sval;
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v * sval_v;
-        } else if ((fval.type() == TypeIdentifyer::STRING_T &&
-                    sval.type() == TypeIdentifyer::INT_T) ||
-                    (fval.type() == TypeIdentifyer::INT_T &&
-                    sval.type() ==  TypeIdentifyer::STRING_T)) {
-            if (sval.type() == TypeIdentifyer::STRING_T) {
-                std::swap(fval, sval);
-            }
-            std::string fval_v = fval.get_str();
-            int sval_v = *sval;
-            machine.pop();
-            machine.pop();
-            std::string result;
-            for (int i = 0; i < sval_v; ++i) {
-                result += fval_v;
-            }
-            machine.push(TypeIdentifyer::STRING_T);
-            machine.top().load_str(result);
-        } else {
+    ~StoreIndexNode() override {
+        destroy(array_);
+        destroy(index_);
+        destroy(value_);
+    }
+
+    void print(int depth, std::ostream &out) override {
+        array_->print(depth, out);
+        out << "[";
+        index_->print(depth, out);
+        out << "] ";
+        OperatorNode::print(depth, out);
+        out << " ";
+        value_->print(depth, out);
+    }
+
+    bool has_value() const override {
+        return false;
+    }
+
+    void resolve(Resolver &resolver) override {
+        array_->resolve(resolver);
+        index_->resolve(resolver);
+        value_->resolve(resolver);
+    }
+
+    OperatorNode *check(TypeChecker &checker) override {
+        ExpressionNode *array = array_;
+        checker.check_value(array);
+        if (!is_array(array_->value_type())) {
+            throw std::invalid_argument(NOT_ARRAY);
+        }
+        checker.check_value(index_);
+        if (index_->value_type() != TypeIdentifyer::INT_T) {
             throw std::invalid_argument(NOT_INT);
         }
+        checker.check_value(value_);
+        if (value_->value_type() != element_type(array_->value_type())) {
+            throw std::invalid_argument(VAR_NEQ_EXPR);
+        }
+        return this;
+    }
+
+    OperatorNode *optimize(Optimizer &optimizer) override {
+        optimizer.optimize(index_);
+        optimizer.optimize(value_);
+        if (index_->nodeType() == NodeType::VARIABLE) {
+            optimizer.indexed(array_->slot(), static_cast<VariableNode *>(index_)->slot());
+        }
+        return this;
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        int index = index_->eval_int(machine);
+        if (value_->value_type() == TypeIdentifyer::INT_T) {
+            int val = value_->eval_int(machine);
+            auto &array = machine.slot(array_->slot());
+            check_index(index, array.ints().size());
+            array.get_ints()[index] = val;
+            return;
+        }
+        value_->evaluate(machine);
+        auto &array = machine.slot(array_->slot());
+        check_index(index, array.strs().size());
+        array.get_strs()[index] = machine.top();
+        machine.pop();
+    }
+
+    int compile(Compiler &compiler) override {
+        int mark = compiler.temps();
+        int index = index_->compile(compiler);
+        int val = value_->compile(compiler);
+        bool unchecked = index_->nodeType() == NodeType::VARIABLE &&
+                         compiler.in_bounds(array_->slot(),
+                                            static_cast<VariableNode *>(index_)->slot());
+        compiler.emit(unchecked ? OpCode::STORE_INDEX_UNCHECKED : OpCode::STORE_INDEX,
+                      array_->compile(compiler), index, val);
+        compiler.free_temps(mark);
+        return Compiler::NO_REG;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        auto index = index_->transpile(transpiler);
+        auto val = value_->transpile(transpiler);
+        transpiler.line("array_at(" + array_->transpile(transpiler) + ", " + index + ") = " +
+                        val + ";");
+        return std::string();
     }
+
+private:
+    VariableNode *array_;
+    ExpressionNode *index_;
+    ExpressionNode *value_;
 };
 
-class DivideOperator : public BinaryOperator {
+// size(array), sum(array), min(array), max(array), count(array, value) and
+// fill(array, value); sum, min and max take int arrays, sum is a long, size
+// also takes a map
+class ArrayFunctionNode : public OperatorNode {
 public:
-    DivideOperator(ExpressionNode *left, ExpressionNode *right) :
-            BinaryOperator(left, right, "/") {}
-
-    void evaluate(Machine &machine) override {
-        BinaryOperator::evaluate(machine);
-        auto &fval = machine.top(1);
-        auto &sval = machine.top(0);
-        if (fval.type() == TypeIdentifyer::INT_T &&
-            sval.type() == TypeIdentifyer::INT_T) {
-            int fval_v = *fval;
-            int sval_v = *sval;
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            if (sval_v == 0) {
-                throw std::runtime_error("Division by zero.");
+    enum class Function {
+        SIZE,
+        SUM,
+        MIN,
+        MAX,
+        COUNT,
+        FILL,
+    };
+
+    ArrayFunctionNode(Function function, ExpressionNode *array, ExpressionNode *arg) :
+            function_(function), array_(array), arg_(arg) {}
+
+    // nullptr if there is no such function of these arguments
+    static ArrayFunctionNode *make(const std::string &name, ExpressionNode *array,
+                                   ExpressionNode *arg = nullptr) {
+        for (int i = 0; i < FUNCTIONS; ++i) {
+            auto function = static_cast<Function>(i);
+            if (name == names_(function) && (arg != nullptr) == binary_(function)) {
+                return new ArrayFunctionNode(function, array, arg);
             }
-            *machine.top() = fval_v / sval_v;
-        } else {
-            throw std::invalid_argument(NOT_INT);
         }
+        return nullptr;
     }
-};
 
-class ModOperator : public BinaryOperator {
-public:
-    ModOperator(ExpressionNode *left, ExpressionNode *right) :
-            BinaryOperator(left, right, "/") {}
+    ~ArrayFunctionNode() override {
+        destroy(array_);
+        destroy(arg_);
+    }
 
-    void evaluate(Machine &machine) override {
-        BinaryOperator::evaluate(machine);
-        auto &fval = machine.top(1);
-        auto &sval = machine.top(0);
-        if (fval.type() == TypeIdentifyer::INT_T &&
-            sval.type() == TypeIdentifyer::INT_T) {
-            int fval_v = *fval;
-            int sval_v = *sval;
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            if (sval_v == 0) {
-                throw std::runtime_error("Division by zero.");
-            }
-            *machine.top() = fval_v % sval_v;
-        } else {
+    void print(int depth, std::ostream &out) override {
+        out << names_(function_) << "(";
+        array_->print(depth, out);
+        if (arg_) {
+            out << ", ";
+            arg_->print(depth, out);
+        }
+        out << ")";
+    }
+
+    bool has_value() const override {
+        return function_ != Function::FILL;
+    }
+
+    void resolve(Resolver &resolver) override {
+        array_->resolve(resolver);
+        if (arg_) {
+            arg_->resolve(resolver);
+        }
+    }
+
+    OperatorNode *check(TypeChecker &checker) override {
+        checker.check_value(array_);
+        auto type = array_->value_type();
+        if (!is_array(type) && !(function_ == Function::SIZE && is_map(type))) {
+            throw std::invalid_argument(NOT_ARRAY);
+        }
+        if ((function_ == Function::SUM || function_ == Function::MIN ||
+             function_ == Function::MAX) && type != TypeIdentifyer::INT_ARRAY_T) {
             throw std::invalid_argument(NOT_INT);
         }
+        if (function_ == Function::FILL && array_->nodeType() != NodeType::VARIABLE) {
+            throw std::invalid_argument("fill() needs an array variable");
+        }
+        if (arg_) {
+            checker.check_value(arg_);
+            if (arg_->value_type() != element_type(type)) {
+                throw std::invalid_argument(VAR_NEQ_EXPR);
+            }
+        }
+        value_type_ = function_ == Function::SUM ? TypeIdentifyer::LONG_T
+                                                 : TypeIdentifyer::INT_T;
+        return this;
     }
-};
 
+    OperatorNode *optimize(Optimizer &optimizer) override {
+        optimizer.optimize(array_);
+        if (arg_) {
+            optimizer.optimize(arg_);
+        }
+        return this;
+    }
 
-class AndOperator : public BinaryOperator {
-public:
-    AndOperator(ExpressionNode *left, ExpressionNode *right) :
-            BinaryOperator(left, right, "&&") {}
+    // the size of an array that isn't assigned can bound a counted loop, a
+    // map grows without being assigned
+    bool loop_invariant(const std::vector<VariableSlot> &assigned) const override {
+        return function_ == Function::SIZE && is_array(array_->value_type()) &&
+               array_->loop_invariant(assigned);
+    }
 
     void evaluate(Machine &machine) override {
-        BinaryOperator::evaluate(machine);
-        auto &fval = machine.top(1);
-        auto &sval = machine.top(0);
-        if (fval.type() == TypeIdentifyer::INT_T &&
-            sval.type() == TypeIdentifyer::INT_T) {
-            int fval_v = *fval;
-            int sval_v = *sval;
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v && sval_v;
+        count_evaluation_(machine, this);
+        if (function_ == Function::FILL) {
+            fill_(machine);
+        } else if (function_ == Function::SUM) {
+            Long sum = sum_(machine);
+            machine.push(TypeIdentifyer::LONG_T);
+            machine.top().load_long(std::move(sum));
         } else {
-            throw std::invalid_argument(NOT_BOOL_INT);
+            int result = int_(machine);
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = result;
         }
     }
-};
 
-class OrOperator : public BinaryOperator {
-public:
-    OrOperator(ExpressionNode *left, ExpressionNode *right) :
-            BinaryOperator(left, right, "||") {}
+    int eval_int(Machine &machine) override {
+        count_evaluation_(machine, this);
+        return int_(machine);
+    }
 
-    void evaluate(Machine &machine) override {
-        BinaryOperator::evaluate(machine);
-        auto &fval = machine.top(1);
-        auto &sval = machine.top(0);
-        if (fval.type() == TypeIdentifyer::INT_T &&
-            sval.type() == TypeIdentifyer::INT_T) {
-            int fval_v = *fval;
-            int sval_v = *sval;
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v || sval_v;
-        } else {
-            throw std::invalid_argument(NOT_BOOL_INT);
+    Long eval_long(Machine &machine) override {
+        count_evaluation_(machine, this);
+        return sum_(machine);
+    }
+
+    int compile(Compiler &compiler) override {
+        int mark = compiler.temps();
+        int array = array_->compile(compiler);
+        int arg = arg_ ? arg_->compile(compiler) : 0;
+        compiler.free_temps(mark);
+        if (function_ == Function::FILL) {
+            compiler.emit(OpCode::ARRAY_FILL, array, arg);
+            return Compiler::NO_REG;
         }
+        static const OpCode OPCODES[] = {OpCode::ARRAY_SIZE, OpCode::ARRAY_SUM,
+                                         OpCode::ARRAY_MIN, OpCode::ARRAY_MAX,
+                                         OpCode::ARRAY_COUNT};
+        int reg = compiler.temp();
+        compiler.emit(OPCODES[static_cast<int>(function_)], reg, array, arg);
+        return reg;
     }
-};
 
-class EqOperator : public BinaryOperator {
-public:
-    EqOperator(ExpressionNode *left, ExpressionNode *right) :
-            BinaryOperator(left, right, "==") {}
+    std::string transpile(Transpiler &transpiler) override {
+        auto array = array_->transpile(transpiler);
+        auto arg = arg_ ? arg_->transpile(transpiler) : std::string();
+        switch (function_) {
+            case Function::SIZE:
+                return "static_cast<int>(" + array + ".size())";
+            case Function::SUM:
+                return "Long(array_sum(" + array + "))";
+            case Function::MIN:
+                return transpiler.temporary(TypeIdentifyer::INT_T, "array_min(" + array + ")");
+            case Function::MAX:
+                return transpiler.temporary(TypeIdentifyer::INT_T, "array_max(" + array + ")");
+            case Function::COUNT:
+                return "array_count(" + array + ", " + arg + ")";
+            default:
+                transpiler.line("array_fill(" + array + ", " + arg + ");");
+                return std::string();
+        }
+    }
 
-    void evaluate(Machine &machine) override {
-        BinaryOperator::evaluate(machine);
-        auto &fval = machine.top(1);
-        auto &sval = machine.top(0);
-        if (fval.type() == TypeIdentifyer::INT_T &&
-            sval.type() == TypeIdentifyer::INT_T) {
-            int fval_v = *fval;
-            int sval_v = *sval;
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v == sval_v;
-        } else if (fval.type() == TypeIdentifyer::STRING_T &&
-                   sval.type() == TypeIdentifyer::STRING_T) {
-            std::string fval_v = fval.get_str();
-            std::string sval_v = sval.get_str();
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v == sval_v;
-        } else {
-            throw std::invalid_argument(NOT_INT);
+private:
+    static const int FUNCTIONS = 6;
+
+    Function function_;
+    ExpressionNode *array_;
+    ExpressionNode *arg_;
+
+    static const char *names_(Function function) {
+        static const char *const NAMES[] = {"size", "sum", "min", "max", "count", "fill"};
+        return NAMES[static_cast<int>(function)];
+    }
+
+    static bool binary_(Function function) {
+        return function == Function::COUNT || function == Function::FILL;
+    }
+
+    // the array is on the stack while the function runs
+    int int_(Machine &machine) {
+        array_->evaluate(machine);
+        int result = 0;
+        switch (function_) {
+            case Function::SIZE:
+                result = size_(machine.top());
+                break;
+            case Function::MIN:
+                result = array_min(machine.top().ints());
+                break;
+            case Function::MAX:
+                result = array_max(machine.top().ints());
+                break;
+            default:
+                if (is_int_array_()) {
+                    int val = arg_->eval_int(machine);
+                    result = array_count(machine.top().ints(), val);
+                } else {
+                    arg_->evaluate(machine);
+                    result = array_count(machine.top(1).strs(), machine.top());
+                    machine.pop();
+                }
         }
+        machine.pop();
+        return result;
     }
-};
 
-class NotEqOperator : public BinaryOperator {
-public:
-    NotEqOperator(ExpressionNode *left, ExpressionNode *right) :
-            BinaryOperator(left, right, "!=") {}
+    Long sum_(Machine &machine) {
+        array_->evaluate(machine);
+        Long sum(array_sum(machine.top().ints()));
+        machine.pop();
+        return sum;
+    }
 
-    void evaluate(Machine &machine) override {
-        BinaryOperator::evaluate(machine);
-        auto &fval = machine.top(1);
-        auto &sval = machine.top(0);
-        if (fval.type() == TypeIdentifyer::INT_T &&
-            sval.type() == TypeIdentifyer::INT_T) {
-            int fval_v = *fval;
-            int sval_v = *sval;
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v != sval_v;
-        } else if (fval.type() == TypeIdentifyer::STRING_T &&
-                   sval.type() == TypeIdentifyer::STRING_T) {
-            std::string fval_v = fval.get_str();
-            std::string sval_v = sval.get_str();
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v != sval_v;
-        } else {
-            throw std::invalid_argument(NOT_INT);
+    void fill_(Machine &machine) {
+        auto slot = static_cast<VariableNode *>(array_)->slot();
+        if (is_int_array_()) {
+            int val = arg_->eval_int(machine);
+            array_fill(machine.slot(slot).get_ints(), val);
+            return;
         }
+        arg_->evaluate(machine);
+        array_fill(machine.slot(slot).get_strs(), machine.top());
+        machine.pop();
     }
-};
 
-class LessOperator : public BinaryOperator {
-public:
-    LessOperator(ExpressionNode *left, ExpressionNode *right) :
-            BinaryOperator(left, right, "<") {}
+    bool is_int_array_() const {
+        return array_->value_type() == TypeIdentifyer::INT_ARRAY_T;
+    }
 
-    void evaluate(Machine &machine) override {
-        BinaryOperator::evaluate(machine);
-        auto &fval = machine.top(1);
-        auto &sval = machine.top(0);
-        if (fval.type() == TypeIdentifyer::INT_T &&
-            sval.type() == TypeIdentifyer::INT_T) {
-            int fval_v = *fval;
-            int sval_v = *sval;
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v < sval_v;
-        } else if (fval.type() == TypeIdentifyer::STRING_T &&
-                   sval.type() == TypeIdentifyer::STRING_T) {
-            std::string fval_v = fval.get_str();
-            std::string sval_v = sval.get_str();
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v < sval_v;
-        } else {
-            throw std::invalid_argument(NOT_INT);
+    static int size_(const Value &val) {
+        switch (val.type()) {
+            case TypeIdentifyer::INT_ARRAY_T:
+                return static_cast<int>(val.ints().size());
+            case TypeIdentifyer::STRING_ARRAY_T:
+                return static_cast<int>(val.strs().size());
+            case TypeIdentifyer::INT_MAP_T:
+                return static_cast<int>(val.int_map().size());
+            default:
+                return static_cast<int>(val.str_map().size());
         }
     }
 };
 
-class GrOperator : public BinaryOperator {
+// insert(map, key, value), add(map, key, value), get(map, key),
+// contains(map, key), keys(map) and values(map). insert and add write a map
+// variable, add counts from 0 for a new key; get of a missing key is an
+// error; keys and values are arrays in the order of insertion
+class MapFunctionNode : public OperatorNode {
 public:
-    GrOperator(ExpressionNode *left, ExpressionNode *right) :
-            BinaryOperator(left, right, ">") {}
+    enum class Function {
+        GET,
+        CONTAINS,
+        KEYS,
+        VALUES,
+        INSERT,
+        ADD,
+    };
+
+    MapFunctionNode(Function function, ExpressionNode *map, ExpressionNode *key,
+                    ExpressionNode *value) :
+            function_(function), map_(map), key_(key), value_(value) {}
+
+    // nullptr if there is no such function of these arguments
+    static MapFunctionNode *make(const std::string &name, ExpressionNode *map,
+                                 ExpressionNode *key = nullptr,
+                                 ExpressionNode *value = nullptr) {
+        int args = 1 + (key != nullptr) + (value != nullptr);
+        for (int i = 0; i < FUNCTIONS; ++i) {
+            auto function = static_cast<Function>(i);
+            if (name == names_(function) && args == arity_(function)) {
+                return new MapFunctionNode(function, map, key, value);
+            }
+        }
+        return nullptr;
+    }
 
-    void evaluate(Machine &machine) override {
-        BinaryOperator::evaluate(machine);
-        auto &fval = machine.top(1);
-        auto &sval = machine.top(0);
-        if (fval.type() == TypeIdentifyer::INT_T &&
-            sval.type() == TypeIdentifyer::INT_T) {
-            int fval_v = *fval;
-            int sval_v = *sval;
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v > sval_v;
-        } else if (fval.type() == TypeIdentifyer::STRING_T &&
-                   sval.type() == TypeIdentifyer::STRING_T) {
-            std::string fval_v = fval.get_str();
-            std::string sval_v = sval.get_str();
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v > sval_v;
-        } else {
-            throw std::invalid_argument(NOT_INT);
+    ~MapFunctionNode() override {
+        destroy(map_);
+        destroy(key_);
+        destroy(value_);
+    }
+
+    void print(int depth, std::ostream &out) override {
+        out << names_(function_) << "(";
+        map_->print(depth, out);
+        for (auto arg : {key_, value_}) {
+            if (arg) {
+                out << ", ";
+                arg->print(depth, out);
+            }
         }
+        out << ")";
     }
-};
 
-class LessEqOperator : public BinaryOperator {
-public:
-    LessEqOperator(ExpressionNode *left, ExpressionNode *right) :
-            BinaryOperator(left, right, "<=") {}
+    bool has_value() const override {
+        return !writes_();
+    }
 
-    void evaluate(Machine &machine) override {
-        BinaryOperator::evaluate(machine);
-        auto &fval = machine.top(1);
-        auto &sval = machine.top(0);
-        if (fval.type() == TypeIdentifyer::INT_T &&
-            sval.type() == TypeIdentifyer::INT_T) {
-            int fval_v = *fval;
-            int sval_v = *sval;
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v <= sval_v;
-        } else if (fval.type() == TypeIdentifyer::STRING_T &&
-                   sval.type() == TypeIdentifyer::STRING_T) {
-            std::string fval_v = fval.get_str();
-            std::string sval_v = sval.get_str();
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v <= sval_v;
+    void resolve(Resolver &resolver) override {
+        map_->resolve(resolver);
+        if (key_) {
+            key_->resolve(resolver);
+        }
+        if (value_) {
+            value_->resolve(resolver);
+        }
+    }
+
+    OperatorNode *check(TypeChecker &checker) override {
+        checker.check_value(map_);
+        auto type = map_->value_type();
+        if (!is_map(type)) {
+            throw std::invalid_argument(NOT_MAP);
+        }
+        if (writes_() && map_->nodeType() != NodeType::VARIABLE) {
+            throw std::invalid_argument(std::string(names_(function_)) +
+                                        "() needs a map variable");
+        }
+        if (key_) {
+            checker.check_value(key_);
+            if (key_->value_type() != key_type(type)) {
+                throw std::invalid_argument(VAR_NEQ_EXPR);
+            }
+        }
+        if (value_) {
+            checker.check_value(value_);
+            if (value_->value_type() != TypeIdentifyer::INT_T) {
+                throw std::invalid_argument(NOT_INT);
+            }
+        }
+        if (function_ == Function::KEYS) {
+            value_type_ = array_type(key_type(type));
+        } else if (function_ == Function::VALUES) {
+            value_type_ = TypeIdentifyer::INT_ARRAY_T;
         } else {
-            throw std::invalid_argument(NOT_INT);
+            value_type_ = TypeIdentifyer::INT_T;
         }
+        return this;
     }
-};
 
-class GrEqOperator : public BinaryOperator {
-public:
-    GrEqOperator(ExpressionNode *left, ExpressionNode *right) :
-            BinaryOperator(left, right, ">=") {}
+    OperatorNode *optimize(Optimizer &optimizer) override {
+        optimizer.optimize(map_);
+        if (key_) {
+            optimizer.optimize(key_);
+        }
+        if (value_) {
+            optimizer.optimize(value_);
+        }
+        return this;
+    }
 
     void evaluate(Machine &machine) override {
-        BinaryOperator::evaluate(machine);
-        auto &fval = machine.top(1);
-        auto &sval = machine.top(0);
-        if (fval.type() == TypeIdentifyer::INT_T &&
-            sval.type() == TypeIdentifyer::INT_T) {
-            int fval_v = *fval;
-            int sval_v = *sval;
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v >= sval_v;
-        } else if (fval.type() == TypeIdentifyer::STRING_T &&
-                   sval.type() == TypeIdentifyer::STRING_T) {
-            std::string fval_v = fval.get_str();
-            std::string sval_v = sval.get_str();
-            machine.pop();
-            machine.pop();
-            machine.push(TypeIdentifyer::INT_T);
-            *machine.top() = fval_v >= sval_v;
+        count_evaluation_(machine, this);
+        if (writes_()) {
+            write_(machine);
+        } else if (function_ == Function::KEYS || function_ == Function::VALUES) {
+            // the array takes the place of the map on the stack
+            map_->evaluate(machine);
+            auto &top = machine.top();
+            if (function_ == Function::VALUES) {
+                top.load_array(is_int_map_() ? map_values(top.int_map())
+                                             : map_values(top.str_map()));
+            } else if (is_int_map_()) {
+                top.load_array(map_keys(top.int_map()));
+            } else {
+                top.load_array(map_keys(top.str_map()));
+            }
         } else {
-            throw std::invalid_argument(NOT_INT);
+            int result = int_(machine);
+            machine.push(TypeIdentifyer::INT_T);
+            *machine.top() = result;
         }
     }
-};
-
-class AssignOperator : public OperatorNode {
-public:
-    AssignOperator(const std::string &var_name, ExpressionNode *expression) :
-            AssignOperator(new VariableNode(var_name), expression) {}
-
-    AssignOperator(VariableNode *variable, ExpressionNode *expression) :
-            OperatorNode("="), variable_(variable), expression_(expression) {}
 
-    ~AssignOperator() override {
-        delete variable_;
-        delete expression_;
+    int eval_int(Machine &machine) override {
+        count_evaluation_(machine, this);
+        return int_(machine);
     }
 
-    void print(int depth, std::ostream &out) override {
-        variable_->print(depth, out);
-        out << " ";
-        OperatorNode::print(depth, out);
-        out << " ";
-        expression_->print(depth, out);
+    int compile(Compiler &compiler) override {
+        int mark = compiler.temps();
+        int map = map_->compile(compiler);
+        int key = key_ ? key_->compile(compiler) : 0;
+        int value = value_ ? value_->compile(compiler) : 0;
+        if (writes_()) {
+            compiler.emit(function_ == Function::INSERT ? OpCode::MAP_INSERT : OpCode::MAP_ADD,
+                          map, key, value);
+            compiler.free_temps(mark);
+            return Compiler::NO_REG;
+        }
+        compiler.free_temps(mark);
+        static const OpCode OPCODES[] = {OpCode::MAP_GET, OpCode::MAP_CONTAINS,
+                                         OpCode::MAP_KEYS, OpCode::MAP_VALUES};
+        int reg = compiler.temp();
+        compiler.emit(OPCODES[static_cast<int>(function_)], reg, map, key);
+        return reg;
     }
 
-    void evaluate(Machine &machine) override {
-        expression_->evaluate(machine);
-        auto &expr = machine.top();
-        auto &var = machine.get(variable_->name());
-        if (var.type() != expr.type()) {
-            throw std::invalid_argument(VAR_NEQ_EXPR);
+    std::string transpile(Transpiler &transpiler) override {
+        auto map = map_->transpile(transpiler);
+        auto key = key_ ? key_->transpile(transpiler) : std::string();
+        auto value = value_ ? value_->transpile(transpiler) : std::string();
+        switch (function_) {
+            case Function::GET:
+                return transpiler.temporary(TypeIdentifyer::INT_T,
+                                            "map_get(" + map + ", " + key + ")");
+            case Function::CONTAINS:
+                return "map_contains(" + map + ", " + key + ")";
+            case Function::KEYS:
+                return transpiler.movable(value_type_, "map_keys(" + map + ")");
+            case Function::VALUES:
+                return transpiler.movable(value_type_, "map_values(" + map + ")");
+            default:
+                transpiler.line(std::string(function_ == Function::INSERT ? "map_insert("
+                                                                          : "map_add(") +
+                                map + ", " + key + ", " + value + ");");
+                return std::string();
         }
-        var = expr;
-        machine.pop();
     }
 
 private:
-    VariableNode *variable_;
-    ExpressionNode *expression_;
-};
+    static const int FUNCTIONS = 6;
 
-class CreateOperator : public OperatorNode {
-public:
-    CreateOperator(TypeNode *var_type, const std::string &var_name,
-                   ExpressionNode *expression = nullptr) :
-            CreateOperator(var_type, new VariableNode(var_name),
-                           expression) {}
+    Function function_;
+    ExpressionNode *map_;
+    ExpressionNode *key_;
+    ExpressionNode *value_;
 
-    CreateOperator(TypeIdentifyer type, const std::string &var_name,
-                   ExpressionNode *expression = nullptr) :
-            CreateOperator(new TypeNode(type), new VariableNode(var_name),
-                           expression) {}
+    static const char *names_(Function function) {
+        static const char *const NAMES[] = {"get", "contains", "keys", "values",
+                                            "insert", "add"};
+        return NAMES[static_cast<int>(function)];
+    }
 
-    CreateOperator(TypeNode *var_type, VariableNode *var,
-                   ExpressionNode *expression = nullptr) :
-            OperatorNode("="),
-            var_type_(var_type), var_(var), expression_(expression) {}
+    static int arity_(Function function) {
+        static const int ARITY[] = {2, 2, 1, 1, 3, 3};
+        return ARITY[static_cast<int>(function)];
+    }
 
-    ~CreateOperator() override {
-        delete var_type_;
-        delete var_;
-        delete expression_;
+    bool writes_() const {
+        return function_ == Function::INSERT || function_ == Function::ADD;
     }
 
-    void print(int depth, std::ostream &out) override {
-        var_type_->print(depth, out);
-        out << " ";
-        var_->print(depth, out);
-        out << " ";
-        OperatorNode::print(depth, out);
-        out << " ";
-        expression_->print(depth, out);
+    bool is_int_map_() const {
+        return map_->value_type() == TypeIdentifyer::INT_MAP_T;
     }
 
-    void evaluate(Machine &machine) override {
-        machine.add(var_type_->type(), var_->name());
-        if (expression_) {
-            expression_->evaluate(machine);
-            auto &expr = machine.top();
-            auto &var = machine.get(var_->name());
-            if (var.type() != expr.type()) {
-                throw std::invalid_argument(VAR_NEQ_EXPR);
-            }
-            var = expr;
+    // get or contains; the map is on the stack while the function runs
+    int int_(Machine &machine) {
+        map_->evaluate(machine);
+        bool get = function_ == Function::GET;
+        int result = 0;
+        if (is_int_map_()) {
+            int key = key_->eval_int(machine);
+            const auto &map = machine.top().int_map();
+            result = get ? map_get(map, key) : map_contains(map, key);
+        } else {
+            key_->evaluate(machine);
+            const auto &map = machine.top(1).str_map();
+            result = get ? map_get(map, machine.top()) : map_contains(map, machine.top());
             machine.pop();
         }
+        machine.pop();
+        return result;
     }
 
-private:
-    TypeNode *var_type_;
-    VariableNode *var_;
-    ExpressionNode *expression_;
+    // the key and the value are computed before the map is detached
+    void write_(Machine &machine) {
+        auto slot = static_cast<VariableNode *>(map_)->slot();
+        bool insert = function_ == Function::INSERT;
+        if (is_int_map_()) {
+            int key = key_->eval_int(machine);
+            int value = value_->eval_int(machine);
+            auto &map = machine.slot(slot).get_int_map();
+            if (insert) {
+                map_insert(map, key, value);
+            } else {
+                map_add(map, key, value);
+            }
+            return;
+        }
+        key_->evaluate(machine);
+        int value = value_->eval_int(machine);
+        auto &map = machine.slot(slot).get_str_map();
+        if (insert) {
+            map_insert(map, machine.top(), value);
+        } else {
+            map_add(map, machine.top(), value);
+        }
+        machine.pop();
+    }
 };
 
-class IfOperatorNode : public OperatorNode {
+class ReadIntNode : public OperatorNode {
 public:
-    IfOperatorNode(ExpressionNode *condition,
-                   CmdNode *true_branch,
-                   CmdNode *false_branch = nullptr) :
-            condition_(condition),
-            true_branch_(true_branch),
-            false_branch_(false_branch) {}
-
-    ~IfOperatorNode() override {
-        delete condition_;
-        delete true_branch_;
-        delete false_branch_;
+    void print(int depth, std::ostream &out) override {
+        out << "read_int()";
     }
 
-    void print(int depth, std::ostream &out) override {
-        auto tab = std::string(depth, '\t');
-        out << tab << "if (";
-        condition_->print(depth, out);
-        out << ")\n";
-        true_branch_->print(depth, out);
-        if (false_branch_) {
-            out << tab << "else\n";
-            false_branch_->print(depth, out);
-        }
+    OperatorNode *check(TypeChecker &checker) override {
+        checker.check_sequential();
+        return this;
     }
 
     void evaluate(Machine &machine) override {
-        condition_->evaluate(machine);
-        auto &cond = machine.top();
-        if (cond.type() != TypeIdentifyer::INT_T) {
-            throw std::invalid_argument(NOT_BOOL_INT);
-        }
-        int cond_v = *cond;
-        machine.pop();
-        if (cond_v) {
-            true_branch_->evaluate(machine);
-        } else {
-            if (false_branch_) {
-                false_branch_->evaluate(machine);
-            }
-        }
+        count_evaluation_(machine, this);
+        machine.read_int();
+    }
+
+    int compile(Compiler &compiler) override {
+        int reg = compiler.temp();
+        compiler.emit(OpCode::READ_INT, reg);
+        return reg;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        return transpiler.temporary(TypeIdentifyer::INT_T, "rt.read_int()");
     }
 
 private:
-    ExpressionNode *condition_;
-    CmdNode *true_branch_;
-    CmdNode *false_branch_;
 };
 
-class WhileOperatorNode : public OperatorNode {
+class ReadLongNode : public OperatorNode {
 public:
-    WhileOperatorNode(ExpressionNode *condition, CmdNode *cmd) :
-            condition_(condition), cmd_(cmd) {}
-
-    ~WhileOperatorNode() override {
-        delete condition_;
-        delete cmd_;
+    ReadLongNode() {
+        value_type_ = TypeIdentifyer::LONG_T;
     }
 
     void print(int depth, std::ostream &out) override {
-        auto tab = std::string(depth, '\t');
-        out << tab << "while (";
-        condition_->print(depth, out);
-        out << ")\n";
-        cmd_->print(depth, out);
+        out << "read_long()";
+    }
+
+    OperatorNode *check(TypeChecker &checker) override {
+        checker.check_sequential();
+        return this;
     }
 
     void evaluate(Machine &machine) override {
-        while (true) {
-            condition_->evaluate(machine);
-            auto &cond = machine.top();
-            if (cond.type() != TypeIdentifyer::INT_T) {
-                throw std::invalid_argument(NOT_BOOL_INT);
-            }
-            int cond_v = *cond;
-            machine.pop();
-            if (!cond_v) {
-                break;
-            }
-            cmd_->evaluate(machine);
-        }
+        count_evaluation_(machine, this);
+        machine.read_long();
     }
 
-private:
-    ExpressionNode *condition_;
-    CmdNode *cmd_;
+    int compile(Compiler &compiler) override {
+        int reg = compiler.temp();
+        compiler.emit(OpCode::READ_LONG, reg);
+        return reg;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        return transpiler.temporary(TypeIdentifyer::LONG_T, "rt.read_long()");
+    }
 };
 
-class ForOperatorNode : public OperatorNode {
+// read_ints(n), an array of n read_int()s parsed in bulk
+class ReadIntsNode : public OperatorNode {
 public:
-    ForOperatorNode(ExpressionNode *init, ExpressionNode *condition, ExpressionNode *after, CmdNode *cmd) :
-            init_(init), condition_(condition), after_(after), cmd_(cmd) {}
+    explicit ReadIntsNode(ExpressionNode *size) : size_(size) {
+        value_type_ = TypeIdentifyer::INT_ARRAY_T;
+    }
 
-    ~ForOperatorNode() override {
-        delete init_;
-        delete condition_;
-        delete after_;
-        delete cmd_;
+    ~ReadIntsNode() override {
+        destroy(size_);
     }
 
     void print(int depth, std::ostream &out) override {
-        auto tab = std::string(depth, '\t');
-        out << tab << "for (";
-        init_->print(depth, out);
-        out << ";";
-        condition_->print(depth, out);
-        out << ";";
-        after_->print(depth, out);
-        out << ")\n";
-        cmd_->print(depth, out);
+        out << "read_ints(";
+        size_->print(depth, out);
+        out << ")";
     }
 
-    void evaluate(Machine &machine) override {
-        init_->evaluate(machine);
-        while (true) {
-            condition_->evaluate(machine);
-            auto &cond = machine.top();
-            if (cond.type() != TypeIdentifyer::INT_T) {
-                throw std::invalid_argument(NOT_BOOL_INT);
-            }
-            int cond_v = *cond;
-            machine.pop();
-            if (!cond_v) {
-                break;
-            }
-            cmd_->evaluate(machine);
-            after_->evaluate(machine);
+    void resolve(Resolver &resolver) override {
+        size_->resolve(resolver);
+    }
+
+    OperatorNode *check(TypeChecker &checker) override {
+        checker.check_sequential();
+        checker.check_value(size_);
+        if (size_->value_type() != TypeIdentifyer::INT_T) {
+            throw std::invalid_argument(NOT_INT);
         }
+        return this;
+    }
+
+    OperatorNode *optimize(Optimizer &optimizer) override {
+        optimizer.optimize(size_);
+        return this;
+    }
+
+    void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
+        machine.read_ints(size_->eval_int(machine));
+    }
+
+    int compile(Compiler &compiler) override {
+        int mark = compiler.temps();
+        int size = size_->compile(compiler);
+        compiler.free_temps(mark);
+        int reg = compiler.temp();
+        compiler.emit(OpCode::READ_INTS, reg, size);
+        return reg;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        auto size = size_->transpile(transpiler);
+        return transpiler.movable(value_type_, "rt.read_ints(" + size + ")");
     }
 
 private:
-    ExpressionNode *init_;
-    ExpressionNode *condition_;
-    ExpressionNode *after_;
-    CmdNode *cmd_;
+    ExpressionNode *size_;
 };
 
-
-class ReadIntNode : public OperatorNode {
+// read_all_words(), the words left in the input
+class ReadAllWordsNode : public OperatorNode {
 public:
+    ReadAllWordsNode() {
+        value_type_ = TypeIdentifyer::STRING_ARRAY_T;
+    }
+
     void print(int depth, std::ostream &out) override {
-        out << "read_int()";
+        out << "read_all_words()";
+    }
+
+    OperatorNode *check(TypeChecker &checker) override {
+        checker.check_sequential();
+        return this;
     }
 
     void evaluate(Machine &machine) override {
-        machine.read_int();
+        count_evaluation_(machine, this);
+        machine.read_all_words();
     }
 
-private:
+    int compile(Compiler &compiler) override {
+        int reg = compiler.temp();
+        compiler.emit(OpCode::READ_ALL_WORDS, reg);
+        return reg;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        return transpiler.movable(value_type_, "rt.read_all_words()");
+    }
 };
 
 class ReadNode : public OperatorNode {
 public:
-    explicit ReadNode(bool line = false) : line_(line) {}
+    explicit ReadNode(bool line = false) : line_(line) {
+        value_type_ = TypeIdentifyer::STRING_T;
+    }
 
     void print(int depth, std::ostream &out) override {
-        out << "read_int()";
+        out << (line_ ? "read_line()" : "read_word()");
+    }
+
+    OperatorNode *check(TypeChecker &checker) override {
+        checker.check_sequential();
+        return this;
     }
 
     void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
         if (line_) {
             machine.read_line();
         } else {
@@ -976,6 +5235,17 @@ public:
         }
     }
 
+    int compile(Compiler &compiler) override {
+        int reg = compiler.temp();
+        compiler.emit(line_ ? OpCode::READ_LINE : OpCode::READ_WORD, reg);
+        return reg;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        return transpiler.temporary(TypeIdentifyer::STRING_T,
+                                    line_ ? "rt.read_line()" : "rt.read_word()");
+    }
+
 private:
     bool line_ = false;
 };
@@ -986,23 +5256,59 @@ public:
             dst_(dst), line_(line) {}
 
     ~WriteNode() override {
-        delete dst_;
+        destroy(dst_);
     }
 
     void print(int depth, std::ostream &out) override {
-        out << "write(";
+        out << (line_ ? "write_line(" : "write(");
         dst_->print(depth, out);
         out << ")";
     }
 
+    void resolve(Resolver &resolver) override {
+        dst_->resolve(resolver);
+    }
+
+    OperatorNode *check(TypeChecker &checker) override {
+        checker.check_value(dst_);
+        if (is_array(dst_->value_type())) {
+            throw std::invalid_argument("Arrays can't be written");
+        }
+        if (is_map(dst_->value_type())) {
+            throw std::invalid_argument("Maps can't be written");
+        }
+        return this;
+    }
+
+    OperatorNode *optimize(Optimizer &optimizer) override {
+        optimizer.optimize(dst_);
+        return this;
+    }
+
     void evaluate(Machine &machine) override {
+        count_evaluation_(machine, this);
         dst_->evaluate(machine);
-        machine.write();
         if (line_) {
-            machine.write("\n");
+            machine.write_line();
+        } else {
+            machine.write();
         }
     }
 
+    int compile(Compiler &compiler) override {
+        int mark = compiler.temps();
+        int reg = dst_->compile(compiler);
+        compiler.emit(line_ ? OpCode::WRITE_LINE : OpCode::WRITE, reg);
+        compiler.free_temps(mark);
+        return Compiler::NO_REG;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        auto val = dst_->transpile(transpiler);
+        transpiler.line((line_ ? "rt.write_line(" : "rt.write(") + val + ");");
+        return std::string();
+    }
+
 private:
     ExpressionNode *dst_;
     bool line_ = false;
@@ -1014,8 +5320,25 @@ public:
         out << "exit()";
     }
 
+    OperatorNode *check(TypeChecker &checker) override {
+        checker.check_sequential();
+        return this;
+    }
+
     void evaluate(Machine &machine) override {
-        exit(0);
+        count_evaluation_(machine, this);
+        machine.flush();
+        throw ProgramExit();
+    }
+
+    int compile(Compiler &compiler) override {
+        compiler.emit(OpCode::EXIT);
+        return Compiler::NO_REG;
+    }
+
+    std::string transpile(Transpiler &transpiler) override {
+        transpiler.line("rt.exit();");
+        return std::string();
     }
 };
 
@@ -0,0 +1,308 @@
+#ifndef INTERPRETER_TRANSPILER_H
+#define INTERPRETER_TRANSPILER_H
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+#include <machine.h>
+#include <enums.h>
+
+// Translates a checked and optimized program to the C++ source of a
+// standalone executable (--emit-c), which includes runtime.h for input,
+// output and errors.
+//
+// Nodes write their statements with line() and return the C++ expression
+// of their value. An expression that has effects or may throw goes to a
+// temporary first, so everything happens in the order of the tree engine;
+// the rest is nested right into the expression using it. Every frame of
+// the tree engine is a block declaring the frame's variables at its top,
+// globals are locals of main(), and every statement of the program runs
+// through Runtime::run().
+class Transpiler {
+public:
+    Transpiler() {
+        scopes_.emplace_back();
+    }
+
+    void begin_statement() {
+        line("rt.run([&] {");
+        ++indent_;
+        pending_ = true;
+    }
+
+    void end_statement() {
+        --indent_;
+        line("});");
+    }
+
+    // a statement that failed analysis reports its error when its turn comes
+    void report(const std::string &error) {
+        line("rt.report(" + quoted(error) + ");");
+    }
+
+    void finish(std::ostream &out) {
+        out << "// Translated by the interpreter's --emit-c, build with\n"
+               "//     c++ -std=c++11 -O2 -fwrapv -I <interpreter>/lib <this file>\n"
+               "#include <runtime.h>\n"
+               "\n"
+               "int main(int argc, char *argv[]) {\n"
+               "    Runtime rt;\n"
+               "    if (argc > 1 && !rt.open_input(argv[1])) {\n"
+               "        return 0;\n"
+               "    }\n";
+        for (const auto &declaration : scopes_.front().declarations) {
+            out << "    " << declaration << "\n";
+        }
+        for (const auto &code : scopes_.front().lines) {
+            out << code << "\n";
+        }
+        out << "    return rt.finish();\n"
+               "}\n";
+        scopes_.resize(1);
+        scopes_.front() = Scope();
+    }
+
+    // a block for the frame of a CmdNode, merged into a block just opened;
+    // one that declares nothing is left without braces
+    void enter_scope() {
+        Scope scope;
+        scope.braces = !pending_;
+        pending_ = false;
+        if (scope.braces) {
+            ++indent_;
+        }
+        scope.indent = indent_;
+        scopes_.push_back(scope);
+    }
+
+    void leave_scope() {
+        Scope scope = scopes_.back();
+        scopes_.pop_back();
+        auto &lines = scopes_.back().lines;
+        if (!scope.braces) {
+            for (const auto &declaration : scope.declarations) {
+                lines.push_back(pad_(scope.indent) + declaration);
+            }
+            lines.insert(lines.end(), scope.lines.begin(), scope.lines.end());
+            return;
+        }
+        --indent_;
+        if (scope.declarations.empty()) {
+            for (const auto &code : scope.lines) {
+                lines.push_back(code.substr(pad_(1).size()));
+            }
+            return;
+        }
+        lines.push_back(pad_(indent_) + "{");
+        for (const auto &declaration : scope.declarations) {
+            lines.push_back(pad_(scope.indent) + declaration);
+        }
+        lines.insert(lines.end(), scope.lines.begin(), scope.lines.end());
+        lines.push_back(pad_(indent_) + "}");
+    }
+
+    std::string variable(const std::string &name, VariableSlot slot) const {
+        return name + "_" + std::to_string(slot.depth);
+    }
+
+    // the variable is declared at the top of its frame's block
+    void declare(const std::string &name, VariableSlot slot, TypeIdentifyer type) {
+        auto &scope = scopes_[slot.depth];
+        auto var = variable(name, slot);
+        if (scope.names.insert(var).second) {
+            scope.declarations.push_back(type_name(type) + " " + var +
+                                         (type == TypeIdentifyer::INT_T ? " = 0;" : ";"));
+        }
+    }
+
+    // a new name for a temporary or a loop index
+    std::string name() {
+        return "t" + std::to_string(temporaries_++);
+    }
+
+    std::string temporary(const std::string &type, const std::string &expression) {
+        auto var = name();
+        line("const " + type + " " + var + " = " + expression + ";");
+        return var;
+    }
+
+    std::string temporary(TypeIdentifyer type, const std::string &expression) {
+        return temporary(type_name(type), expression);
+    }
+
+    // a temporary used once, so it's moved rather than copied where it's
+    // used; for arrays
+    std::string movable(TypeIdentifyer type, const std::string &expression) {
+        auto var = name();
+        line(type_name(type) + " " + var + " = " + expression + ";");
+        return "std::move(" + var + ")";
+    }
+
+    void line(const std::string &code) {
+        scopes_.back().lines.push_back(pad_(indent_) + code);
+        pending_ = false;
+    }
+
+    // header {
+    void open(const std::string &header) {
+        line(header + " {");
+        ++indent_;
+        pending_ = true;
+    }
+
+    // } header {
+    void reopen(const std::string &header) {
+        --indent_;
+        open("} " + header);
+    }
+
+    void close() {
+        --indent_;
+        line("}");
+    }
+
+    // lines written since the mark, taken back to be put elsewhere
+    size_t mark() const {
+        return scopes_.back().lines.size();
+    }
+
+    std::vector<std::string> take(size_t mark) {
+        auto &lines = scopes_.back().lines;
+        std::vector<std::string> taken(lines.begin() + mark, lines.end());
+        lines.resize(mark);
+        return taken;
+    }
+
+    // puts taken lines back, deeper by the given number of levels
+    void put(const std::vector<std::string> &lines, int deeper = 0) {
+        for (const auto &code : lines) {
+            scopes_.back().lines.push_back(pad_(deeper) + code);
+        }
+        pending_ = pending_ && lines.empty();
+    }
+
+    // true if the code may read the variable; names in string literals
+    // count too
+    static bool uses(const std::vector<std::string> &lines, const std::string &var) {
+        for (const auto &code : lines) {
+            for (size_t pos = code.find(var); pos != std::string::npos;
+                 pos = code.find(var, pos + 1)) {
+                size_t end = pos + var.size();
+                if ((pos == 0 || !identifier_(code[pos - 1])) &&
+                    (end == code.size() || !identifier_(code[end]))) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // the condition of if and while in parentheses, not doubled
+    static std::string parenthesized(const std::string &code) {
+        if (code.empty() || code.front() != '(' || code.back() != ')') {
+            return "(" + code + ")";
+        }
+        int depth = 0;
+        for (size_t i = 0; i < code.size(); ++i) {
+            if (code[i] == '"') {
+                for (++i; code[i] != '"'; ++i) {
+                    i += code[i] == '\\';
+                }
+            } else if (code[i] == '(') {
+                ++depth;
+            } else if (code[i] == ')' && --depth == 0 && i + 1 != code.size()) {
+                return "(" + code + ")";
+            }
+        }
+        return code;
+    }
+
+    static std::string type_name(TypeIdentifyer type) {
+        switch (type) {
+            case TypeIdentifyer::INT_T:
+                return "int";
+            case TypeIdentifyer::LONG_T:
+                return "Long";
+            case TypeIdentifyer::INT_ARRAY_T:
+                return "std::vector<int>";
+            case TypeIdentifyer::STRING_ARRAY_T:
+                return "std::vector<std::string>";
+            case TypeIdentifyer::INT_MAP_T:
+                return "FlatMap<int>";
+            case TypeIdentifyer::STRING_MAP_T:
+                return "FlatMap<std::string>";
+            default:
+                return "std::string";
+        }
+    }
+
+    static std::string literal(int value) {
+        if (value == INT_MIN) {
+            return "INT_MIN";
+        }
+        return value < 0 ? "(" + std::to_string(value) + ")" : std::to_string(value);
+    }
+
+    // a long too big for 64 bits is parsed when the program runs
+    static std::string literal(const Long &value) {
+        if (!value.is_small()) {
+            return "Long::parse(\"" + value.to_string() + "\")";
+        }
+        if (value.small() == INT64_MIN) {
+            return "Long(INT64_MIN)";
+        }
+        return "Long(" + value.to_string() + "LL)";
+    }
+
+    static std::string literal(const std::string &value) {
+        return "std::string(" + quoted(value) + ")";
+    }
+
+    // octal escapes for the rest, '?' against trigraphs
+    static std::string quoted(const std::string &value) {
+        std::string result = "\"";
+        for (char c : value) {
+            auto code = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\' || c == '?') {
+                result += '\\';
+                result += c;
+            } else if (code < 32 || code >= 127) {
+                char escape[5];
+                snprintf(escape, sizeof(escape), "\\%03o", code);
+                result += escape;
+            } else {
+                result += c;
+            }
+        }
+        return result + "\"";
+    }
+
+private:
+    struct Scope {
+        std::vector<std::string> declarations;
+        std::set<std::string> names;
+        std::vector<std::string> lines;
+        bool braces = true;
+        int indent = 1;
+    };
+
+    std::vector<Scope> scopes_;
+    int indent_ = 1;
+    bool pending_ = false;
+    int temporaries_ = 0;
+
+    static std::string pad_(int indent) {
+        return std::string(indent * 4, ' ');
+    }
+
+    static bool identifier_(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+               (c >= '0' && c <= '9') || c == '_';
+    }
+};
+
+#endif //INTERPRETER_TRANSPILER_H
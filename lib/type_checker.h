@@ -0,0 +1,80 @@
+#ifndef INTERPRETER_TYPE_CHECKER_H
+#define INTERPRETER_TYPE_CHECKER_H
+
+#include <stdexcept>
+#include <enums.h>
+
+// Nodes check their operand types in Node::check() and may return a
+// type-specialized node to take their place; the checker does the swap.
+class TypeChecker {
+public:
+    template <class T>
+    void check(T *&node) {
+        auto checked = node->check(*this);
+        if (checked != node) {
+            delete node;
+            node = checked;
+        }
+    }
+
+    // same for operands: they must leave a value to work with
+    template <class T>
+    void check_value(T *&node) {
+        check(node);
+        if (!node->has_value()) {
+            throw std::invalid_argument("Expression has no value");
+        }
+        if (parallel_ && node->value_type() == TypeIdentifyer::STRING_T) {
+            throw std::invalid_argument("Strings can't be used in parallel for");
+        }
+        if (parallel_ && node->value_type() == TypeIdentifyer::LONG_T) {
+            throw std::invalid_argument("Longs can't be used in parallel for");
+        }
+        if (parallel_ && is_array(node->value_type())) {
+            throw std::invalid_argument("Arrays can't be used in parallel for");
+        }
+        if (parallel_ && is_map(node->value_type())) {
+            throw std::invalid_argument("Maps can't be used in parallel for");
+        }
+    }
+
+    template <class T>
+    void check_condition(T *&node) {
+        check_value(node);
+        if (node->value_type() != TypeIdentifyer::INT_T) {
+            throw std::invalid_argument(NOT_BOOL_INT);
+        }
+    }
+
+    // for nodes that read the input or stop the program
+    void check_sequential() {
+        if (parallel_) {
+            throw std::invalid_argument("Input and exit() can't be used in parallel for");
+        }
+    }
+
+    // the body of a parallel for is checked while it's alive: its threads
+    // share no strings, no longs, no arrays, no maps and no input
+    class Parallel {
+    public:
+        explicit Parallel(TypeChecker &checker) : checker_(checker) {
+            ++checker_.parallel_;
+        }
+
+        Parallel(const Parallel &) = delete;
+
+        Parallel &operator=(const Parallel &) = delete;
+
+        ~Parallel() {
+            --checker_.parallel_;
+        }
+
+    private:
+        TypeChecker &checker_;
+    };
+
+private:
+    int parallel_ = 0;
+};
+
+#endif //INTERPRETER_TYPE_CHECKER_H
@@ -0,0 +1,583 @@
+#ifndef INTERPRETER_VM_H
+#define INTERPRETER_VM_H
+
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+#include <bytecode.h>
+#include <operations.h>
+#include <machine.h>
+#include <enums.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define INTERPRETER_COMPUTED_GOTO 1
+#else
+#define INTERPRETER_COMPUTED_GOTO 0
+#endif
+
+class VirtualMachine {
+public:
+    void run(const Chunk &chunk, Machine &machine) {
+        if (regs_.size() < chunk.registers()) {
+            regs_.resize(chunk.registers());
+        }
+        Value *r = regs_.data();
+        const Value *k = chunk.constants().data();
+        const Instruction *code = chunk.code().data();
+        const Instruction *ip = code;
+        uint64_t *counts = machine.metrics().instructions;
+        (void) counts;
+
+#if INTERPRETER_COMPUTED_GOTO
+        static void *labels[] = {
+#define INTERPRETER_OPCODE_LABEL(name, regs) &&op_##name,
+                INTERPRETER_OPCODES(INTERPRETER_OPCODE_LABEL)
+#undef INTERPRETER_OPCODE_LABEL
+        };
+#define VM_DISPATCH() \
+        INTERPRETER_METRIC(++counts[static_cast<int>(ip->op)]); \
+        goto *labels[static_cast<int>(ip->op)]
+#define VM_CASE(name) op_##name:
+#define VM_NEXT() ++ip; VM_DISPATCH()
+#define VM_JUMP(target) ip = code + (target); VM_DISPATCH()
+        VM_DISPATCH();
+        {
+#else
+#define VM_CASE(name) case OpCode::name:
+#define VM_NEXT() ++ip; continue
+#define VM_JUMP(target) ip = code + (target); continue
+        while (true) {
+            INTERPRETER_METRIC(++counts[static_cast<int>(ip->op)]);
+            switch (ip->op) {
+#endif
+        VM_CASE(LOAD_INT) {
+            set_int_(r[ip->a], ip->b);
+            VM_NEXT();
+        }
+        VM_CASE(LOAD_STR) {
+            r[ip->a] = k[ip->b];
+            VM_NEXT();
+        }
+        VM_CASE(MOVE) {
+            r[ip->a] = r[ip->b];
+            VM_NEXT();
+        }
+        VM_CASE(DECL) {
+            r[ip->a] = Value(static_cast<TypeIdentifyer>(ip->b));
+            VM_NEXT();
+        }
+        VM_CASE(ASSIGN) {
+            if (r[ip->a].type() != r[ip->b].type()) {
+                throw std::invalid_argument(VAR_NEQ_EXPR);
+            }
+            r[ip->a] = r[ip->b];
+            VM_NEXT();
+        }
+        VM_CASE(APPEND) {
+            r[ip->a].append(r[ip->b].str());
+            VM_NEXT();
+        }
+        VM_CASE(ADD) {
+            Value &fval = r[ip->b];
+            Value &sval = r[ip->c];
+            if (both_int_(fval, sval)) {
+                set_int_(r[ip->a], *fval + *sval);
+            } else if (both_str_(fval, sval)) {
+                if (ip->a == ip->b) {
+                    // the left operand is a temporary, it grows in place
+                    fval.append(sval.str());
+                } else {
+                    r[ip->a].load_str(fval.str() + sval.str());
+                }
+            } else {
+                throw std::invalid_argument(NOT_INT);
+            }
+            VM_NEXT();
+        }
+        VM_CASE(SUB) {
+            set_int_(r[ip->a], int_(r[ip->b]) - int_(r[ip->c]));
+            VM_NEXT();
+        }
+        VM_CASE(MUL) {
+            Value &fval = r[ip->b];
+            Value &sval = r[ip->c];
+            if (both_int_(fval, sval)) {
+                set_int_(r[ip->a], *fval * *sval);
+            } else if (fval.type() == TypeIdentifyer::STRING_T &&
+                       sval.type() == TypeIdentifyer::INT_T) {
+                repeat_(r[ip->a], fval.str(), *sval);
+            } else if (fval.type() == TypeIdentifyer::INT_T &&
+                       sval.type() == TypeIdentifyer::STRING_T) {
+                repeat_(r[ip->a], sval.str(), *fval);
+            } else {
+                throw std::invalid_argument(NOT_INT);
+            }
+            VM_NEXT();
+        }
+        VM_CASE(DIV) {
+            int fval = int_(r[ip->b]);
+            int sval = int_(r[ip->c]);
+            if (sval == 0) {
+                throw std::runtime_error("Division by zero.");
+            }
+            set_int_(r[ip->a], fval / sval);
+            VM_NEXT();
+        }
+        VM_CASE(MOD) {
+            int fval = int_(r[ip->b]);
+            int sval = int_(r[ip->c]);
+            if (sval == 0) {
+                throw std::runtime_error("Division by zero.");
+            }
+            set_int_(r[ip->a], fval % sval);
+            VM_NEXT();
+        }
+        VM_CASE(AND) {
+            set_int_(r[ip->a], bool_(r[ip->b]) && bool_(r[ip->c]));
+            VM_NEXT();
+        }
+        VM_CASE(OR) {
+            set_int_(r[ip->a], bool_(r[ip->b]) || bool_(r[ip->c]));
+            VM_NEXT();
+        }
+        VM_CASE(EQ) {
+            set_int_(r[ip->a], equal_(r[ip->b], r[ip->c]));
+            VM_NEXT();
+        }
+        VM_CASE(NOT_EQ) {
+            set_int_(r[ip->a], !equal_(r[ip->b], r[ip->c]));
+            VM_NEXT();
+        }
+        VM_CASE(LESS) {
+            set_int_(r[ip->a], compare_(r[ip->b], r[ip->c]) < 0);
+            VM_NEXT();
+        }
+        VM_CASE(GR) {
+            set_int_(r[ip->a], compare_(r[ip->b], r[ip->c]) > 0);
+            VM_NEXT();
+        }
+        VM_CASE(LESS_EQ) {
+            set_int_(r[ip->a], compare_(r[ip->b], r[ip->c]) <= 0);
+            VM_NEXT();
+        }
+        VM_CASE(GR_EQ) {
+            set_int_(r[ip->a], compare_(r[ip->b], r[ip->c]) >= 0);
+            VM_NEXT();
+        }
+        VM_CASE(NOT) {
+            set_int_(r[ip->a], !bool_(r[ip->b]));
+            VM_NEXT();
+        }
+        VM_CASE(NEG) {
+            set_int_(r[ip->a], -int_(r[ip->b]));
+            VM_NEXT();
+        }
+        VM_CASE(INT_ADD) {
+            set_int_(r[ip->a], Add::apply(r[ip->b].get_int(), r[ip->c].get_int()));
+            VM_NEXT();
+        }
+        VM_CASE(INT_SUB) {
+            set_int_(r[ip->a], Sub::apply(r[ip->b].get_int(), r[ip->c].get_int()));
+            VM_NEXT();
+        }
+        VM_CASE(INT_MUL) {
+            set_int_(r[ip->a], Mul::apply(r[ip->b].get_int(), r[ip->c].get_int()));
+            VM_NEXT();
+        }
+        VM_CASE(INT_DIV) {
+            set_int_(r[ip->a], Div::apply(r[ip->b].get_int(), r[ip->c].get_int()));
+            VM_NEXT();
+        }
+        VM_CASE(INT_MOD) {
+            set_int_(r[ip->a], Mod::apply(r[ip->b].get_int(), r[ip->c].get_int()));
+            VM_NEXT();
+        }
+        VM_CASE(INT_AND) {
+            set_int_(r[ip->a], And::apply(r[ip->b].get_int(), r[ip->c].get_int()));
+            VM_NEXT();
+        }
+        VM_CASE(INT_OR) {
+            set_int_(r[ip->a], Or::apply(r[ip->b].get_int(), r[ip->c].get_int()));
+            VM_NEXT();
+        }
+        VM_CASE(INT_EQ) {
+            set_int_(r[ip->a], Eq::apply(r[ip->b].get_int(), r[ip->c].get_int()));
+            VM_NEXT();
+        }
+        VM_CASE(INT_NOT_EQ) {
+            set_int_(r[ip->a], NotEq::apply(r[ip->b].get_int(), r[ip->c].get_int()));
+            VM_NEXT();
+        }
+        VM_CASE(INT_LESS) {
+            set_int_(r[ip->a], Less::apply(r[ip->b].get_int(), r[ip->c].get_int()));
+            VM_NEXT();
+        }
+        VM_CASE(INT_GR) {
+            set_int_(r[ip->a], Gr::apply(r[ip->b].get_int(), r[ip->c].get_int()));
+            VM_NEXT();
+        }
+        VM_CASE(INT_LESS_EQ) {
+            set_int_(r[ip->a], LessEq::apply(r[ip->b].get_int(), r[ip->c].get_int()));
+            VM_NEXT();
+        }
+        VM_CASE(INT_GR_EQ) {
+            set_int_(r[ip->a], GrEq::apply(r[ip->b].get_int(), r[ip->c].get_int()));
+            VM_NEXT();
+        }
+        VM_CASE(INT_NOT) {
+            set_int_(r[ip->a], Not::apply(r[ip->b].get_int()));
+            VM_NEXT();
+        }
+        VM_CASE(INT_NEG) {
+            set_int_(r[ip->a], Neg::apply(r[ip->b].get_int()));
+            VM_NEXT();
+        }
+        VM_CASE(LOAD_LONG) {
+            r[ip->a] = k[ip->b];
+            VM_NEXT();
+        }
+        VM_CASE(WIDEN) {
+            r[ip->a].load_long(r[ip->b].get_int());
+            VM_NEXT();
+        }
+        VM_CASE(LONG_ADD) {
+            r[ip->a].load_long(Add::apply(r[ip->b].get_long(), r[ip->c].get_long()));
+            VM_NEXT();
+        }
+        VM_CASE(LONG_SUB) {
+            r[ip->a].load_long(Sub::apply(r[ip->b].get_long(), r[ip->c].get_long()));
+            VM_NEXT();
+        }
+        VM_CASE(LONG_MUL) {
+            r[ip->a].load_long(Mul::apply(r[ip->b].get_long(), r[ip->c].get_long()));
+            VM_NEXT();
+        }
+        VM_CASE(LONG_DIV) {
+            r[ip->a].load_long(Div::apply(r[ip->b].get_long(), r[ip->c].get_long()));
+            VM_NEXT();
+        }
+        VM_CASE(LONG_MOD) {
+            r[ip->a].load_long(Mod::apply(r[ip->b].get_long(), r[ip->c].get_long()));
+            VM_NEXT();
+        }
+        VM_CASE(LONG_EQ) {
+            set_int_(r[ip->a], Eq::apply(r[ip->b].get_long(), r[ip->c].get_long()));
+            VM_NEXT();
+        }
+        VM_CASE(LONG_NOT_EQ) {
+            set_int_(r[ip->a], NotEq::apply(r[ip->b].get_long(), r[ip->c].get_long()));
+            VM_NEXT();
+        }
+        VM_CASE(LONG_LESS) {
+            set_int_(r[ip->a], Less::apply(r[ip->b].get_long(), r[ip->c].get_long()));
+            VM_NEXT();
+        }
+        VM_CASE(LONG_GR) {
+            set_int_(r[ip->a], Gr::apply(r[ip->b].get_long(), r[ip->c].get_long()));
+            VM_NEXT();
+        }
+        VM_CASE(LONG_LESS_EQ) {
+            set_int_(r[ip->a], LessEq::apply(r[ip->b].get_long(), r[ip->c].get_long()));
+            VM_NEXT();
+        }
+        VM_CASE(LONG_GR_EQ) {
+            set_int_(r[ip->a], GrEq::apply(r[ip->b].get_long(), r[ip->c].get_long()));
+            VM_NEXT();
+        }
+        VM_CASE(LONG_NEG) {
+            r[ip->a].load_long(Neg::apply(r[ip->b].get_long()));
+            VM_NEXT();
+        }
+        VM_CASE(NEW_ARRAY) {
+            r[ip->a].load_array(static_cast<TypeIdentifyer>(ip->c), r[ip->b].get_int());
+            VM_NEXT();
+        }
+        VM_CASE(INDEX) {
+            index_<true>(r[ip->a], r[ip->b], r[ip->c].get_int());
+            VM_NEXT();
+        }
+        VM_CASE(INDEX_UNCHECKED) {
+            index_<false>(r[ip->a], r[ip->b], r[ip->c].get_int());
+            VM_NEXT();
+        }
+        VM_CASE(STORE_INDEX) {
+            store_index_<true>(r[ip->a], r[ip->b].get_int(), r[ip->c]);
+            VM_NEXT();
+        }
+        VM_CASE(STORE_INDEX_UNCHECKED) {
+            store_index_<false>(r[ip->a], r[ip->b].get_int(), r[ip->c]);
+            VM_NEXT();
+        }
+        VM_CASE(IN_BOUNDS) {
+            set_int_(r[ip->a], static_cast<unsigned>(r[ip->c].get_int()) <
+                               static_cast<unsigned>(size_(r[ip->b])));
+            VM_NEXT();
+        }
+        VM_CASE(ARRAY_SIZE) {
+            set_int_(r[ip->a], size_(r[ip->b]));
+            VM_NEXT();
+        }
+        VM_CASE(ARRAY_SUM) {
+            r[ip->a].load_long(array_sum(r[ip->b].ints()));
+            VM_NEXT();
+        }
+        VM_CASE(ARRAY_MIN) {
+            set_int_(r[ip->a], array_min(r[ip->b].ints()));
+            VM_NEXT();
+        }
+        VM_CASE(ARRAY_MAX) {
+            set_int_(r[ip->a], array_max(r[ip->b].ints()));
+            VM_NEXT();
+        }
+        VM_CASE(ARRAY_COUNT) {
+            Value &array = r[ip->b];
+            if (array.type() == TypeIdentifyer::INT_ARRAY_T) {
+                set_int_(r[ip->a], array_count(array.ints(), r[ip->c].get_int()));
+            } else {
+                set_int_(r[ip->a], array_count(array.strs(), r[ip->c]));
+            }
+            VM_NEXT();
+        }
+        VM_CASE(ARRAY_FILL) {
+            Value &array = r[ip->a];
+            if (array.type() == TypeIdentifyer::INT_ARRAY_T) {
+                array_fill(array.get_ints(), r[ip->b].get_int());
+            } else {
+                array_fill(array.get_strs(), r[ip->b]);
+            }
+            VM_NEXT();
+        }
+        VM_CASE(MAP_GET) {
+            Value &map = r[ip->b];
+            if (map.type() == TypeIdentifyer::INT_MAP_T) {
+                set_int_(r[ip->a], map_get(map.int_map(), r[ip->c].get_int()));
+            } else {
+                set_int_(r[ip->a], map_get(map.str_map(), r[ip->c]));
+            }
+            VM_NEXT();
+        }
+        VM_CASE(MAP_CONTAINS) {
+            Value &map = r[ip->b];
+            if (map.type() == TypeIdentifyer::INT_MAP_T) {
+                set_int_(r[ip->a], map_contains(map.int_map(), r[ip->c].get_int()));
+            } else {
+                set_int_(r[ip->a], map_contains(map.str_map(), r[ip->c]));
+            }
+            VM_NEXT();
+        }
+        VM_CASE(MAP_KEYS) {
+            Value &map = r[ip->b];
+            if (map.type() == TypeIdentifyer::INT_MAP_T) {
+                r[ip->a].load_array(map_keys(map.int_map()));
+            } else {
+                r[ip->a].load_array(map_keys(map.str_map()));
+            }
+            VM_NEXT();
+        }
+        VM_CASE(MAP_VALUES) {
+            Value &map = r[ip->b];
+            r[ip->a].load_array(map.type() == TypeIdentifyer::INT_MAP_T
+                                ? map_values(map.int_map()) : map_values(map.str_map()));
+            VM_NEXT();
+        }
+        VM_CASE(MAP_INSERT) {
+            Value &map = r[ip->a];
+            if (map.type() == TypeIdentifyer::INT_MAP_T) {
+                map_insert(map.get_int_map(), r[ip->b].get_int(), r[ip->c].get_int());
+            } else {
+                map_insert(map.get_str_map(), r[ip->b], r[ip->c].get_int());
+            }
+            VM_NEXT();
+        }
+        VM_CASE(MAP_ADD) {
+            Value &map = r[ip->a];
+            if (map.type() == TypeIdentifyer::INT_MAP_T) {
+                map_add(map.get_int_map(), r[ip->b].get_int(), r[ip->c].get_int());
+            } else {
+                map_add(map.get_str_map(), r[ip->b], r[ip->c].get_int());
+            }
+            VM_NEXT();
+        }
+        VM_CASE(JUMP) {
+            VM_JUMP(ip->a);
+        }
+        VM_CASE(JUMP_FALSE) {
+            if (!bool_(r[ip->a])) {
+                VM_JUMP(ip->b);
+            }
+            VM_NEXT();
+        }
+        VM_CASE(READ_INT) {
+            machine.read_int();
+            r[ip->a] = machine.top();
+            machine.pop();
+            VM_NEXT();
+        }
+        VM_CASE(READ_LONG) {
+            machine.read_long();
+            r[ip->a] = machine.top();
+            machine.pop();
+            VM_NEXT();
+        }
+        VM_CASE(READ_WORD) {
+            machine.read_word();
+            r[ip->a] = machine.top();
+            machine.pop();
+            VM_NEXT();
+        }
+        VM_CASE(READ_LINE) {
+            machine.read_line();
+            r[ip->a] = machine.top();
+            machine.pop();
+            VM_NEXT();
+        }
+        VM_CASE(READ_INTS) {
+            machine.read_ints(r[ip->b].get_int());
+            r[ip->a] = machine.top();
+            machine.pop();
+            VM_NEXT();
+        }
+        VM_CASE(READ_ALL_WORDS) {
+            machine.read_all_words();
+            r[ip->a] = machine.top();
+            machine.pop();
+            VM_NEXT();
+        }
+        VM_CASE(WRITE) {
+            machine.write(r[ip->a]);
+            VM_NEXT();
+        }
+        VM_CASE(WRITE_LINE) {
+            machine.write_line(r[ip->a]);
+            VM_NEXT();
+        }
+        VM_CASE(EXIT) {
+            machine.flush();
+            throw ProgramExit();
+        }
+        VM_CASE(HALT) {
+            return;
+        }
+#if !INTERPRETER_COMPUTED_GOTO
+            }
+#endif
+        }
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_JUMP
+#if INTERPRETER_COMPUTED_GOTO
+#undef VM_DISPATCH
+#endif
+    }
+
+private:
+    std::vector<Value> regs_;
+
+    static bool both_int_(const Value &fval, const Value &sval) {
+        return fval.type() == TypeIdentifyer::INT_T &&
+               sval.type() == TypeIdentifyer::INT_T;
+    }
+
+    static bool both_str_(const Value &fval, const Value &sval) {
+        return fval.type() == TypeIdentifyer::STRING_T &&
+               sval.type() == TypeIdentifyer::STRING_T;
+    }
+
+    static int int_(Value &val) {
+        if (val.type() != TypeIdentifyer::INT_T) {
+            throw std::invalid_argument(NOT_INT);
+        }
+        return *val;
+    }
+
+    static int bool_(Value &val) {
+        if (val.type() != TypeIdentifyer::INT_T) {
+            throw std::invalid_argument(NOT_BOOL_INT);
+        }
+        return *val;
+    }
+
+    static bool equal_(Value &fval, Value &sval) {
+        if (both_int_(fval, sval)) {
+            return *fval == *sval;
+        }
+        if (both_str_(fval, sval)) {
+            return fval.str_equal(sval);
+        }
+        throw std::invalid_argument(NOT_INT);
+    }
+
+    static int compare_(Value &fval, Value &sval) {
+        if (both_int_(fval, sval)) {
+            return (*fval > *sval) - (*fval < *sval);
+        }
+        if (both_str_(fval, sval)) {
+            return fval.str().compare(sval.str());
+        }
+        throw std::invalid_argument(NOT_INT);
+    }
+
+    static void set_int_(Value &val, int result) {
+        val = result;
+    }
+
+    // of an array or a map
+    static int size_(const Value &val) {
+        switch (val.type()) {
+            case TypeIdentifyer::INT_ARRAY_T:
+                return static_cast<int>(val.ints().size());
+            case TypeIdentifyer::STRING_ARRAY_T:
+                return static_cast<int>(val.strs().size());
+            case TypeIdentifyer::INT_MAP_T:
+                return static_cast<int>(val.int_map().size());
+            default:
+                return static_cast<int>(val.str_map().size());
+        }
+    }
+
+    template <bool Checked>
+    static void index_(Value &val, const Value &array, int index) {
+        if (array.type() == TypeIdentifyer::INT_ARRAY_T) {
+            const auto &items = array.ints();
+            if (Checked) {
+                check_index(index, items.size());
+            }
+            set_int_(val, items[index]);
+        } else {
+            const auto &items = array.strs();
+            if (Checked) {
+                check_index(index, items.size());
+            }
+            val = items[index];
+        }
+    }
+
+    // checked before the storage is detached, a failed store copies nothing
+    template <bool Checked>
+    static void store_index_(Value &array, int index, const Value &val) {
+        if (array.type() == TypeIdentifyer::INT_ARRAY_T) {
+            if (Checked) {
+                check_index(index, array.ints().size());
+            }
+            array.get_ints()[index] = val.get_int();
+        } else {
+            if (Checked) {
+                check_index(index, array.strs().size());
+            }
+            array.get_strs()[index] = val;
+        }
+    }
+
+    static void repeat_(Value &val, const std::string &str, int times) {
+        std::string result;
+        if (times > 0) {
+            result.reserve(str.size() * times);
+        }
+        for (int i = 0; i < times; ++i) {
+            result += str;
+        }
+        val.load_str(std::move(result));
+    }
+};
+
+#endif //INTERPRETER_VM_H
@@ -0,0 +1,84 @@
+// Runs a script on an interpreter started with --serve=SOCKET:
+//
+//  interpreter_client [--time] SOCKET SCRIPT [INPUT]
+//
+// The input of the script is the file INPUT or, without it, all of stdin.
+// The output is printed to stdout, syntax errors to stderr, and with --time
+// the time the server took.
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <protocol.h>
+
+bool read_file(std::istream &in, std::string &data) {
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !in.bad();
+}
+
+// the server may run in another directory
+std::string absolute(const char *path) {
+    char resolved[PATH_MAX];
+    return realpath(path, resolved) ? resolved : path;
+}
+
+int main(int argc, char *argv[]) {
+    bool time = false;
+    std::vector<const char *> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--time") {
+            time = true;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "Unknown option " << arg << "\n";
+            return 2;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    if (args.size() < 2 || args.size() > 3) {
+        std::cerr << "Usage: interpreter_client [--time] SOCKET SCRIPT [INPUT]\n";
+        return 2;
+    }
+    ServeRequest request;
+    request.script = absolute(args[1]);
+    if (args.size() == 3) {
+        std::ifstream input(args[2], std::ios::binary);
+        if (!input || !read_file(input, request.input)) {
+            std::cerr << "Can't open file " << args[2] << "\n";
+            return 1;
+        }
+    } else if (!read_file(std::cin, request.input)) {
+        std::cerr << "Can't read stdin\n";
+        return 1;
+    }
+    int fd = connect_socket(args[0]);
+    if (fd < 0) {
+        std::cerr << "Can't connect to " << args[0] << "\n";
+        return 1;
+    }
+    FdReader reader(fd);
+    ServeResponse response;
+    if (!write_all(fd, encode_request(request)) || !read_response(reader, response)) {
+        std::cerr << "Connection to " << args[0] << " is broken\n";
+        close(fd);
+        return 1;
+    }
+    close(fd);
+    if (!response.ok) {
+        std::cerr << response.errors << "\n";
+        return 1;
+    }
+    fwrite(response.output.data(), 1, response.output.size(), stdout);
+    fwrite(response.errors.data(), 1, response.errors.size(), stderr);
+    if (time) {
+        fprintf(stderr, "%llu us%s\n",
+                static_cast<unsigned long long>(response.microseconds),
+                response.cached ? ", cached" : "");
+    }
+    return 0;
+}
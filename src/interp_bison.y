@@ -8,22 +8,34 @@
     #include <syntax_tree.h>
     #include <interpreter.h>
 
-    extern int yylineno;
-    extern int yylex();
+    #define YYSTYPE YYSTYPE_struct
 
-    void yyerror(Interpreter *interpreter, const std::string &s) {
-        std::cerr << s << "\n";
+    // stamps a node with the position of the rule in the source
+    template <class T, class Location>
+    T *located(T *node, const Location &location) {
+        node->set_position(location.first_line, location.first_column);
+        return node;
     }
-
-    #define YYSTYPE YYSTYPE_struct
 %}
 
-%token IF ELSE FOR WHILE
+%code {
+    int yylex(YYSTYPE *value, YYLTYPE *location, yyscan_t scanner);
+
+    void yyerror(YYLTYPE *location, ParserContext *context, yyscan_t scanner,
+                 const std::string &s) {
+        context->errors() << s << "\n";
+    }
+}
+
+%define api.pure full
+%locations
+
+%token IF ELSE FOR WHILE PARALLEL REDUCE
 %token EQ LESS GR LESS_EQ GR_EQ NOT_EQ NOT AND OR
 %token ASSIGN
-%token INT STRING
+%token INT STRING LONG MAP
 %token VAR NUM STRING_CONST
-%token READ_INT WRITE EXIT WRITE_LINE READ_WORD READ_LINE
+%token READ_INT READ_LONG WRITE EXIT WRITE_LINE READ_WORD READ_LINE READ_INTS READ_ALL_WORDS
 
 %type<cmd> CMD CMD1 CMD2
 %type<cmd_list> CMDS
@@ -31,97 +43,166 @@
 %type<expr> EEXPR EXPR CREATING ASSIGNING LOGIC_EXPR FUNCTION_CALL RET_FUNCTION_CALL
 %type<expr> LOGIC_AND_EXPR LOGIC_CMP_EXPR LOGIC_FINAL_EXPR
 %type<expr> ARITH_EXPR ARITH_MUL_EXPR ARITH_FINAL_EXPR
-%type<str> VAR NUM STRING_CONST
+%type<reductions> REDUCTIONS REDUCTION_LIST
+%type<str> VAR NUM STRING_CONST REDUCTION_OP
 
-%parse-param {Interpreter *interpreter}
+%parse-param {ParserContext *context}
+%param {yyscan_t scanner}
 
 %%
 PROGRAM:                PROGRAM CMD                                 {
-                                                                        interpreter->set_node($2);
-                                                                        interpreter->interpret();
-                                                                        flex_interpreter.atStart = true;
+                                                                        context->interpreter().set_node($2);
+                                                                        context->interpreter().interpret();
+                                                                        context->atStart = true;
+                                                                        if (context->interpreter().exited()) {
+                                                                            YYACCEPT;
+                                                                        }
                                                                     }
 |                       CMD                                         {
-                                                                        interpreter->set_node($1);
-                                                                        interpreter->interpret();
-                                                                        flex_interpreter.atStart = true;
+                                                                        context->interpreter().set_node($1);
+                                                                        context->interpreter().interpret();
+                                                                        context->atStart = true;
+                                                                        if (context->interpreter().exited()) {
+                                                                            YYACCEPT;
+                                                                        }
                                                                     }
 ;
 CMDS:                   CMDS CMD                                    {
                                                                         $$ = $1;
                                                                         $$->addCmd($2);
                                                                     }
-|                       CMD                                         {$$ = new CmdListNode($1);}
+|                       CMD                                         {$$ = located(new CmdListNode($1), @$);}
 ;
 CMD:                    CMD1
 |                       CMD2
 ;
-CMD1:                   '{' CMDS '}'                                {$$ = new CmdNode($2);}
-|                       '{' '}'                                     {$$ = new CmdNode(new ExpressionNode());}
-|                       FUNCTION_CALL ';'                           {$$ = new CmdNode($1); $$->setSimple();}
-|                       EEXPR ';'                                   {$$ = new CmdNode($1); $$->setSimple();}
-|                       IF '(' EEXPR ')' CMD1 ELSE CMD1             {$$ = new CmdNode(new IfOperatorNode($3, $5, $7));}
-|                       WHILE '(' EEXPR ')' CMD1                    {$$ = new CmdNode(new WhileOperatorNode($3, $5));}
-|                       FOR '(' EEXPR ';' EEXPR ';' EEXPR ')' CMD1  {$$ = new CmdNode(new ForOperatorNode($3, $5, $7, $9));}
+CMD1:                   '{' CMDS '}'                                {$$ = located(new CmdNode($2), @$);}
+|                       '{' '}'                                     {$$ = located(new CmdNode(new ExpressionNode()), @$);}
+|                       FUNCTION_CALL ';'                           {$$ = located(new CmdNode($1), @$); $$->setSimple();}
+|                       EEXPR ';'                                   {$$ = located(new CmdNode($1), @$); $$->setSimple();}
+|                       IF '(' EEXPR ')' CMD1 ELSE CMD1             {$$ = located(new CmdNode(located(new IfOperatorNode($3, $5, $7), @$)), @$);}
+|                       WHILE '(' EEXPR ')' CMD1                    {$$ = located(new CmdNode(located(new WhileOperatorNode($3, $5), @$)), @$);}
+|                       FOR '(' EEXPR ';' EEXPR ';' EEXPR ')' CMD1  {$$ = located(new CmdNode(located(new ForOperatorNode($3, $5, $7, $9), @$)), @$);}
+|                       PARALLEL FOR '(' EEXPR ';' EEXPR ';' EEXPR ')' REDUCTIONS CMD1 {$$ = located(new CmdNode(located(new ParallelForNode($4, $6, $8, $10, $11), @$)), @$);}
+;
+CMD2:                   IF '(' EEXPR ')' CMD                        {$$ = located(new CmdNode(located(new IfOperatorNode($3, $5, nullptr), @$)), @$);}
+|                       IF '(' EEXPR ')' CMD1 ELSE CMD2             {$$ = located(new CmdNode(located(new IfOperatorNode($3, $5, $7), @$)), @$);}
+|                       WHILE '(' EEXPR ')' CMD2                    {$$ = located(new CmdNode(located(new WhileOperatorNode($3, $5), @$)), @$);}
+|                       FOR '(' EEXPR ';' EEXPR ';' EEXPR ')' CMD2  {$$ = located(new CmdNode(located(new ForOperatorNode($3, $5, $7, $9), @$)), @$);}
+|                       PARALLEL FOR '(' EEXPR ';' EEXPR ';' EEXPR ')' REDUCTIONS CMD2 {$$ = located(new CmdNode(located(new ParallelForNode($4, $6, $8, $10, $11), @$)), @$);}
+;
+REDUCTIONS:                                                         {$$ = located(new ReductionListNode(), @$);}
+|                       REDUCE '(' REDUCTION_LIST ')'               {$$ = $3;}
+;
+REDUCTION_LIST:         REDUCTION_OP ':' VAR                        {
+                                                                        $$ = located(new ReductionListNode(), @$);
+                                                                        if (!$$->add($1, $3)) {
+                                                                            yyerror(&@1, context, scanner, "Unknown reduction " + $1);
+                                                                            YYERROR;
+                                                                        }
+                                                                    }
+|                       REDUCTION_LIST ',' REDUCTION_OP ':' VAR     {
+                                                                        $$ = $1;
+                                                                        if (!$$->add($3, $5)) {
+                                                                            yyerror(&@3, context, scanner, "Unknown reduction " + $3);
+                                                                            YYERROR;
+                                                                        }
+                                                                    }
 ;
-CMD2:                   IF '(' EEXPR ')' CMD                        {$$ = new CmdNode(new IfOperatorNode($3, $5, nullptr));}
-|                       IF '(' EEXPR ')' CMD1 ELSE CMD2             {$$ = new CmdNode(new IfOperatorNode($3, $5, $7));}
-|                       WHILE '(' EEXPR ')' CMD2                    {$$ = new CmdNode(new WhileOperatorNode($3, $5));}
-|                       FOR '(' EEXPR ';' EEXPR ';' EEXPR ')' CMD2  {$$ = new CmdNode(new ForOperatorNode($3, $5, $7, $9));}
+REDUCTION_OP:           '+'                                         {$$ = "+";}
+|                       '*'                                         {$$ = "*";}
+|                       AND                                         {$$ = "&&";}
+|                       OR                                          {$$ = "||";}
+|                       VAR
 ;
 EEXPR:                  EXPR
-|                                                                   {$$ = new ExpressionNode();}
+|                                                                   {$$ = located(new ExpressionNode(), @$);}
 EXPR:                   LOGIC_EXPR
 |                       ASSIGNING
 |                       CREATING
 ;
-RET_FUNCTION_CALL:      READ_INT '(' ')'                            {$$ = new ReadIntNode();}
-|                       READ_WORD '(' ')'                           {$$ = new ReadNode(false);}
-|                       READ_LINE '(' ')'                           {$$  = new ReadNode(true);}
+RET_FUNCTION_CALL:      READ_INT '(' ')'                            {$$ = located(new ReadIntNode(), @$);}
+|                       READ_LONG '(' ')'                           {$$ = located(new ReadLongNode(), @$);}
+|                       READ_WORD '(' ')'                           {$$ = located(new ReadNode(false), @$);}
+|                       READ_LINE '(' ')'                           {$$ = located(new ReadNode(true), @$);}
+|                       READ_INTS '(' EXPR ')'                      {$$ = located(new ReadIntsNode($3), @$);}
+|                       READ_ALL_WORDS '(' ')'                      {$$ = located(new ReadAllWordsNode(), @$);}
+|                       VAR '(' EXPR ')'                            {
+                                                                        if (!($$ = ArrayFunctionNode::make($1, $3)) &&
+                                                                            !($$ = MapFunctionNode::make($1, $3))) {
+                                                                            yyerror(&@1, context, scanner, "Unknown function " + $1);
+                                                                            YYERROR;
+                                                                        }
+                                                                        located($$, @$);
+                                                                    }
+|                       VAR '(' EXPR ',' EXPR ')'                   {
+                                                                        if (!($$ = ArrayFunctionNode::make($1, $3, $5)) &&
+                                                                            !($$ = MapFunctionNode::make($1, $3, $5))) {
+                                                                            yyerror(&@1, context, scanner, "Unknown function " + $1);
+                                                                            YYERROR;
+                                                                        }
+                                                                        located($$, @$);
+                                                                    }
+|                       VAR '(' EXPR ',' EXPR ',' EXPR ')'          {
+                                                                        if (!($$ = MapFunctionNode::make($1, $3, $5, $7))) {
+                                                                            yyerror(&@1, context, scanner, "Unknown function " + $1);
+                                                                            YYERROR;
+                                                                        }
+                                                                        located($$, @$);
+                                                                    }
 ;
-FUNCTION_CALL:          WRITE '(' EXPR ')'                          {$$ = new WriteNode($3, false);}
-|                       WRITE_LINE '(' EXPR ')'                     {$$ = new WriteNode($3, true);}
-|                       EXIT '(' ')'                                {$$ = new ExitNode();}
+FUNCTION_CALL:          WRITE '(' EXPR ')'                          {$$ = located(new WriteNode($3, false), @$);}
+|                       WRITE_LINE '(' EXPR ')'                     {$$ = located(new WriteNode($3, true), @$);}
+|                       EXIT '(' ')'                                {$$ = located(new ExitNode(), @$);}
 ;
-CREATING:               VAR_TYPE VAR ASSIGN EXPR                    {$$ = new CreateOperator($1, $2, $4);}
-|                       VAR_TYPE VAR                                {$$ = new CreateOperator($1, $2);}
+CREATING:               VAR_TYPE VAR ASSIGN EXPR                    {$$ = located(new CreateOperator($1, $2, $4), @$);}
+|                       VAR_TYPE VAR                                {$$ = located(new CreateOperator($1, $2), @$);}
 ;
-ASSIGNING:              VAR ASSIGN EXPR                             {$$ = new AssignOperator($1, $3);}
+ASSIGNING:              VAR ASSIGN EXPR                             {$$ = located(new AssignOperator($1, $3), @$);}
+|                       VAR '[' EXPR ']' ASSIGN EXPR                {$$ = located(new StoreIndexNode(new VariableNode($1), $3, $6), @$);}
 ;
-VAR_TYPE:               INT                                         {$$ = new TypeNode(TypeIdentifyer::INT_T);}
-|                       STRING                                      {$$ = new TypeNode(TypeIdentifyer::STRING_T);}
+VAR_TYPE:               INT                                         {$$ = located(new TypeNode(TypeIdentifyer::INT_T), @$);}
+|                       STRING                                      {$$ = located(new TypeNode(TypeIdentifyer::STRING_T), @$);}
+|                       LONG                                        {$$ = located(new TypeNode(TypeIdentifyer::LONG_T), @$);}
+|                       INT '[' ']'                                 {$$ = located(new TypeNode(TypeIdentifyer::INT_ARRAY_T), @$);}
+|                       STRING '[' ']'                              {$$ = located(new TypeNode(TypeIdentifyer::STRING_ARRAY_T), @$);}
+|                       MAP LESS INT ',' INT GR                     {$$ = located(new TypeNode(TypeIdentifyer::INT_MAP_T), @$);}
+|                       MAP LESS STRING ',' INT GR                  {$$ = located(new TypeNode(TypeIdentifyer::STRING_MAP_T), @$);}
 ;
 LOGIC_EXPR:             LOGIC_AND_EXPR
-|                       LOGIC_EXPR OR LOGIC_AND_EXPR                {$$ = new OrOperator($1, $3);}
+|                       LOGIC_EXPR OR LOGIC_AND_EXPR                {$$ = located(new OrOperator($1, $3), @$);}
 ;
 LOGIC_AND_EXPR:         LOGIC_CMP_EXPR
-|                       LOGIC_AND_EXPR AND LOGIC_CMP_EXPR           {$$ = new AndOperator($1, $3);}
+|                       LOGIC_AND_EXPR AND LOGIC_CMP_EXPR           {$$ = located(new AndOperator($1, $3), @$);}
 ;
 LOGIC_CMP_EXPR:         LOGIC_FINAL_EXPR
-|                       LOGIC_CMP_EXPR EQ LOGIC_FINAL_EXPR          {$$ = new EqOperator($1, $3);}
-|                       LOGIC_CMP_EXPR LESS LOGIC_FINAL_EXPR        {$$ = new LessOperator($1, $3);}
-|                       LOGIC_CMP_EXPR GR LOGIC_FINAL_EXPR          {$$ = new GrOperator($1, $3);}
-|                       LOGIC_CMP_EXPR LESS_EQ LOGIC_FINAL_EXPR     {$$ = new LessEqOperator($1, $3);}
-|                       LOGIC_CMP_EXPR GR_EQ LOGIC_FINAL_EXPR       {$$ = new GrEqOperator($1, $3);}
-|                       LOGIC_CMP_EXPR NOT_EQ LOGIC_FINAL_EXPR      {$$ = new NotEqOperator($1, $3);}
+|                       LOGIC_CMP_EXPR EQ LOGIC_FINAL_EXPR          {$$ = located(new EqOperator($1, $3), @$);}
+|                       LOGIC_CMP_EXPR LESS LOGIC_FINAL_EXPR        {$$ = located(new LessOperator($1, $3), @$);}
+|                       LOGIC_CMP_EXPR GR LOGIC_FINAL_EXPR          {$$ = located(new GrOperator($1, $3), @$);}
+|                       LOGIC_CMP_EXPR LESS_EQ LOGIC_FINAL_EXPR     {$$ = located(new LessEqOperator($1, $3), @$);}
+|                       LOGIC_CMP_EXPR GR_EQ LOGIC_FINAL_EXPR       {$$ = located(new GrEqOperator($1, $3), @$);}
+|                       LOGIC_CMP_EXPR NOT_EQ LOGIC_FINAL_EXPR      {$$ = located(new NotEqOperator($1, $3), @$);}
 ;
 LOGIC_FINAL_EXPR:       ARITH_EXPR
-|                       NOT LOGIC_FINAL_EXPR                        {$$ = new NotOperator($2);}
+|                       NOT LOGIC_FINAL_EXPR                        {$$ = located(new NotOperator($2), @$);}
 ;
 ARITH_EXPR:             ARITH_MUL_EXPR
-|                       ARITH_EXPR '+' ARITH_MUL_EXPR               {$$ = new PlusOperator($1, $3);}
-|                       ARITH_EXPR '-' ARITH_MUL_EXPR               {$$ = new MinusOperator($1, $3);}
+|                       ARITH_EXPR '+' ARITH_MUL_EXPR               {$$ = located(new PlusOperator($1, $3), @$);}
+|                       ARITH_EXPR '-' ARITH_MUL_EXPR               {$$ = located(new MinusOperator($1, $3), @$);}
 ;
 ARITH_MUL_EXPR:         ARITH_FINAL_EXPR
-|                       ARITH_FINAL_EXPR '*' ARITH_MUL_EXPR         {$$ = new MultOperator($1, $3);}
-|                       ARITH_FINAL_EXPR '/' ARITH_MUL_EXPR         {$$ = new DivideOperator($1, $3);}
-|                       ARITH_FINAL_EXPR '%' ARITH_MUL_EXPR         {$$ = new ModOperator($1, $3);}
+|                       ARITH_FINAL_EXPR '*' ARITH_MUL_EXPR         {$$ = located(new MultOperator($1, $3), @$);}
+|                       ARITH_FINAL_EXPR '/' ARITH_MUL_EXPR         {$$ = located(new DivideOperator($1, $3), @$);}
+|                       ARITH_FINAL_EXPR '%' ARITH_MUL_EXPR         {$$ = located(new ModOperator($1, $3), @$);}
 ;
 ARITH_FINAL_EXPR:       '(' EXPR ')'                                {$$ = $2;}
-|                       NUM                                         {$$ = new IntValueNode($1);}
-|                       STRING_CONST                                {$$ = new StringValueNode($1);}
-|                       VAR                                         {$$ = new VariableNode($1);}
+|                       NUM                                         {$$ = located(number_constant($1), @$);}
+|                       STRING_CONST                                {$$ = located(new StringValueNode($1), @$);}
+|                       VAR                                         {$$ = located(new VariableNode($1), @$);}
+|                       VAR '[' EXPR ']'                            {$$ = located(new IndexNode(new VariableNode($1), $3), @$);}
+|                       INT '[' EXPR ']'                            {$$ = located(new NewArrayNode(TypeIdentifyer::INT_T, $3), @$);}
+|                       STRING '[' EXPR ']'                         {$$ = located(new NewArrayNode(TypeIdentifyer::STRING_T, $3), @$);}
 |                       RET_FUNCTION_CALL
-|                       '-' ARITH_FINAL_EXPR                        {$$ = new UnaryMinusOperator($2);}
+|                       '-' ARITH_FINAL_EXPR                        {$$ = located(new UnaryMinusOperator($2), @$);}
 ;
 %%
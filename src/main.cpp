@@ -1,45 +1,312 @@
-#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
+#include <iostream>
+#include <vector>
 #include <syntax_tree.h>
 #include <machine.h>
 #include <parser.h>
 #include <interpreter.h>
 
-std::string interactive_hello() {
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <server.h>
+#define INTERPRETER_SIGNALS 1
+#define INTERPRETER_SERVER 1
+#else
+#define INTERPRETER_SIGNALS 0
+#define INTERPRETER_SERVER 0
+#endif
+
+std::string interactive_hello(const ParserContext &context) {
     return "Hello, You are in interaction version of interpreter. Just enter commands like in python interpreter, and don't forget about ';'.\n" +
-           flex_interpreter.ps1;
+           context.ps1;
 }
 
 void err_file(const char *filename) {
     std::cerr << "Can't open file " << std::string(filename) << "\n";
 }
 
-int main(int argc, char *argv[]) {
-    if (argc > 1) {
-        if (!set_file(argv[1])) {
-            err_file(argv[1]);
-            return 0;
+void err_option(const std::string &option) {
+    std::cerr << "Unknown option " << option << "\n";
+}
+
+// answers requests on the socket, or on stdin and stdout without one
+int serve(const std::string &socket, int workers, int optimization, uint64_t max_input) {
+#if INTERPRETER_SERVER
+    if (workers <= 0) {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (max_input == 0) {
+        max_input = MAX_REQUEST_INPUT;
+    }
+    Server server(workers, optimization, max_input);
+    if (socket.empty()) {
+        server.serve(STDIN_FILENO, STDOUT_FILENO);
+        return 0;
+    }
+    if (server.listen(socket)) {
+        return 0;
+    }
+    std::cerr << "Can't listen on " << socket << "\n";
+    return 1;
+#else
+    std::cerr << "--serve is not supported on this platform\n";
+    return 1;
+#endif
+}
+
+void write_profile() {
+    Profiler *profiler = Profiler::current();
+    if (profiler && !profiler->write()) {
+        std::cerr << "Can't write profile\n";
+    }
+}
+
+// the profile is kept until the process ends, so that exit() writes it too
+void start_profile(const char *filename, std::string output) {
+    std::string source;
+    MappedFile file;
+    if (filename && file.open(filename)) {
+        source.assign(file.data(), file.size());
+    }
+    std::string name = filename ? filename : "interactive";
+    if (output.empty()) {
+        output = name;
+    }
+    static Profiler profiler(name, source, output);
+    Profiler::current() = &profiler;
+    std::atexit(write_profile);
+}
+
+// set while the interpreter is alive: metrics are written at the end, on
+// exit() and on SIGUSR1, one JSON object per line
+Interpreter *metrics_interpreter = nullptr;
+#if INTERPRETER_SIGNALS
+int metrics_fd = STDERR_FILENO;
+#endif
+
+void write_metrics() {
+    if (!metrics_interpreter) {
+        return;
+    }
+    JsonBuffer json;
+    metrics_interpreter->write_metrics(json);
+#if INTERPRETER_SIGNALS
+    const char *data = json.data();
+    size_t size = json.size();
+    while (size) {
+        ssize_t written = write(metrics_fd, data, size);
+        if (written <= 0) {
+            return;
         }
-    } else {
-        std::cout << interactive_hello();
-    }
-    bool input_file_fl = false;
-    std::ifstream fin;
-    if (argc > 2) {
-        input_file_fl =  true;
-        fin.open(argv[2]);
-        if (!fin) {
-            err_file(argv[2]);
-            return 0;
+        data += written;
+        size -= written;
+    }
+    ssize_t newline = write(metrics_fd, "\n", 1);
+    (void) newline;
+#else
+    fwrite(json.data(), 1, json.size(), stderr);
+    fputc('\n', stderr);
+#endif
+}
+
+#if INTERPRETER_SIGNALS
+void on_metrics_signal(int) {
+    write_metrics();
+}
+#endif
+
+bool start_metrics(Interpreter &interpreter, const std::string &filename) {
+#if INTERPRETER_SIGNALS
+    if (!filename.empty()) {
+        metrics_fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (metrics_fd < 0) {
+            return false;
         }
     }
-    Interpreter interpreter((input_file_fl ? fin : std::cin));
-    while (!flex_interpreter.eof) {
-        flex_interpreter.atStart = true;
-        int status = yyparse(&interpreter);
-        if (status) {
-            flex_interpreter.atStart = true;
+    signal(SIGUSR1, on_metrics_signal);
+#else
+    if (!filename.empty() && !freopen(filename.c_str(), "w", stderr)) {
+        return false;
+    }
+#endif
+    metrics_interpreter = &interpreter;
+    std::atexit(write_metrics);
+    return true;
+}
+
+// runs the compiled script from the cache, or parses and compiles it and
+// updates the cache; a cache that can't be loaded is rebuilt
+void run_cached(Interpreter &interpreter, ParserContext &context, char *filename,
+                const std::string &cache_dir, int optimization) {
+    ScriptCache cache(filename, cache_dir, optimization);
+    CompiledProgram program;
+    bool loaded;
+    try {
+        loaded = cache.load(program);
+    } catch (std::exception &) {
+        loaded = false;
+    }
+    if (!loaded) {
+        if (!context.open_file(filename)) {
+            err_file(filename);
+            return;
         }
+        context.parse();
+        program = interpreter.compile_program();
+        cache.save(program);
+    }
+    interpreter.run_compiled(program);
+}
+
+// writes the script as C++ to the file or to stdout, see Transpiler
+int emit_program(char *filename, const std::string &output, int optimization) {
+    if (!filename) {
+        std::cerr << "--emit-c needs a script\n";
+        return 1;
+    }
+    Interpreter interpreter;
+    ParserContext context(interpreter);
+    if (!context.open_file(filename)) {
+        err_file(filename);
+        return 1;
+    }
+    interpreter.set_optimization(optimization);
+    interpreter.set_whole_program(true);
+    ArenaScope nodes(interpreter.arena());
+    context.parse();
+    if (output.empty()) {
+        interpreter.transpile_program(std::cout);
+        return 0;
     }
+    std::ofstream out(output, std::ios::binary);
+    if (!out) {
+        err_file(output.c_str());
+        return 1;
+    }
+    interpreter.transpile_program(out);
+    return out ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    Engine engine = Engine::TREE;
+    int optimization = 1;
+    bool dump = false;
+    bool jit = false;
+    bool emit = false;
+    std::string emit_file;
+    bool cache = false;
+    std::string cache_dir;
+    bool profile = false;
+    bool metrics = false;
+    std::string metrics_file;
+    std::string profile_output;
+    bool serving = false;
+    std::string socket;
+    int workers = 0;
+    uint64_t max_input = 0;
+    std::vector<char *> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--vm") {
+            engine = Engine::BYTECODE;
+        } else if (arg == "--tree") {
+            engine = Engine::TREE;
+        } else if (arg == "--dump") {
+            dump = true;
+        } else if (arg == "--jit") {
+            jit = true;
+        } else if (arg == "--emit-c") {
+            emit = true;
+        } else if (arg.compare(0, 9, "--emit-c=") == 0 && arg.size() > 9) {
+            emit = true;
+            emit_file = arg.substr(9);
+        } else if (arg == "--cache") {
+            cache = true;
+        } else if (arg.compare(0, 12, "--cache-dir=") == 0 && arg.size() > 12) {
+            cache = true;
+            cache_dir = arg.substr(12);
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg.compare(0, 10, "--profile=") == 0 && arg.size() > 10) {
+            profile = true;
+            profile_output = arg.substr(10);
+        } else if (arg == "--metrics") {
+            metrics = true;
+        } else if (arg.compare(0, 10, "--metrics=") == 0 && arg.size() > 10) {
+            metrics = true;
+            metrics_file = arg.substr(10);
+        } else if (arg == "--serve") {
+            serving = true;
+        } else if (arg.compare(0, 8, "--serve=") == 0 && arg.size() > 8) {
+            serving = true;
+            socket = arg.substr(8);
+        } else if (arg.compare(0, 10, "--workers=") == 0 && arg.size() > 10) {
+            workers = atoi(arg.c_str() + 10);
+        } else if (arg.compare(0, 12, "--max-input=") == 0 && arg.size() > 12) {
+            max_input = strtoull(arg.c_str() + 12, nullptr, 10);
+        } else if (arg.compare(0, 10, "--threads=") == 0 && arg.size() > 10 &&
+                   atoi(arg.c_str() + 10) > 0) {
+            // the calling thread is one of them
+            WorkStealingPool::shared_threads() = atoi(arg.c_str() + 10) - 1;
+        } else if (arg.size() == 3 && arg[0] == '-' && arg[1] == 'O' &&
+                   arg[2] >= '0' && arg[2] - '0' <= Optimizer::MAX_LEVEL) {
+            optimization = arg[2] - '0';
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            err_option(arg);
+            return 0;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (serving) {
+        return serve(socket, workers, optimization, max_input);
+    }
+    if (emit) {
+        return emit_program(files.empty() ? nullptr : files[0], emit_file, optimization);
+    }
+    // the profile is taken by the tree engine from the source
+    bool cached = cache && !files.empty() && !dump && !profile;
+    Interpreter interpreter;
+    ParserContext context(interpreter);
+    if (files.empty()) {
+        context.open_interactive();
+        std::cout << interactive_hello(context);
+    } else if (!cached && !context.open_file(files[0])) {
+        err_file(files[0]);
+        return 0;
+    }
+    if (files.size() > 1 && !interpreter.set_input(files[1])) {
+        err_file(files[1]);
+        return 0;
+    }
+    if (metrics && !start_metrics(interpreter, metrics_file)) {
+        err_file(metrics_file.c_str());
+        return 0;
+    }
+    if (profile) {
+        engine = Engine::TREE;
+        start_profile(files.empty() ? nullptr : files[0], profile_output);
+    }
+    interpreter.set_engine(engine);
+    interpreter.set_optimization(optimization);
+    interpreter.set_dump(dump);
+    interpreter.set_jit(jit);
+    interpreter.set_whole_program(!files.empty());
+    ArenaScope nodes(interpreter.arena());
+    if (cached) {
+        interpreter.set_engine(Engine::BYTECODE);
+        run_cached(interpreter, context, files[0], cache_dir, optimization);
+    } else {
+        context.parse();
+        interpreter.run_program();
+    }
+    write_metrics();
+    metrics_interpreter = nullptr;
     return 0;
-}
\ No newline at end of file
+}